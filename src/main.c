@@ -5,7 +5,10 @@
 #include "sleep.h"
 #include "xgpio.h"
 #include <string.h>
-#include <stdio.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 // ===================== DEFINES ===================== //
 
@@ -29,41 +32,197 @@ XIicPs IicInstance;
 
 XGpio BuzzerGpio;   // instancia del GPIO para el BUZZER
 
-// Frecuencia de muestreo ~50 Hz
+// Frecuencia de muestreo ~50 Hz (tambien 25 o 100 Hz: la FIFO del MAX y los
+// coeficientes del pasabanda se eligen segun SAMPLE_RATE_HZ)
+#ifndef SAMPLE_PERIOD_US
 #define SAMPLE_PERIOD_US    20000
+#endif
 #define SAMPLE_RATE_HZ      (1000000 / SAMPLE_PERIOD_US)
 
-// UART print
-#define PRINT_DECIM         10
-
-// OLED update cada ~0.5 s
-#define OLED_UPDATE_DECIM   25
+// FIFO_CONFIG del MAX: el ADC va a 100 Hz y SMP_AVE (bits 7:5) promedia
+// hasta SAMPLE_RATE_HZ; los bits bajos quedan como siempre (0x0F)
+#if SAMPLE_RATE_HZ == 100
+#define MAX_FIFO_CONFIG 0x0F    // SMP_AVE = 1
+#elif SAMPLE_RATE_HZ == 50
+#define MAX_FIFO_CONFIG 0x2F    // SMP_AVE = 2
+#elif SAMPLE_RATE_HZ == 25
+#define MAX_FIFO_CONFIG 0x4F    // SMP_AVE = 4
+#else
+#error "SAMPLE_RATE_HZ debe ser 25, 50 o 100"
+#endif
+
+// Periodos en ms -> muestras a la frecuencia elegida (las cadencias de
+// UART y OLED no cambian con SAMPLE_RATE_HZ)
+#define MS_TO_SAMPLES(ms)   (((ms) * SAMPLE_RATE_HZ + 500) / 1000)
+
+// UART print cada PRINT_MS
+#define PRINT_MS            200
+#define PRINT_DECIM         MS_TO_SAMPLES(PRINT_MS)
+
+// Linea de HRV por UART cada HRV_PRINT_DECIM muestras (~5 s)
+#define HRV_PRINT_DECIM     MS_TO_SAMPLES(5000)
+
+// Ruta DSP de HR/SpO2: 0 = float (referencia), 1 = punto fijo (enteros Q8/Q16)
+#ifndef HR_FIXED_POINT
+#define HR_FIXED_POINT      0
+#endif
+
+// Tiempo del pico por interpolacion parabolica (fraccion de muestra); con
+// 0 los intervalos son de muestras enteras (+-1/fs)
+#ifndef HR_PEAK_INTERP
+#define HR_PEAK_INTERP      1
+#endif
+
+// Pasabanda 0.5-4 Hz (biquads) delante del detector y del AC de SpO2
+// (0 = remocion de DC por EMA, como antes)
+#ifndef HR_BANDPASS
+#define HR_BANDPASS         1
+#endif
+
+// OLED update cada OLED_UPDATE_MS
+#define OLED_UPDATE_MS      500
+#define OLED_UPDATE_DECIM   MS_TO_SAMPLES(OLED_UPDATE_MS)
+
+// Onda PPG en vivo en la parte baja del OLED (1 = activada)
+#ifndef OLED_WAVE_ENABLE
+#define OLED_WAVE_ENABLE    1
+#endif
+
+// Pantallas (resumen, BPM grande, SpO2 grande): ms que dura cada una
+// antes de rotar; 0 = solo la pantalla resumen
+#ifndef OLED_SCREEN_MS
+#define OLED_SCREEN_MS      5000
+#endif
+#define OLED_SCREEN_DECIM   (OLED_SCREEN_MS / OLED_UPDATE_MS)  // actualizaciones
+
+// Energia del OLED: sin dedo se atenua tras OLED_DIM_MS y se apaga (0xAE)
+// tras OLED_OFF_MS (se cuentan en actualizaciones del OLED)
+#ifndef OLED_DIM_MS
+#define OLED_DIM_MS         5000
+#endif
+#ifndef OLED_OFF_MS
+#define OLED_OFF_MS         30000
+#endif
+#define OLED_DIM_TICKS      (OLED_DIM_MS / OLED_UPDATE_MS)
+#define OLED_OFF_TICKS      (OLED_OFF_MS / OLED_UPDATE_MS)
+#define OLED_CONTRAST_DIM   0x08
+
+// Umbral de alarma (buzzer + pantalla invertida intermitente)
+#define BPM_ALARM_THRESHOLD 105
+
+// Depuracion: vuelca cada frame por UART como imagen PBM (1 = activado)
+#ifndef OLED_PBM_DUMP
+#define OLED_PBM_DUMP       0
+#endif
 
 // ===================== OLED SSD1306 ===================== //
 
 #define OLED_ADDR       0x3C
-#define OLED_WIDTH      128
-#define OLED_HEIGHT     32
+
+// Panel en tiempo de compilacion. Todo el dibujo usa estas constantes, asi
+// que cambiar de panel no agrega ramas en tiempo de ejecucion.
+#define OLED_PANEL_SSD1306_128x32   0
+#define OLED_PANEL_SSD1306_128x64   1
+#define OLED_PANEL_SH1106_128x64    2
+
+#ifndef OLED_PANEL
+#define OLED_PANEL      OLED_PANEL_SSD1306_128x32
+#endif
+
+// Modo de escritura de la RAM del controlador
+#define OLED_ADDR_HORIZONTAL    0   // SSD1306: ventana 0x21/0x22, autoincremento
+#define OLED_ADDR_PAGE          1   // SH1106: 0xB0+pag y columna por pagina
+
+#if OLED_PANEL == OLED_PANEL_SSD1306_128x32
+#define OLED_WIDTH          128
+#define OLED_HEIGHT         32
+#define OLED_COL_OFFSET     0
+#define OLED_ADDR_MODE      OLED_ADDR_HORIZONTAL
+#define OLED_HAS_HW_SCROLL  1
+#define OLED_CONTRAST       0x8F
+#elif OLED_PANEL == OLED_PANEL_SSD1306_128x64
+#define OLED_WIDTH          128
+#define OLED_HEIGHT         64
+#define OLED_COL_OFFSET     0
+#define OLED_ADDR_MODE      OLED_ADDR_HORIZONTAL
+#define OLED_HAS_HW_SCROLL  1
+#define OLED_CONTRAST       0xCF
+#elif OLED_PANEL == OLED_PANEL_SH1106_128x64
+#define OLED_WIDTH          128
+#define OLED_HEIGHT         64
+#define OLED_COL_OFFSET     2   // RAM de 132 columnas, el vidrio empieza en la 2
+#define OLED_ADDR_MODE      OLED_ADDR_PAGE
+#define OLED_HAS_HW_SCROLL  0
+#define OLED_CONTRAST       0x80
+#else
+#error "OLED_PANEL no soportado"
+#endif
+
 #define OLED_PAGES      (OLED_HEIGHT / 8)
 
+// Zona de la onda PPG: desde WAVE_PAGE0 hasta la ultima pagina
+#define WAVE_PAGE0      2
+#define WAVE_PAGES      (OLED_PAGES - WAVE_PAGE0)
+#define WAVE_HEIGHT     (WAVE_PAGES * 8)
+
+// Doble buffer: se dibuja siempre en oled_buffer (back) y oled_front es la
+// copia que se esta enviando por I2C en segundo plano.
 static u8 oled_buffer[OLED_WIDTH * OLED_PAGES];
+static u8 oled_front[OLED_WIDTH * OLED_PAGES];
+
+// Bytes de imagen por llamada a OLED_Service (acota el tiempo de bus por muestra)
+#define OLED_XFER_CHUNK     32
+
+static int oled_xfer_busy    = 0;   // hay un frame en vuelo
+static u32 oled_xfer_pos     = 0;   // siguiente byte de oled_front a enviar
+static int oled_frame_pending = 0;  // hay un frame mas nuevo esperando en back
+
+// Estadisticas de bus del OLED (bytes I2C incluyendo bytes de control)
+static u32 oled_stat_bytes  = 0;
+static u32 oled_stat_frames = 0;
 
 // Prototipos OLED
 int  OLED_SendCommand(u8 cmd);
+int  OLED_SendCommandList(const u8 *cmds, u32 len);
 int  OLED_SendData(const u8 *data, u32 len);
 void OLED_Init(void);
 void OLED_ClearBuffer(void);
 void OLED_Update(void);
+int  OLED_WriteRegion(int x0, int x1, int page0, int page1, const u8 *data, u32 len);
+void OLED_Present(void);
+void OLED_Service(void);
+void OLED_DumpPBM(const u8 *fb);
 void OLED_DrawPixel(int x, int y, int on);
 void OLED_FillRect(int x0, int y0, int x1, int y1, int on);
+void OLED_ClearRect(int x0, int y0, int x1, int y1);
+void OLED_InvertRect(int x0, int y0, int x1, int y1);
+void OLED_DrawHLine(int x0, int x1, int y, int on);
+void OLED_DrawVLine(int x, int y0, int y1, int on);
+
+// Contraste y scroll por hardware
+int  OLED_SetContrast(u8 level);
+int  OLED_StartHScroll(int left, u8 page0, u8 page1, u8 interval);
+int  OLED_StopScroll(void);
 
 // Texto 6x8
 void OLED_ClearTopLine(void);
 void OLED_DrawChar6x8(int x, int y, char c);
 void OLED_DrawString6x8(int x, int y, const char *s);
 
-// Mostrar todo en OLED
-void OLED_ShowVitals(float bpm, float Ta, float To, float spo2);
+// Digitos grandes (16/24 px) precalculados en formato de pagina
+void OLED_BuildBigCache(void);
+
+// Estados de energia: activo, atenuado, apagado; alarma invierte intermitente
+void OLED_PowerUpdate(int finger, int alarm);
+int  OLED_IsOn(void);
+
+// Mostrar todo en OLED (pantalla actual; solo redibuja lo que cambio).
+// low_q: BPM y SpO2 son valores retenidos, se marcan con '?'
+void OLED_ShowVitals(float bpm, float Ta, float To, float spo2, int low_q);
+
+// Onda PPG: una columna nueva por muestra, enviada por una ventana angosta
+void WAVE_Reset(void);
+void WAVE_AddSample(float ac, float ac_amp);
 
 // ===================== I2C / MAX / MLX ===================== //
 
@@ -75,45 +234,650 @@ int I2C_ReadMulti(u8 devAddr, u8 reg, u8 *buf, u32 len);
 int Max_CheckPartID(void);
 int Max30102_Reset(void);
 int Max30102_Init_Config(void);
-int Max30102_ReadLatestRedIR(u32 *red, u32 *ir);
+int Max30102_ReadFifo(u32 *red, u32 *ir, int max, int *count);
 
 // MLX90614
 float MLX90614_ReadTemp(u8 regAddr);
 
-// ===================== HR + SpO2 ===================== //
-
-void HR_Init(void);
-void HR_ProcessSample(u32 ir, float *bpm_out);
-void SPO2_Update(u32 red_raw, u32 ir_raw, float *spo2_out);
+// ===================== FORMATO NUMERICO ===================== //
+//
+// Reemplazo de snprintf para OLED y UART: sin varargs ni heap. Cada funcion
+// escribe en dst, termina con '\0' y devuelve el puntero al '\0' para
+// seguir encadenando. width rellena con espacios a la izquierda.
 
-// ---- HR BÁSICO ---- //
+char *FMT_Str(char *dst, const char *s);
+char *FMT_Int(char *dst, s32 v, int width);
+char *FMT_Fixed(char *dst, s32 v, int decimals, int width);
+char *FMT_Q(char *dst, s32 q, int frac_bits, int decimals, int width);
+char *FMT_Float(char *dst, float f, int decimals, int width);
 
-static float dc_est        = 0.0f;
-static float ac_prev2      = 0.0f;
-static float ac_prev1      = 0.0f;
-static float ac_curr       = 0.0f;
-static float ac_peak_est   = 0.0f;
-static int   samples_since_beat = 0;
-static int   in_peak       = 0;
+// ===================== HR + SpO2 ===================== //
 
-#define BPM_HISTORY_LEN 8
-static float bpm_hist[BPM_HISTORY_LEN];
-static int   bpm_hist_count = 0;
-static int   bpm_hist_index = 0;
+// Muestras por bloque: una rafaga de FIFO completa del MAX30102
+#define PPG_BLOCK_MAX   32
 
 // Umbral DC para "hay dedo" (IR grande)
 #define DC_FINGER_MIN   5000.0f
 
-// ---- SpO2 filtros ---- //
+// Un BPM o SpO2 que deja de actualizarse (latidos descartados por calidad)
+// se retiene a lo sumo PPG_HOLD_S segundos; despues vale 0 ("---")
+#define PPG_HOLD_S      5
+#define PPG_HOLD        (PPG_HOLD_S * SAMPLE_RATE_HZ)
+
+// La alarma de BPM solo suena con un latido aceptado en los ultimos
+// PPG_ALARM_FRESH_S segundos o con la calidad actual buena: un BPM retenido
+// durante un artefacto no la mantiene
+#define PPG_ALARM_FRESH_S   2
+#define PPG_ALARM_FRESH     (PPG_ALARM_FRESH_S * SAMPLE_RATE_HZ)
+
+// Estimador de BPM: ventana de los ultimos HR_RATE_WIN_BEATS latidos
+// aceptados, ninguno con mas de HR_RATE_WIN_S segundos (0 = sin limite)
+#define HR_RATE_WIN_BEATS   8
+#define HR_RATE_WIN_S       10
+
+// Latidos que se descartan en cada extremo de la ventana ordenada antes de
+// promediar (0 = media simple; (N-1)/2 = mediana)
+#define HR_RATE_TRIM        1
+
+// Rechazo de outliers: |bpm - mediana| > HR_RATE_OUTLIER_PCT % de la
+// mediana. Tras HR_RATE_RELOCK rechazos seguidos se toma como cambio real
+// de ritmo y la ventana vuelve a empezar.
+#define HR_RATE_OUTLIER_PCT 25
+#define HR_RATE_RELOCK      4
+
+// Segundo estimador de HR por autocorrelacion: ventana deslizante de
+// HR_ACF_WIN_S segundos, nueva estimacion cada HR_ACF_HOP_S
+#define HR_ACF_WIN_S        8
+#define HR_ACF_HOP_S        1
+
+#define HR_ACF_WIN          (HR_ACF_WIN_S * SAMPLE_RATE_HZ)
+#define HR_ACF_HOP          (HR_ACF_HOP_S * SAMPLE_RATE_HZ)
+#define HR_ACF_LAG_MIN      ((60 * SAMPLE_RATE_HZ) / 180)      // 180 BPM
+#define HR_ACF_LAG_MAX      ((60 * SAMPLE_RATE_HZ + 39) / 40)  // 40 BPM
+#define HR_ACF_NLAGS        (HR_ACF_LAG_MAX + 2)
+
+// Correlacion con el latido anterior (SQI): lags a +-20 % del ritmo, para
+// que la variabilidad normal entre latidos no la baje
+#define HR_ACF_TMPL_N       (2 * (HR_ACF_LAG_MAX / 5) + 1)
+
+// Historia: ventana + lag maximo, redondeada a potencia de 2
+#if (HR_ACF_WIN + HR_ACF_NLAGS) <= 256
+#define HR_ACF_RING         256
+#elif (HR_ACF_WIN + HR_ACF_NLAGS) <= 512
+#define HR_ACF_RING         512
+#elif (HR_ACF_WIN + HR_ACF_NLAGS) <= 1024
+#define HR_ACF_RING         1024
+#else
+#error "Ventana de autocorrelacion demasiado grande"
+#endif
+
+// HRV: intervalos NN (latidos aceptados y consecutivos) en dos ventanas
+// de tiempo. El anillo cubre la ventana larga a 180 BPM. Edicion NN: un
+// intervalo que se aparta mas de HRV_EDIT_PCT % del ultimo NN es un
+// artefacto (pico perdido o de mas) y corta la cadena; tras HRV_RELOCK
+// seguidos se toma como cambio real de ritmo.
+#define HRV_WIN_SHORT_S     60
+#define HRV_WIN_LONG_S      300
+#define HRV_RING            1024
+#define HRV_NN50_MS         50
+#define HRV_EDIT_PCT        20
+#define HRV_RELOCK          3
+
+#if HRV_WIN_LONG_S * 3 > HRV_RING
+#error "HRV_RING no alcanza para HRV_WIN_LONG_S a 180 BPM"
+#endif
+
+// Ritmo irregular / FA: ventana deslizante de AF_WIN intervalos (potencia
+// de 2) con entropia de |dRR| en AF_BINS bins de rr medio / AF_BIN_DIV,
+// tasa de puntos de giro y coeficiente de variacion. Un episodio abre tras
+// AF_ONSET latidos seguidos irregulares y cierra tras AF_OFFSET regulares;
+// los ultimos AF_EPISODES quedan en un anillo.
+#define AF_WIN              64
+#define AF_MIN_BEATS        32
+#define AF_BINS             16
+#define AF_BIN_DIV          32          // bin = rr medio / AF_BIN_DIV
+#define AF_CV_MIN_X1000     100         // 0.10
+#define AF_SHE_MIN_X1000    700         // entropia / log2(AF_BINS)
+#define AF_TPR_LO_X1000     500         // al azar: 2/3
+#define AF_TPR_HI_X1000     830         // alternancia (bigeminismo): ~1
+#define AF_ONSET            8
+#define AF_OFFSET           32
+#define AF_EPISODES         8
+#define AF_AMP_DIV          3           // pulso < 1/3 del tipico: otro pico
+
+// Respiracion: las tres modulaciones (linea base, amplitud e intervalo)
+// se remuestrean a RESP_FS Hz y se cuentan sus ciclos en los ultimos
+// RESP_WIN_S segundos. La fusion necesita al menos dos series que no se
+// separen mas de RESP_FUSE_SPREAD resp/min.
+#define RESP_FS             2
+#define RESP_WIN_S          32
+#define RESP_XMAX           24          // cruces guardados (40 resp/min en 32 s)
+#define RESP_GAP_MS         3000        // hueco entre latidos que reinicia la grilla
+#define RESP_FUSE_SPREAD    4
+
+// Morfologia por latido: la ventana guarda el IR crudo de un latido (pico
+// a pico, hasta 40 BPM, mas el retardo del pasabanda que lleva la
+// deteccion) y los registros terminados van a un anillo de MORPH_RING
+// (potencia de 2) para telemetria. La muesca dicrota tiene que subir al
+// menos 1/MORPH_NOTCH_DIV de la amplitud.
+#define MORPH_WIN           ((60 * SAMPLE_RATE_HZ) / 40 + SAMPLE_RATE_HZ / 4)
+#define MORPH_RING          32
+#define MORPH_NOTCH_DIV     16
+
+// SpO2 por latido: AC pico a valle minima (cuentas) para usar un latido y
+// suavizado entre latidos (alpha 1/2^SPO2_BEAT_SHIFT)
+#define SPO2_AC_MIN         20
+#define SPO2_BEAT_SHIFT     2
+
+// Calidad de señal (SQI), por ventanas de SQI_WIN_S segundos. Una ventana
+// es mala si la curtosis del AC pasa de SQI_KURT_MAX, si su perfusion
+// (AC rms / DC) sale de [ref/2, 2*ref] o si la periodicidad de la
+// autocorrelacion baja de SQI_CONF_MIN. Bloquean al instante, durante una
+// ventana: recorte del ADC, un salto de |AC| > SQI_SPIKE veces el rms
+// anterior y una correlacion del pulso con el del latido anterior menor
+// que SQI_TMPL_MIN (la ACF la da cada segundo). Tras SQI_RELOCK ventanas
+// seguidas con solo la perfusion fuera de rango se toma como cambio real
+// y se adopta la nueva referencia.
+#define SQI_WIN_S           2
+#define SQI_WIN             (SQI_WIN_S * SAMPLE_RATE_HZ)
+#define SQI_KURT_MAX        8           // pulso limpio ~2-5
+#define SQI_TMPL_MIN_Q8     218         // 0.85 (limpio > 0.9)
+#define SQI_CONF_MIN_Q8     128         // 0.5
+#define SQI_SPIKE           5
+#define SQI_CLIP_RAW        0x3FF00     // cerca del fondo de escala (18 bits)
+#define SQI_RELOCK          4
+
+// Motivos de calidad baja (PPG_QualityFlags)
+#define SQI_F_CLIP          0x01
+#define SQI_F_SPIKE         0x02
+#define SQI_F_KURT          0x04
+#define SQI_F_PERFUSION     0x08
+#define SQI_F_PERIOD        0x10
+#define SQI_F_TEMPLATE      0x20
+#define SQI_F_NOFINGER      0x40
+
+// Los dos que tambien da un ritmo irregular sin artefacto (HR, SpO2 y el
+// detector de FA no descartan latidos por ellos, salvo plantilla con
+// periodo bueno; ver SQI_BeatOk)
+#define SQI_F_RHYTHM        (SQI_F_PERIOD | SQI_F_TEMPLATE)
+
+// Linea de cache L1 del Cortex-A9
+#define CACHE_LINE_BYTES    32
+
+// Front end pasabanda: 2 biquads, 2 lanes (lane 0 = RED, lane 1 = IR)
+#define BQ_SECTIONS     2
+#define BQ_LANES        2
+#define BQ_LANE_RED     0
+#define BQ_LANE_IR      1
+
+typedef struct {
+    float x1[BQ_LANES], x2[BQ_LANES];
+    float y1[BQ_LANES], y2[BQ_LANES];
+} BQ_SectionF;
+
+typedef struct {
+    s32 x1[BQ_LANES], x2[BQ_LANES];     // Q8
+    s32 y1[BQ_LANES], y2[BQ_LANES];
+} BQ_SectionQ;
+
+// Latido detectado dentro de un bloque
+typedef struct {
+    u32   t_ms;         // marca de tiempo del pico (interpolada)
+    u16   rr_ms;        // intervalo desde el latido anterior (interpolado)
+    u8    accepted;     // 1 = entro al estimador de BPM (0 = fuera de rango u outlier)
+    float bpm;          // BPM instantaneo (0 fuera de 40..180)
+} HR_Beat;
+
+// Ventana robusta de BPM (enteros, BPM en Q8; la misma en float y punto fijo)
+typedef struct {
+    u16 ring[HR_RATE_WIN_BEATS];        // en orden de llegada
+    u16 sorted[HR_RATE_WIN_BEATS];      // los mismos, ordenados
+    u32 ring_t[HR_RATE_WIN_BEATS];      // muestra en que llego cada uno
+    u32 sum;                            // suma corrida de la ventana
+    u8  count;
+    u8  head;
+    u8  rejects;                        // rechazos seguidos
+} HR_Rate;
+
+// Autocorrelacion deslizante (enteros, comun a float y punto fijo)
+typedef struct {
+    s32 r[HR_ACF_NLAGS];                // r[k] = suma x[n]*x[n-k] en la ventana
+    s16 x[HR_ACF_RING];                 // muestras normalizadas (|x| <= 1023)
+    s32 prev_q8;                        // AC anterior (entra la pendiente)
+    s32 level_q8;                       // |pendiente| media, para normalizar
+    s32 gain_q16;                       // normalizacion, se fija en cada hop
+    u16 head;
+    u16 fill;
+    u16 hop;
+    u16 bpm_q8;                         // ultima estimacion (0 = ninguna)
+    u16 conf_q8;                        // r[lag]/r[0] en Q8 (256 = periodica)
+    u16 lag;                            // lag entero del ultimo maximo (0 = ninguno)
+    s32 cxy[HR_ACF_TMPL_N];             // sumas del medio hop en curso para
+    s32 cyy[HR_ACF_TMPL_N];             // tmpl_q8, un lag por posicion desde tmpl_lo
+    s32 cxx;
+    u16 tmpl_lo, tmpl_n;                // lags del hop en curso (n = 0: ninguno)
+    s16 tmpl_q8;                        // correlacion del ultimo hop con el latido
+                                        // anterior (mejor lag cerca del ritmo), Q8
+    s16 tmpl_half_q8;                   // la de la primera mitad del hop en curso
+} HR_Acf;
+
+// HRV: sumas corridas de una ventana sobre el anillo comun (la ventana
+// larga es la que manda que sigue guardado). Una diferencia entre latidos
+// cuenta si los dos estan en la ventana.
+typedef struct {
+    u32 span_ms;                        // largo de la ventana
+    u16 tail;                           // latido mas viejo de la ventana
+    u16 n;                              // latidos en la ventana
+    u32 sum;                            // suma rr (ms)
+    u64 sum2;                           // suma rr^2
+    u16 m;                              // diferencias validas
+    u16 nn50;                           // |diferencia| > HRV_NN50_MS
+    u64 ssd;                            // suma de diferencias^2
+} HRV_Win;
+
+#define HRV_DIFF_NONE   ((s16)0x8000)   // sin latido anterior consecutivo
+
+typedef struct {
+    u16 rr[HRV_RING];                   // intervalo (ms)
+    s16 d[HRV_RING];                    // rr - rr anterior, o HRV_DIFF_NONE
+    u32 t[HRV_RING];                    // llegada (ms del canal)
+    u16 head;
+    u16 last_rr;                        // ultimo NN (referencia de la edicion)
+    u8  chain;                          // el ultimo latido fue aceptado
+    u8  edits;                          // intervalos editados seguidos
+    HRV_Win win[2];                     // 0 = corta, 1 = larga
+} HRV_State;
+
+// Resultado de una ventana (decimas: 425 = 42.5)
+typedef struct {
+    u16 n;                              // intervalos en la ventana
+    u16 rmssd_x10;                      // ms
+    u16 sdnn_x10;                       // ms
+    u16 pnn50_x10;                      // %
+} HRV_Stats;
+
+// Ritmo irregular: ventana de intervalos (sumas corridas, todo O(1) por
+// latido) y episodios
+#define AF_NONE         0xFF
+
+typedef struct {
+    u32 start_ms, end_ms;               // primer y ultimo latido irregular
+} AF_Episode;
+
+typedef struct {
+    u16 rr[AF_WIN];
+    u8  bin[AF_WIN];                    // bin de |rr - rr anterior| (AF_NONE: sin anterior)
+    u8  tp[AF_WIN];                     // 1 punto de giro, 0 no, AF_NONE sin evaluar
+    u32 t[AF_WIN];                      // llegada (ms del canal)
+    u16 head, n;
+    u8  chain;                          // detecciones buenas seguidas (hasta 3)
+    u32 sum, sum2;
+    u16 hist[AF_BINS];
+    u16 nd;                             // diferencias en hist
+    u32 hlog_q8;                        // suma de c * log2(c) de hist, Q8
+    u16 ntp, ntp_eval;
+} AF_Win;
+
+typedef struct {
+    AF_Win w;
+    u16 cv_x1000, tpr_x1000, she_x1000; // del ultimo latido
+    u8  irregular;                      // el ultimo latido vio la ventana irregular
+    u8  active;                         // episodio abierto
+    u16 irr_run, reg_run;
+    s32 amp_ref;                        // amplitud tipica de pulso (EMA 1/8)
+    u32 cand_ms;                        // inicio de la racha irregular en curso
+    u32 last_irr_ms;
+    AF_Episode cur;
+    AF_Episode ep[AF_EPISODES];
+    u32 ep_seq;                         // episodios cerrados desde el inicio
+} AF_State;
+
+typedef struct {
+    u16 n;                              // intervalos en la ventana
+    u16 cv_x1000, tpr_x1000, she_x1000;
+    u8  irregular, active;
+    u32 start_ms;                       // del episodio abierto
+} AF_Stats;
+
+// Respiracion: una serie de modulacion remuestreada (enteros, comun a
+// float y punto fijo)
+typedef struct {
+    s32 prev;                           // valor en el latido anterior
+    s32 trend;                          // EMA lenta (se resta)
+    s32 level;                          // |serie| media, para la histeresis
+    s8  state;                          // -1 abajo, 1 arriba, 0 sin definir
+    u8  xhead, xn;
+    u32 xt[RESP_XMAX];                  // cruces ascendentes (ms del canal)
+    u16 brpm_q8;                        // resp/min de esta serie (0 = ninguna)
+} RESP_Series;
+
+#define RESP_BASE       0               // linea base del IR (dc del HR)
+#define RESP_AMP        1               // amplitud pico a valle del latido
+#define RESP_FREQ       2               // intervalo entre latidos
+
+typedef struct {
+    RESP_Series s[3];
+    u32 t_prev;                         // ultimo latido (ms)
+    u32 t_grid;                         // proxima muestra de la grilla (ms)
+    u8  primed;
+    u16 brpm_q8;                        // fusion (0 = sin estimacion confiable)
+} RESP_State;
+
+// Un latido (pie a pie) para telemetria: 16 bytes
+typedef struct {
+    u32 t_ms;                           // pico (ms del canal, interpolado)
+    u16 rr_ms;                          // desde el pico anterior
+    u16 pi_x100;                        // indice de perfusion IR, % x 100
+    u16 rise_ms;                        // pie -> pico
+    u16 width_ms;                       // ancho a media amplitud (0 = no medido)
+    u16 notch_ms;                       // pico -> muesca dicrota (0 = no hay)
+    u8  flags;                          // MORPH_F_*
+    u8  rsv;
+} MORPH_Beat;
+
+#define MORPH_F_NOTCH   0x01            // hay muesca dicrota
+#define MORPH_F_LOWQ    0x02            // alguna muestra con calidad baja (SQI)
+
+typedef struct {
+    s32 x[MORPH_WIN];                   // IR crudo desde el ultimo pico, Q8
+    u16 len;
+    u8  low_q;                          // de la ventana en curso
+    u8  primed;                         // x[0] es el pico de pend (falta su bajada)
+    MORPH_Beat pend;
+    s32 half_q8, hyst_q8;               // media amplitud e histeresis de pend
+    s32 pk_frac;                        // pico de pend en x[0] + pk_frac (Q8)
+    s32 up_q8;                          // subida a media amplitud, antes del pico
+    MORPH_Beat ring[MORPH_RING];
+    u32 seq;                            // registros escritos desde el inicio
+} MORPH_State;
+
+// Curva de calibracion R -> SpO2: n puntos equiespaciados desde r0, en
+// flash (const). Cada lote de sensor puede traer su propia tabla.
+typedef struct {
+    u32 r0_q16;                         // R del primer punto, Q16
+    u8  step_shift;                     // paso entre puntos = 1 << step_shift (Q16)
+    u8  n;
+    const u16 *spo2_q8;                 // SpO2 en cada punto, Q8
+} SPO2_Cal;
+
+// Latido en curso para SpO2 (enteros, comun a float y punto fijo)
+typedef struct {
+    s32 red_max, red_min;               // AC en Q8
+    s32 ir_max, ir_min;
+    u32 red_sum, ir_sum;                // crudo, para la DC media del latido
+    u16 len;                            // muestras acumuladas
+    u8  open;                           // 1 = ya hubo un pico (el latido tiene inicio)
+    u8  low_q;                          // SQI_F_* de sus muestras (OR)
+    u32 r_q16;                          // R del ultimo latido usado (0 = ninguno)
+    s32 spo2_q8;                        // estimacion suavizada (0 = ninguna)
+} SPO2_Beat;
+
+// Calidad de señal: acumuladores de la ventana en curso (enteros, comun a
+// float y punto fijo). x es el AC normalizado con el rms de la ventana
+// anterior (rms ~ 256, |x| <= 2047) para que x^4 quepa en 64 bits.
+typedef struct {
+    u64 s4;                             // suma x^4
+    u32 s2;                             // suma x^2
+    u64 e2;                             // suma AC^2 en Q4 (sin normalizar)
+    u32 dc_sum;                         // suma del IR crudo
+    s32 dc_q8;                          // DC por EMA (AC sin pasabanda)
+    s32 gain_q16;                       // normalizacion de x (0 = sin ventana previa)
+    u32 pi_ref_q24;                     // perfusion de referencia (ventanas buenas)
+    u16 n;
+    u16 hold;                           // muestras bloqueadas por recorte o salto
+    u16 kurt_q8;                        // curtosis de la ultima ventana
+    u8  win_flags;                      // motivos de la ultima ventana cerrada
+    u8  hold_flags;                     // recorte/salto mientras dura hold
+    u8  flags;                          // motivos vigentes
+    u8  pi_bad;                         // ventanas seguidas con perfusion fuera de rango
+} SQI_State;
+
+// ---- Canal PPG ---- //
+//
+// Todo el estado de un canal (un sensor / paciente): front end, detector de
+// HR, SpO2, temperaturas y las ultimas salidas. No hay estado de canal en
+// variables de archivo, asi que N canales se procesan uno tras otro con
+// PPG_ChannelProcess. Alineado a linea de cache para que dos canales no
+// compartan lineas; el estado caliente va primero y la salida del
+// pasabanda (solo vive durante un bloque) al final.
+
+typedef struct {
+#if HR_FIXED_POINT
+    // HR (Q8)
+    s32 dc;
+    s32 ac_prev2, ac_prev1, ac_curr;
+    s32 ac_peak;
+    s32 peak_frac;                      // posicion del ultimo pico, Q8 de muestra
+    s32 ac_trough;                      // minimo del AC desde el ultimo pico
+#else
+    // HR
+    float dc;
+    float ac_prev2, ac_prev1, ac_curr;
+    float ac_peak;
+    float peak_frac;                    // posicion del ultimo pico (muestras)
+    float ac_trough;                    // minimo del AC desde el ultimo pico
+#endif
+    int samples_since_beat;
+    int in_peak;
+    u32 sample_count;                   // muestras procesadas (reloj del canal)
+    HR_Rate rate;
+    HR_Acf acf;
+    HRV_State hrv;
+    AF_State af;
+    RESP_State resp;
+
+    // SpO2
+    SPO2_Beat spo2_beat;
+    const SPO2_Cal *spo2_cal;
+
+    // Morfologia por latido
+    MORPH_State morph;
+
+    // Calidad de señal
+    SQI_State sqi;
+
+    // Ultimas salidas y temperaturas validas; muestra en que se actualizo
+    // cada salida por ultima vez (vencen a los PPG_HOLD)
+    float bpm;
+    float spo2;
+    u32 bpm_at, spo2_at;
+    float Ta, To;
+
+    // Front end
+    int bq_primed;
+#if HR_FIXED_POINT
+    BQ_SectionQ bq[BQ_SECTIONS];
+    s32 bp_out[PPG_BLOCK_MAX][BQ_LANES];    // salida del bloque actual, Q8
+#else
+    BQ_SectionF bq[BQ_SECTIONS];
+    float bp_out[PPG_BLOCK_MAX][BQ_LANES];  // salida del bloque actual
+#endif
+
+    // Muestras del bloque actual en que el HR detecto un latido (SpO2 cierra
+    // ahi cada latido)
+    u8  beat_idx[PPG_BLOCK_MAX];
+    int beat_n;
+
+    // AC del detector en cada muestra del bloque actual (0 sin dedo)
+#if HR_FIXED_POINT
+    s32 ac_blk[PPG_BLOCK_MAX];          // Q8
+#else
+    float ac_blk[PPG_BLOCK_MAX];
+#endif
+
+    // SQI_F_* de cada muestra del bloque actual (HR y SpO2 solo usan los
+    // latidos que pasan SQI_BeatOk)
+    u8  sqi_low[PPG_BLOCK_MAX];
+} __attribute__((aligned(CACHE_LINE_BYTES))) PPG_Channel;
+
+// Init: todo a cero, temperaturas invalidas y calibracion por defecto.
+// Reset: solo el estado DSP (conserva temperaturas y calibracion).
+// Process: front end + calidad + HR + SpO2 sobre un bloque de
+// n <= PPG_BLOCK_MAX muestras en el orden de la FIFO; deja ch->bpm y
+// ch->spo2 (retenidos hasta PPG_HOLD_S mientras la calidad es baja, 0 si no
+// hay lectura) y devuelve cuantos latidos escribio en beats (hasta
+// max_beats; beats y t_ms pueden ser NULL si no interesan).
+void PPG_ChannelInit(PPG_Channel *ch);
+void PPG_ChannelReset(PPG_Channel *ch);
+int  PPG_ChannelProcess(PPG_Channel *ch, const u32 *red, const u32 *ir,
+                        const u32 *t_ms, int n, HR_Beat *beats, int max_beats);
+
+// Etapas por separado (PPG_FrontEndBlock va primero: HR y SpO2 leen su
+// salida por indice; SQI_UpdateBlock marca las muestras de calidad baja
+// antes del HR; SPO2_UpdateBlock va despues de HR_ProcessBlock y usa los
+// latidos que este marco en el bloque, para el SpO2 y la morfologia)
+void PPG_FrontEndBlock(PPG_Channel *ch, const u32 *red, const u32 *ir, int n);
+void SQI_UpdateBlock(PPG_Channel *ch, const u32 *red, const u32 *ir, int n);
+int  HR_ProcessBlock(PPG_Channel *ch, const u32 *ir, const u32 *t_ms, int n,
+                     HR_Beat *beats, int max_beats);
+void SPO2_UpdateBlock(PPG_Channel *ch, const u32 *red_raw, const u32 *ir_raw, int n);
+
+// Una muestra por llamada (bloques de 1)
+void PPG_FrontEnd(PPG_Channel *ch, u32 red, u32 ir);
+void HR_ProcessSample(PPG_Channel *ch, u32 ir, float *bpm_out);
+void SPO2_Update(PPG_Channel *ch, u32 red_raw, u32 ir_raw, float *spo2_out);
+
+// Calibracion de SpO2: curva del canal (por lote de sensor; la conserva
+// PPG_ChannelReset, XST_INVALID_PARAM si la tabla no es valida) y R (Q16)
+// -> SpO2 (Q8) por interpolacion lineal, saturando en los extremos
+int  SPO2_SetCalibration(PPG_Channel *ch, const SPO2_Cal *cal);
+u32  SPO2_Calibrate(const SPO2_Cal *cal, u32 r_q16);
+
+// Estado del detector para la onda y la energia del OLED (AC de la muestra
+// i del ultimo bloque)
+int   HR_FingerPresent(const PPG_Channel *ch);
+float HR_AcSample(const PPG_Channel *ch, int i);
+float HR_AcAmplitude(const PPG_Channel *ch);
+
+// Calidad de señal: 1 = ningun motivo de calidad baja; flags = SQI_F_* que
+// la tienen baja (0 = buena)
+int PPG_QualityOk(const PPG_Channel *ch);
+u8  PPG_QualityFlags(const PPG_Channel *ch);
+
+// Alarma de BPM (>= BPM_ALARM_THRESHOLD) con dedo y lectura fresca o
+// calidad buena (ver PPG_ALARM_FRESH_S); un ritmo irregular sin artefacto
+// pasa SQI_BeatOk y sigue sonando
+int PPG_BpmAlarm(const PPG_Channel *ch);
+
+// Latido utilizable segun los motivos SQI de su muestra: sin artefacto; la
+// periodicidad y la plantilla bajas solo cuentan si la plantilla cae sola
+// (movimiento sobre un ritmo regular). Una FA baja las dos y sigue midiendo.
+static inline int SQI_BeatOk(u8 sqi)
+{
+    return (sqi & ~SQI_F_RHYTHM) == 0 && sqi != SQI_F_TEMPLATE;
+}
+
+// HRV de la ventana corta (0) o larga (1), al ultimo latido
+#define HRV_SHORT       0
+#define HRV_LONG        1
+void HRV_Get(const PPG_Channel *ch, int win, HRV_Stats *out);
+
+// Ritmo irregular / FA: estado al ultimo latido y episodios cerrados
+// posteriores a *seq (el mas viejo primero, hasta max; avanza *seq como
+// MORPH_Read). Es un tamizaje: no distingue FA de otras arritmias.
+void AF_Get(const PPG_Channel *ch, AF_Stats *out);
+int  AF_ReadEpisodes(const PPG_Channel *ch, u32 *seq, AF_Episode *out, int max);
+
+// Frecuencia respiratoria en resp/min: fusion de las tres series (0 = sin
+// estimacion confiable) o una serie sola (RESP_BASE, RESP_AMP, RESP_FREQ)
+float RESP_Rate(const PPG_Channel *ch);
+float RESP_SeriesRate(const PPG_Channel *ch, int series);
+
+// Morfologia por latido: copia a out los registros posteriores a *seq (el
+// mas viejo primero, hasta max) y avanza *seq. Si el lector quedo mas de
+// MORPH_RING atras sigue desde el mas viejo que queda. Devuelve cuantos copio.
+int MORPH_Read(const PPG_Channel *ch, u32 *seq, MORPH_Beat *out, int max);
+
+// Estimador por autocorrelacion (0 mientras no hay ventana completa)
+float HR_AcfBpm(const PPG_Channel *ch);
+float HR_AcfConfidence(const PPG_Channel *ch);
+
+#if HR_FIXED_POINT
+
+// ---- HR BÁSICO (punto fijo) ---- //
+//
+// Especificacion bit-exacta (todas las señales en Q8 = cuentas * 256):
+//   x      = ir << 8
+//   dc    += (x - dc) >> 4                 (alpha 1/16)
+//   ac     = x - dc
+//   peak  += (|ac| - peak) >> 3            (alpha 1/8)
+//   thr    = max((peak * 77) >> 8, 5 << 8) (0.3 ~ 77/256, producto en 64 bits)
+//   suelta = ac < (thr * 77) >> 8
+//   d      = ((p2 - c) << 7) / (p2 - 2*p1 + c)   (vertice de la parabola, Q8)
+//   rr     = (n << 8) + d - d_anterior             (intervalo, Q8 de muestra)
+//   bpm    = (60*fs << 16) / rr                    (Q8, 0 fuera de 40..180)
+//   salida = HR_RateEstimate (ventana robusta, comun a las dos rutas)
+// Los shifts a la derecha de negativos son aritmeticos (GCC/ARM).
+
+#define HR_Q                8
+
+#endif
+
+// ===================== TENDENCIAS ===================== //
+//
+// Historia de BPM, SpO2, Ta y To en memoria fija: por señal y nivel
+// (1 s, 1 min, 15 min, 1 h) un anillo de cubetas min/max/suma/cuenta.
+// Cada actualizacion entra en los cuatro niveles (O(1); saltar cubetas
+// vacias cuesta una por periodo transcurrido) y las consultas juntan
+// cubetas del nivel mas fino que todavia cubre la ventana. Valores x100
+// en s16 (+-327), tiempos en ms del canal (32 bits: ~49 dias).
+
+#define TREND_BPM           0
+#define TREND_SPO2          1
+#define TREND_TA            2
+#define TREND_TO            3
+#define TREND_SIGNALS       4
+
+#define TREND_LEVELS        4
+#define TREND_DEPTH_1S      120         // 2 min
+#define TREND_DEPTH_1M      60          // 1 h
+#define TREND_DEPTH_15M     96          // 24 h
+#define TREND_DEPTH_1H      48          // 48 h
+// Cada anillo guarda depth + 1 cubetas: una ventana de depth periodos que no
+// empieza en un borde toca depth + 1 cubetas y tiene que entrar entera
+#define TREND_POOL          (TREND_DEPTH_1S + TREND_DEPTH_1M + \
+                             TREND_DEPTH_15M + TREND_DEPTH_1H + TREND_LEVELS)
+
+// Linea de resumen por UART cada TREND_PRINT_DECIM muestras (~1 min)
+#define TREND_PRINT_DECIM   MS_TO_SAMPLES(60000)
+
+typedef struct {
+    s64 sum;                            // x100
+    u32 n;                              // actualizaciones (0 = vacia)
+    s16 min, max;                       // x100
+} TREND_Bucket;
 
-static float spo2_dc_ir  = 0.0f;
-static float spo2_dc_red = 0.0f;
-static float spo2_ac_ir  = 0.0f;
-static float spo2_ac_red = 0.0f;
+typedef struct {
+    TREND_Bucket b[TREND_SIGNALS][TREND_POOL];  // niveles uno tras otro
+    u32 last[TREND_SIGNALS][TREND_LEVELS];      // periodo de la cubeta mas nueva
+    u16 head[TREND_SIGNALS][TREND_LEVELS];      // y su lugar en el anillo
+    u32 first_s[TREND_SIGNALS];                 // primer dato (s): antes no hay nada
+    u8  primed[TREND_SIGNALS];
+} TREND_Store;
 
-// Últimas temperaturas válidas
-static float g_Ta = -1000.0f;
-static float g_To = -1000.0f;
+typedef struct {
+    s16 min, max, mean;                 // x100 (0 si n = 0)
+    u32 n;
+    u32 t0_ms, t1_ms;                   // lapso que cubren las cubetas usadas
+} TREND_Summary;
+
+// Push: un valor de la señal en t_ms. PushChannel: BPM y SpO2 del canal
+// cuando el bloque trajo latidos que pasan SQI_BeatOk (las temperaturas
+// entran con TREND_Push al leerlas).
+// Query: resumen de [t0_ms, t1_ms) con todas las cubetas que la tocan, del
+// nivel mas fino que la tiene entera (desde el primer dato); devuelve el
+// nivel usado (-1 sin datos). Las cubetas de los bordes entran completas:
+// out->t0_ms/t1_ms dicen el lapso que se resumio en realidad.
+void TREND_Init(TREND_Store *tr);
+void TREND_Push(TREND_Store *tr, int sig, u32 t_ms, float v);
+void TREND_PushChannel(TREND_Store *tr, const PPG_Channel *ch);
+int  TREND_Query(const TREND_Store *tr, int sig, u32 t0_ms, u32 t1_ms,
+                 TREND_Summary *out);
+
+// Canal del sensor de esta placa y su historia (la historia no se borra
+// con PPG_ChannelReset)
+static PPG_Channel ppg_ch0;
+static TREND_Store trend0;
 
 // ===================== MAIN ===================== //
 
@@ -175,61 +939,211 @@ int main(void)
         return XST_FAILURE;
     }
 
-    HR_Init();
+    PPG_Channel *ch = &ppg_ch0;
+    PPG_ChannelInit(ch);
+    TREND_Init(&trend0);
 
     xil_printf("Sensores listos. Coloca el dedo sobre el MAX y mira OLED.\r\n");
 
-    float bpm  = 0.0f;
-    float spo2 = 0.0f;
-
     int print_counter = 0;
+    int hrv_counter   = 0;
+    int trend_counter = 0;
     int oled_counter  = 0;
+    u32 morph_seq     = 0;
+    u32 af_seq        = 0;
 
     while (1) {
-        u32 red, ir;
-
-        Status = Max30102_ReadLatestRedIR(&red, &ir);
-        if (Status == XST_SUCCESS) {
-
-            // Procesa BPM y SpO2  (NO TOCO ESTO)
-            HR_ProcessSample(ir, &bpm);
-            SPO2_Update(red, ir, &spo2);
+        u32 red_blk[PPG_BLOCK_MAX], ir_blk[PPG_BLOCK_MAX];
+        int n;
+
+        // Toda la rafaga pendiente de la FIFO (normalmente 1 muestra; mas si
+        // el OLED o el MLX retrasaron la vuelta)
+        Status = Max30102_ReadFifo(red_blk, ir_blk, PPG_BLOCK_MAX, &n);
+        if (Status == XST_SUCCESS && n > 0) {
+            u32 red = red_blk[n - 1];
+            u32 ir  = ir_blk[n - 1];
+
+            // Toda la rafaga de una vez: pasabanda, calidad, BPM y SpO2
+            // (sin tiempos ni latidos sueltos: aca solo se usan ch->bpm/spo2)
+            PPG_ChannelProcess(ch, red_blk, ir_blk, NULL, n, NULL, 0);
+            TREND_PushChannel(&trend0, ch);
+            float bpm  = ch->bpm;
+            float spo2 = ch->spo2;
+            u32 now_ms = ch->sample_count * (1000 / SAMPLE_RATE_HZ);
+
+#if OLED_WAVE_ENABLE
+            // Onda en vivo: reusa el AC y la amplitud que ya estima el HR;
+            // una columna por muestra de la rafaga, asi el eje de tiempo no
+            // depende de cuanto se atraso la vuelta
+            if (HR_FingerPresent(ch)) {
+                float amp = HR_AcAmplitude(ch);
+                for (int i = 0; i < n; i++) {
+                    WAVE_AddSample(HR_AcSample(ch, i), amp);
+                }
+            }
+#endif
 
             // --- CONTROL DEL BUZZER SEGÚN BPM ---
-            int bpm_int_for_buzzer = (int)(bpm + 0.5f);  // redondear BPM
-
-            // *** SUENA CUANDO BPM >= 105 ***
-            if (bpm_int_for_buzzer >= 105) {
+            // *** SUENA CUANDO BPM >= BPM_ALARM_THRESHOLD (105) ***
+            // (con dedo y un BPM que no quedo retenido por un artefacto; un
+            // ritmo irregular tambien tiene que sonar)
+            int alarm = PPG_BpmAlarm(ch);
+            if (alarm) {
                 XGpio_DiscreteWrite(&BuzzerGpio, BUZZER_GPIO_CHANNEL, BUZZER_ON);
             } else {
                 XGpio_DiscreteWrite(&BuzzerGpio, BUZZER_GPIO_CHANNEL, BUZZER_OFF);
             }
 
             // UART cada PRINT_DECIM muestras
-            print_counter++;
+            print_counter += n;
             if (print_counter >= PRINT_DECIM) {
                 print_counter = 0;
 
-                int bpm10  = (int)(bpm  * 10.0f);
-                int spo210 = (int)(spo2 * 10.0f);
+                char uart_line[160];
+                char *p = FMT_Str(uart_line, "RED=");
+                p = FMT_Int(p, (s32)red, 0);
+                p = FMT_Str(p, " IR=");
+                p = FMT_Int(p, (s32)ir, 0);
+                p = FMT_Str(p, "  BPM=");
+                p = FMT_Float(p, bpm, 1, 0);
+                p = FMT_Str(p, " ACF=");
+                p = FMT_Float(p, HR_AcfBpm(ch), 1, 0);
+                p = FMT_Str(p, "/");
+                p = FMT_Float(p, HR_AcfConfidence(ch), 2, 0);
+                p = FMT_Str(p, "  SpO2=");
+                p = FMT_Float(p, spo2, 1, 0);
+                p = FMT_Str(p, "  RESP=");
+                p = FMT_Float(p, RESP_Rate(ch), 1, 0);
+                p = FMT_Str(p, "  Q=");
+                p = FMT_Int(p, PPG_QualityFlags(ch), 0);
+                p = FMT_Str(p, "  Ta=");
+                p = FMT_Float(p, ch->Ta, 2, 0);
+                p = FMT_Str(p, "  To=");
+                FMT_Float(p, ch->To, 2, 0);
+
+                xil_printf("%s\r\n", uart_line);
+            }
+
+            // HRV (ventana corta y larga): RMSSD/SDNN en ms, pNN50 en %
+            hrv_counter += n;
+            if (hrv_counter >= HRV_PRINT_DECIM) {
+                hrv_counter = 0;
+
+                char hrv_line[128];
+                char *p = FMT_Str(hrv_line, "HRV");
+                for (int w = HRV_SHORT; w <= HRV_LONG; w++) {
+                    HRV_Stats st;
+                    HRV_Get(ch, w, &st);
+                    p = FMT_Str(p, " ");
+                    p = FMT_Int(p, (w == HRV_SHORT) ? HRV_WIN_SHORT_S : HRV_WIN_LONG_S, 0);
+                    p = FMT_Str(p, "s: RMSSD=");
+                    p = FMT_Fixed(p, st.rmssd_x10, 1, 0);
+                    p = FMT_Str(p, " SDNN=");
+                    p = FMT_Fixed(p, st.sdnn_x10, 1, 0);
+                    p = FMT_Str(p, " pNN50=");
+                    p = FMT_Fixed(p, st.pnn50_x10, 1, 0);
+                    p = FMT_Str(p, " n=");
+                    p = FMT_Int(p, st.n, 0);
+                }
+
+                xil_printf("%s\r\n", hrv_line);
+
+                // Ritmo: CV, puntos de giro y entropia x1000; I = ventana
+                // irregular, E = episodio abierto
+                AF_Stats af;
+                AF_Get(ch, &af);
+                char af_line[96];
+                p = FMT_Str(af_line, "AF CV=");
+                p = FMT_Int(p, af.cv_x1000, 0);
+                p = FMT_Str(p, " TPR=");
+                p = FMT_Int(p, af.tpr_x1000, 0);
+                p = FMT_Str(p, " ShE=");
+                p = FMT_Int(p, af.she_x1000, 0);
+                p = FMT_Str(p, " n=");
+                p = FMT_Int(p, af.n, 0);
+                p = FMT_Str(p, af.irregular ? " I" : " -");
+                if (af.active) {
+                    p = FMT_Str(p, " E desde t=");
+                    FMT_Int(p, (s32)af.start_ms, 0);
+                }
+
+                xil_printf("%s\r\n", af_line);
+            }
+
+            // Resumen del ultimo minuto por señal: min/media/max y cuenta
+            trend_counter += n;
+            if (trend_counter >= TREND_PRINT_DECIM) {
+                trend_counter = 0;
+
+                static const char *const trend_name[TREND_SIGNALS] = {
+                    " BPM=", " SpO2=", " Ta=", " To="
+                };
+                char trend_line[192];
+                char *p = FMT_Str(trend_line, "TREND 60s:");
+                // En el primer minuto desde 0 (now_ms - 60000 daria la vuelta)
+                u32 from_ms = (now_ms > 60000) ? now_ms - 60000 : 0;
+                for (int sig = 0; sig < TREND_SIGNALS; sig++) {
+                    TREND_Summary sm;
+                    TREND_Query(&trend0, sig, from_ms, now_ms + 1, &sm);
+                    p = FMT_Str(p, trend_name[sig]);
+                    p = FMT_Fixed(p, sm.min, 2, 0);
+                    p = FMT_Str(p, "/");
+                    p = FMT_Fixed(p, sm.mean, 2, 0);
+                    p = FMT_Str(p, "/");
+                    p = FMT_Fixed(p, sm.max, 2, 0);
+                    p = FMT_Str(p, " n=");
+                    p = FMT_Int(p, (s32)sm.n, 0);
+                }
+
+                xil_printf("%s\r\n", trend_line);
+            }
+
+            // Episodios de ritmo irregular ya cerrados (ms del canal)
+            AF_Episode ep[2];
+            int ne = AF_ReadEpisodes(ch, &af_seq, ep, 2);
+            for (int k = 0; k < ne; k++) {
+                char ep_line[64];
+                char *p = FMT_Str(ep_line, "AF EPISODIO t=");
+                p = FMT_Int(p, (s32)ep[k].start_ms, 0);
+                p = FMT_Str(p, "..");
+                FMT_Int(p, (s32)ep[k].end_ms, 0);
+
+                xil_printf("%s\r\n", ep_line);
+            }
 
-                xil_printf("RED=%lu IR=%lu  BPM=%d.%d  SpO2=%d.%d  Ta=%.2f  To=%.2f\r\n",
-                           (unsigned long)red,
-                           (unsigned long)ir,
-                           bpm10 / 10,  bpm10 % 10,
-                           spo210 / 10, spo210 % 10,
-                           g_Ta, g_To);
+            // Morfologia: una linea por latido terminado (PI en %, tiempos en ms)
+            MORPH_Beat mb[4];
+            int nm = MORPH_Read(ch, &morph_seq, mb, 4);
+            for (int k = 0; k < nm; k++) {
+                char beat_line[96];
+                char *p = FMT_Str(beat_line, "BEAT t=");
+                p = FMT_Int(p, (s32)mb[k].t_ms, 0);
+                p = FMT_Str(p, " RR=");
+                p = FMT_Int(p, mb[k].rr_ms, 0);
+                p = FMT_Str(p, " PI=");
+                p = FMT_Fixed(p, mb[k].pi_x100, 2, 0);
+                p = FMT_Str(p, " rise=");
+                p = FMT_Int(p, mb[k].rise_ms, 0);
+                p = FMT_Str(p, " w50=");
+                p = FMT_Int(p, mb[k].width_ms, 0);
+                p = FMT_Str(p, " notch=");
+                p = FMT_Int(p, mb[k].notch_ms, 0);
+                p = FMT_Str(p, " F=");
+                FMT_Int(p, mb[k].flags, 0);
+
+                xil_printf("%s\r\n", beat_line);
             }
 
             // OLED cada OLED_UPDATE_DECIM muestras
-            oled_counter++;
+            oled_counter += n;
             if (oled_counter >= OLED_UPDATE_DECIM) {
                 oled_counter = 0;
 
                 // Leer temperaturas (una vez por actualización)
                 float Ta = MLX90614_ReadTemp(MLX_REG_TA);
                 if (Ta != -999.0f) {
-                    g_Ta = Ta;
+                    ch->Ta = Ta;
+                    TREND_Push(&trend0, TREND_TA, now_ms, Ta);
                 }
 
                 // pequeño delay antes de leer To
@@ -237,17 +1151,28 @@ int main(void)
 
                 float To = MLX90614_ReadTemp(MLX_REG_TOBJ1);
                 if (To != -999.0f) {
-                    g_To = To;
+                    ch->To = To;
+                    TREND_Push(&trend0, TREND_TO, now_ms, To);
                 }
 
-                OLED_ShowVitals(bpm, g_Ta, g_To, spo2);
+                // Atenuar/apagar sin dedo, parpadeo con alarma; apagado no se
+                // dibuja. Con dedo y calidad baja los valores van con '?'
+                // (retenidos; a los PPG_HOLD_S pasan a "---")
+                int low_q = HR_FingerPresent(ch) && !SQI_BeatOk(PPG_QualityFlags(ch));
+                OLED_PowerUpdate(HR_FingerPresent(ch), alarm);
+                if (OLED_IsOn()) {
+                    OLED_ShowVitals(bpm, ch->Ta, ch->To, spo2, low_q);
+                }
             }
 
-        } else {
+        } else if (Status != XST_SUCCESS) {
             xil_printf("Error lectura Red/IR: %d\r\n", Status);
         }
 
-        usleep(SAMPLE_PERIOD_US);  // ~50 Hz
+        // Avanza el envio del frame en vuelo (no bloquea por el frame completo)
+        OLED_Service();
+
+        usleep(SAMPLE_PERIOD_US);  // una vuelta por muestra (SAMPLE_RATE_HZ)
     }
 
     return 0;
@@ -369,8 +1294,9 @@ int Max30102_Init_Config(void)
     I2C_WriteReg(MAX_ADDR, 0x05, 0x00); // OVF_COUNTER
     I2C_WriteReg(MAX_ADDR, 0x06, 0x00); // FIFO_RD_PTR
 
-    // FIFO_CONFIG (0x08): SMP_AVE=0, rollover habilitado, no se bloquea porque si se llena, sobreescribe
-    I2C_WriteReg(MAX_ADDR, 0x08, 0x0F);
+    // FIFO_CONFIG (0x08): SMP_AVE segun SAMPLE_RATE_HZ (100 Hz / SMP_AVE en la FIFO),
+    // rollover habilitado, no se bloquea porque si se llena, sobreescribe
+    I2C_WriteReg(MAX_ADDR, 0x08, MAX_FIFO_CONFIG);
 
     // SPO2_CONFIG (0x0A): rango ADC bajo, 100 Hz, 18 bits, para alta resolución, datasheet 
     I2C_WriteReg(MAX_ADDR, 0x0A, 0x27);
@@ -389,43 +1315,41 @@ int Max30102_Init_Config(void)
     return XST_SUCCESS;
 }
 
-int Max30102_ReadLatestRedIR(u32 *red, u32 *ir)
+// Vacia la FIFO en una sola rafaga I2C: hasta max muestras, en orden
+// (la mas vieja primero). *count = muestras leidas.
+int Max30102_ReadFifo(u32 *red, u32 *ir, int max, int *count)
 {
-    u8 wrPtr, rdPtr; // punteros de lectura de la FIFO 
+    u8 ptrs[3]; // FIFO_WR_PTR, OVF_COUNTER, FIFO_RD_PTR (registros 0x04..0x06)
+    u8 buf[6 * PPG_BLOCK_MAX]; // 3 bytes para RED y 3 para IR por muestra
     int Status;
 
-    //Hallamos muestras nuevas
-    Status = I2C_ReadReg(MAX_ADDR, 0x04, &wrPtr); // FIFO_WR_PTR, posicion donde MAX escrbie la muestra
-    if (Status != XST_SUCCESS) return Status;
+    *count = 0;
 
-    Status = I2C_ReadReg(MAX_ADDR, 0x06, &rdPtr); // FIFO_RD_PTR, posicion actual
+    //Hallamos muestras nuevas, los tres punteros en una lectura
+    Status = I2C_ReadMulti(MAX_ADDR, 0x04, ptrs, 3);
     if (Status != XST_SUCCESS) return Status;
 
-    int numSamples = (wrPtr - rdPtr) & 0x1F;  // FIFO de 32 muestras
-
-    if (numSamples == 0) {
-        *red = 0;
-        *ir  = 0;
-        return XST_SUCCESS; // Si no es 0 aun hay datos por procesar
+    int numSamples = (ptrs[0] - ptrs[2]) & 0x1F;  // FIFO de 32 muestras
+    if (numSamples == 0 && ptrs[1] != 0) {
+        numSamples = 32;                           // desbordo: FIFO llena
     }
+    if (numSamples > max) numSamples = max;
+    if (numSamples > PPG_BLOCK_MAX) numSamples = PPG_BLOCK_MAX;
+    if (numSamples == 0) return XST_SUCCESS;
 
-    // Leer todas las muestras pendientes y quedarnos con la última
-    for (int i = 0; i < numSamples; i++) {
-        u8 buf[6]; // 3 bytes para IR y 3 para red
-        Status = I2C_ReadMulti(MAX_ADDR, 0x07, buf, 6);
-        if (Status != XST_SUCCESS) return Status;
-
-        // Junta los 3 bits de cada canal, reconstruye las de 24 bits y las deja como de 18 bits
-        u32 red24 = ((u32)buf[0] << 16) | ((u32)buf[1] << 8) | buf[2];
-        u32 ir24  = ((u32)buf[3] << 16) | ((u32)buf[4] << 8) | buf[5];
+    // FIFO_DATA no autoincrementa: leer 6*n bytes seguidos saca n muestras
+    Status = I2C_ReadMulti(MAX_ADDR, 0x07, buf, 6 * numSamples);
+    if (Status != XST_SUCCESS) return Status;
 
-        red24 &= 0x3FFFF; // El sensor usa 18 bits utiles 
-        ir24  &= 0x3FFFF;
+    for (int i = 0; i < numSamples; i++) {
+        const u8 *b = &buf[6 * i];
 
-        *red = red24;
-        *ir  = ir24;
+        // Junta los 3 bytes de cada canal (24 bits) y deja los 18 bits utiles
+        red[i] = (((u32)b[0] << 16) | ((u32)b[1] << 8) | b[2]) & 0x3FFFF;
+        ir[i]  = (((u32)b[3] << 16) | ((u32)b[4] << 8) | b[5]) & 0x3FFFF;
     }
 
+    *count = numSamples;
     return XST_SUCCESS;
 }
 
@@ -468,19 +1392,94 @@ float MLX90614_ReadTemp(u8 regAddr)
     return (float)raw * 0.02f - 273.15f;
 }
 
+// ===================== FORMATO NUMERICO ===================== //
+
+#define FMT_MAX_DECIMALS    4
+
+static const s32 FMT_POW10[FMT_MAX_DECIMALS + 1] = { 1, 10, 100, 1000, 10000 };
+
+char *FMT_Str(char *dst, const char *s)
+{
+    while (*s) *dst++ = *s++;
+    *dst = '\0';
+    return dst;
+}
+
+// v es el valor ya escalado por 10^decimals: FMT_Fixed(dst, 724, 1, 5) -> " 72.4"
+char *FMT_Fixed(char *dst, s32 v, int decimals, int width)
+{
+    char tmp[16];
+    int  n = 0;
+    u32  u = (v < 0) ? (0u - (u32)v) : (u32)v;
+
+    // Digitos al reves: decimales, punto, parte entera (al menos un 0)
+    for (int i = 0; i < decimals; i++) {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    }
+    if (decimals > 0) tmp[n++] = '.';
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) tmp[n++] = '-';
+
+    for (int i = n; i < width; i++) *dst++ = ' ';
+    while (n > 0) *dst++ = tmp[--n];
+    *dst = '\0';
+    return dst;
+}
+
+char *FMT_Int(char *dst, s32 v, int width)
+{
+    return FMT_Fixed(dst, v, 0, width);
+}
+
+// q en formato Q(frac_bits), redondeado a 'decimals' decimales
+char *FMT_Q(char *dst, s32 q, int frac_bits, int decimals, int width)
+{
+    s64 v = (s64)q * FMT_POW10[decimals];
+    s64 half = (frac_bits > 0) ? ((s64)1 << (frac_bits - 1)) : 0;
+
+    v = (v >= 0) ? ((v + half) >> frac_bits) : -((-v + half) >> frac_bits);
+    return FMT_Fixed(dst, (s32)v, decimals, width);
+}
+
+char *FMT_Float(char *dst, float f, int decimals, int width)
+{
+    float scaled = f * (float)FMT_POW10[decimals];
+    s32 v = (s32)(scaled + ((scaled >= 0.0f) ? 0.5f : -0.5f));
+    return FMT_Fixed(dst, v, decimals, width);
+}
+
 // ===================== OLED IMPLEMENTACIÓN ===================== //
 
-int OLED_SendCommand(u8 cmd)
+// Maximo de bytes de comando que se empaquetan en una sola transaccion
+#define OLED_CMD_LIST_MAX   32
+
+// Manda una secuencia de comandos en UNA transaccion I2C: el SSD1306 acepta
+// un flujo continuo de comandos despues de un solo byte de control 0x00.
+int OLED_SendCommandList(const u8 *cmds, u32 len)
 {
-    u8 buf[2];
+    u8 buf[1 + OLED_CMD_LIST_MAX];
+
+    if (len == 0 || len > OLED_CMD_LIST_MAX) return XST_INVALID_PARAM;
+
     buf[0] = 0x00;
-    buf[1] = cmd;
-    int Status = XIicPs_MasterSendPolled(&IicInstance, buf, 2, OLED_ADDR);
+    memcpy(&buf[1], cmds, len);
+
+    int Status = XIicPs_MasterSendPolled(&IicInstance, buf, 1 + len, OLED_ADDR);
     if (Status != XST_SUCCESS) return Status;
     while (XIicPs_BusIsBusy(&IicInstance));
+    oled_stat_bytes += 1 + len;
     return XST_SUCCESS;
 }
 
+int OLED_SendCommand(u8 cmd)
+{
+    return OLED_SendCommandList(&cmd, 1);
+}
+
 int OLED_SendData(const u8 *data, u32 len)
 {
     u8 buf[1 + 128];
@@ -495,6 +1494,7 @@ int OLED_SendData(const u8 *data, u32 len)
         Status = XIicPs_MasterSendPolled(&IicInstance, buf, 1 + chunk, OLED_ADDR);
         if (Status != XST_SUCCESS) return Status;
         while (XIicPs_BusIsBusy(&IicInstance));
+        oled_stat_bytes += 1 + chunk;
 
         data += chunk;
         len  -= chunk;
@@ -502,24 +1502,53 @@ int OLED_SendData(const u8 *data, u32 len)
     return XST_SUCCESS;
 }
  //Mnada la secuencia estandar de config del controlador 
+#if OLED_PANEL == OLED_PANEL_SH1106_128x64
+static const u8 OLED_INIT_CMDS[] = {
+    0xAE,               // display off
+    0xD5, 0x80,         // reloj
+    0xA8, 0x3F,         // multiplex 64
+    0xD3, 0x00,         // offset
+    0x40,               // start line 0
+    0xAD, 0x8B,         // DC-DC interno on
+    0x32,               // bomba 8.0 V
+    0xA1,               // segment remap
+    0xC8,               // COM scan descendente
+    0xDA, 0x12,         // COM pins (alternado)
+    0x81, OLED_CONTRAST, // contraste
+    0xD9, 0x22,         // precarga
+    0xDB, 0x35,         // VCOMH
+    0xA4,               // sigue la RAM
+    0xA6                // normal (no invertido)
+};
+#else
+static const u8 OLED_INIT_CMDS[] = {
+    0xAE,               // display off
+    0xD5, 0x80,         // reloj
+    0xA8, OLED_HEIGHT - 1, // multiplex
+    0xD3, 0x00,         // offset
+    0x40,               // start line 0
+    0x8D, 0x14,         // charge pump on
+    0x20, 0x00,         // direccionamiento horizontal
+    0xA1,               // segment remap
+    0xC8,               // COM scan descendente
+#if OLED_HEIGHT == 32
+    0xDA, 0x02,         // COM pins (secuencial)
+#else
+    0xDA, 0x12,         // COM pins (alternado)
+#endif
+    0x81, OLED_CONTRAST, // contraste
+    0xD9, 0xF1,         // precarga
+    0xDB, 0x40,         // VCOMH
+    0xA4,               // sigue la RAM
+    0xA6                // normal (no invertido)
+};
+#endif
+
 void OLED_Init(void)
 {
     // Apaga display, configura reloj, limpia buffer, enciende display
-    OLED_SendCommand(0xAE);
-    OLED_SendCommand(0xD5); OLED_SendCommand(0x80);
-    OLED_SendCommand(0xA8); OLED_SendCommand(0x1F);
-    OLED_SendCommand(0xD3); OLED_SendCommand(0x00);
-    OLED_SendCommand(0x40);
-    OLED_SendCommand(0x8D); OLED_SendCommand(0x14);
-    OLED_SendCommand(0x20); OLED_SendCommand(0x00);
-    OLED_SendCommand(0xA1);
-    OLED_SendCommand(0xC8);
-    OLED_SendCommand(0xDA); OLED_SendCommand(0x02);
-    OLED_SendCommand(0x81); OLED_SendCommand(0x8F);
-    OLED_SendCommand(0xD9); OLED_SendCommand(0xF1);
-    OLED_SendCommand(0xDB); OLED_SendCommand(0x40);
-    OLED_SendCommand(0xA4);
-    OLED_SendCommand(0xA6);
+    OLED_SendCommandList(OLED_INIT_CMDS, sizeof(OLED_INIT_CMDS));
+    OLED_BuildBigCache();
     OLED_ClearBuffer();
     OLED_Update();
     OLED_SendCommand(0xAF);
@@ -530,20 +1559,148 @@ void OLED_ClearBuffer(void)
     memset(oled_buffer, 0x00, sizeof(oled_buffer));
 }
 
+// Envio bloqueante del frame completo (solo se usa al arrancar)
 void OLED_Update(void)
 {
-    OLED_SendCommand(0x21);
-    OLED_SendCommand(0);
-    OLED_SendCommand(OLED_WIDTH - 1);
+    OLED_WriteRegion(0, OLED_WIDTH - 1, 0, OLED_PAGES - 1,
+                     oled_buffer, sizeof(oled_buffer));
+}
+
+// Escribe data en la ventana columnas x0..x1, paginas page0..page1. Cada
+// escritura fija su propia ventana, asi los envios parciales se pueden
+// intercalar con otros accesos al bus (MAX/MLX) sin perder la posicion.
+// data va pagina por pagina (x0..x1 de page0, luego de page0+1, ...).
+int OLED_WriteRegion(int x0, int x1, int page0, int page1, const u8 *data, u32 len)
+{
+#if OLED_ADDR_MODE == OLED_ADDR_HORIZONTAL
+    u8 window[6] = {
+        0x21, (u8)(x0 + OLED_COL_OFFSET), (u8)(x1 + OLED_COL_OFFSET),
+        0x22, (u8)page0, (u8)page1
+    };
+    int Status = OLED_SendCommandList(window, sizeof(window));
+    if (Status != XST_SUCCESS) return Status;
+
+    return OLED_SendData(data, len);
+#else
+    // Modo pagina: la columna no pasa sola a la pagina siguiente
+    u32 w = (u32)(x1 - x0 + 1);
+    u8  col = (u8)(x0 + OLED_COL_OFFSET);
+
+    for (int page = page0; page <= page1 && len >= w; page++) {
+        u8 cmds[3] = { (u8)(0xB0 | page), (u8)(0x00 | (col & 0x0F)), (u8)(0x10 | (col >> 4)) };
+        int Status = OLED_SendCommandList(cmds, sizeof(cmds));
+        if (Status != XST_SUCCESS) return Status;
+
+        Status = OLED_SendData(data, w);
+        if (Status != XST_SUCCESS) return Status;
+
+        data += w;
+        len  -= w;
+    }
+    return XST_SUCCESS;
+#endif
+}
+
+// Entrega el frame dibujado en oled_buffer. Si no hay nada en vuelo se copia
+// a oled_front y arranca el envio; si hay un frame en vuelo solo se marca
+// pendiente, y al terminar se toma lo que haya en back en ese momento (los
+// frames nuevos reemplazan a los viejos, no se encolan).
+void OLED_Present(void)
+{
+    if (oled_xfer_busy) {
+        oled_frame_pending = 1;
+        return;
+    }
+
+    memcpy(oled_front, oled_buffer, sizeof(oled_front));
+    oled_xfer_pos  = 0;
+    oled_xfer_busy = 1;
+    oled_stat_frames++;
+}
 
-    OLED_SendCommand(0x22);
-    OLED_SendCommand(0);
-    OLED_SendCommand(OLED_PAGES - 1);
+// Se llama en cada vuelta del while() principal: manda un pedazo de
+// OLED_XFER_CHUNK bytes del frame en vuelo y vuelve.
+void OLED_Service(void)
+{
+    if (!oled_xfer_busy) return;
+
+    int page = oled_xfer_pos / OLED_WIDTH;
+    int col  = oled_xfer_pos % OLED_WIDTH;
+    u32 chunk = OLED_WIDTH - col;       // el pedazo no cruza de pagina
+    if (chunk > OLED_XFER_CHUNK) chunk = OLED_XFER_CHUNK;
+
+    OLED_WriteRegion(col, col + chunk - 1, page, page,
+                     &oled_front[oled_xfer_pos], chunk);
+
+    oled_xfer_pos += chunk;
+    if (oled_xfer_pos >= sizeof(oled_front)) {
+        oled_xfer_busy = 0;
+        if (oled_frame_pending) {
+            oled_frame_pending = 0;
+            OLED_Present();
+        }
+    }
+}
+
+// Vuelca un framebuffer como PBM ASCII (P1) por UART: copiar desde la linea
+// "P1" hasta el final a un .pbm para ver exactamente lo que se dibujo. En
+// los comentarios van los frames entregados y los bytes I2C desde el
+// volcado anterior.
+void OLED_DumpPBM(const u8 *fb)
+{
+    char row[OLED_WIDTH + 1];
+
+    xil_printf("P1\r\n# frames=%d bytes_i2c=%d\r\n%d %d\r\n",
+               (int)oled_stat_frames, (int)oled_stat_bytes, OLED_WIDTH, OLED_HEIGHT);
+
+    for (int y = 0; y < OLED_HEIGHT; y++) {
+        const u8 *page = &fb[(y >> 3) * OLED_WIDTH];
+        u8 bit = (u8)(1 << (y & 7));
 
-    for (int page = 0; page < OLED_PAGES; page++) {
-        const u8 *p = &oled_buffer[page * OLED_WIDTH];
-        OLED_SendData(p, OLED_WIDTH);
+        for (int x = 0; x < OLED_WIDTH; x++) {
+            row[x] = (page[x] & bit) ? '1' : '0';
+        }
+        row[OLED_WIDTH] = '\0';
+        xil_printf("%s\r\n", row);
     }
+
+    oled_stat_frames = 0;
+    oled_stat_bytes  = 0;
+}
+
+int OLED_SetContrast(u8 level)
+{
+    u8 cmds[2] = { 0x81, level };
+    return OLED_SendCommandList(cmds, sizeof(cmds));
+}
+
+// Scroll horizontal continuo de las paginas page0..page1. interval es el
+// codigo de 3 bits del datasheet (0 = 5 frames ... 7 = 2 frames).
+int OLED_StartHScroll(int left, u8 page0, u8 page1, u8 interval)
+{
+#if !OLED_HAS_HW_SCROLL
+    (void)left; (void)page0; (void)page1; (void)interval;
+    return XST_NO_FEATURE;
+#else
+    u8 cmds[] = {
+        0x2E,                           // parar scroll antes de reconfigurar
+        left ? 0x27 : 0x26,
+        0x00, page0, (u8)(interval & 0x07), page1,
+        0x00, 0xFF,
+        0x2F                            // activar scroll
+    };
+    return OLED_SendCommandList(cmds, sizeof(cmds));
+#endif
+}
+
+int OLED_StopScroll(void)
+{
+#if !OLED_HAS_HW_SCROLL
+    return XST_NO_FEATURE;
+#else
+    static const u8 cmds[] = { 0x2E };  // desactivar scroll
+    return OLED_SendCommandList(cmds, sizeof(cmds));
+#endif
 }
 
 void OLED_DrawPixel(int x, int y, int on)
@@ -560,7 +1717,13 @@ void OLED_DrawPixel(int x, int y, int on)
         *byte &= ~(1 << bit);
 }
 
-void OLED_FillRect(int x0, int y0, int x1, int y1, int on)
+// Operaciones sobre rectangulos por bytes de pagina: mascara en la primera y
+// ultima pagina, memset en las paginas completas.
+#define OLED_OP_CLEAR   0
+#define OLED_OP_SET     1
+#define OLED_OP_INVERT  2
+
+static void OLED_RectOp(int x0, int y0, int x1, int y1, int op)
 {
     if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
     if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
@@ -570,330 +1733,2751 @@ void OLED_FillRect(int x0, int y0, int x1, int y1, int on)
     if (x1 >= OLED_WIDTH)  x1 = OLED_WIDTH - 1;
     if (y1 >= OLED_HEIGHT) y1 = OLED_HEIGHT - 1;
 
-    for (int x = 0; x <= x1; x++) {
-        for (int y = 0; y <= y1; y++) {
-            OLED_DrawPixel(x, y, on);
-        }
-    }
-}
+    if (x0 > x1 || y0 > y1) return; // fuera de pantalla
 
-// ===================== FUENTE 6x8 ===================== //
+    int p0 = y0 >> 3;
+    int p1 = y1 >> 3;
+    int w  = x1 - x0 + 1;
 
-typedef struct {
-    u8 rows[8];
-} Glyph6x8;
+    for (int page = p0; page <= p1; page++) {
+        u8 mask = 0xFF;
+        if (page == p0) mask &= (u8)(0xFF << (y0 & 7));
+        if (page == p1) mask &= (u8)(0xFF >> (7 - (y1 & 7)));
 
-static const Glyph6x8 GLYPH_SPACE = {{0,0,0,0,0,0,0,0}};
-static const Glyph6x8 GLYPH_MINUS = {{0x00,0x00,0x0E,0x0E,0x00,0x00,0x00,0x00}};
-static const Glyph6x8 GLYPH_DOT   = {{0x00,0x00,0x00,0x00,0x04,0x04,0x00,0x00}};
-static const Glyph6x8 GLYPH_COLON = {{0x04,0x04,0x00,0x00,0x04,0x04,0x00,0x00}};
-static const Glyph6x8 GLYPH_EQUAL = {{0x00,0x00,0x0E,0x00,0x0E,0x00,0x00,0x00}};
-
-static const Glyph6x8 GLYPH_0 = {{0x0E,0x11,0x11,0x11,0x11,0x11,0x0E,0x00}};
-static const Glyph6x8 GLYPH_1 = {{0x04,0x0C,0x04,0x04,0x04,0x04,0x0E,0x00}};
-static const Glyph6x8 GLYPH_2 = {{0x0E,0x11,0x10,0x0E,0x01,0x01,0x1F,0x00}};
-static const Glyph6x8 GLYPH_3 = {{0x0E,0x11,0x10,0x0E,0x10,0x11,0x0E,0x00}};
-static const Glyph6x8 GLYPH_4 = {{0x11,0x11,0x11,0x1F,0x10,0x10,0x10,0x00}};
-static const Glyph6x8 GLYPH_5 = {{0x1F,0x01,0x01,0x0E,0x10,0x11,0x0E,0x00}};
-static const Glyph6x8 GLYPH_6 = {{0x0E,0x01,0x01,0x0F,0x11,0x11,0x0E,0x00}};
-static const Glyph6x8 GLYPH_7 = {{0x1F,0x10,0x08,0x04,0x02,0x02,0x02,0x00}};
-static const Glyph6x8 GLYPH_8 = {{0x0E,0x11,0x11,0x0E,0x11,0x11,0x0E,0x00}};
-static const Glyph6x8 GLYPH_9 = {{0x0E,0x11,0x11,0x0F,0x10,0x10,0x0E,0x00}};
-
-static const Glyph6x8 GLYPH_B = {{0x0F,0x11,0x11,0x0F,0x11,0x11,0x0F,0x00}};
-static const Glyph6x8 GLYPH_P = {{0x0F,0x11,0x11,0x0F,0x01,0x01,0x01,0x00}};
-static const Glyph6x8 GLYPH_M = {{0x11,0x1B,0x15,0x15,0x11,0x11,0x11,0x00}};
-
-static const Glyph6x8 GLYPH_T = {{0x1F,0x04,0x04,0x04,0x04,0x04,0x04,0x00}};
-static const Glyph6x8 GLYPH_a = {{0x00,0x0E,0x10,0x1E,0x11,0x1E,0x00,0x00}};
-static const Glyph6x8 GLYPH_o = {{0x00,0x0E,0x11,0x11,0x11,0x0E,0x00,0x00}};
-static const Glyph6x8 GLYPH_C = {{0x0E,0x11,0x01,0x01,0x01,0x11,0x0E,0x00}};
-static const Glyph6x8 GLYPH_S = {{0x0E,0x11,0x03,0x0E,0x18,0x11,0x0E,0x00}};
-static const Glyph6x8 GLYPH_p = {{0x00,0x1E,0x11,0x11,0x1E,0x01,0x01,0x00}};
-static const Glyph6x8 GLYPH_O = {{0x0E,0x11,0x11,0x11,0x11,0x11,0x0E,0x00}};
-
-static const Glyph6x8* OLED_GetGlyph(char c)
-{
-    switch (c) {
-    case '0': return &GLYPH_0;
-    case '1': return &GLYPH_1;
-    case '2': return &GLYPH_2;
-    case '3': return &GLYPH_3;
-    case '4': return &GLYPH_4;
-    case '5': return &GLYPH_5;
-    case '6': return &GLYPH_6;
-    case '7': return &GLYPH_7;
-    case '8': return &GLYPH_8;
-    case '9': return &GLYPH_9;
-
-    case 'B': return &GLYPH_B;
-    case 'P': return &GLYPH_P;
-    case 'M': return &GLYPH_M;
-
-    case 'T': return &GLYPH_T;
-    case 'a': return &GLYPH_a;
-    case 'o': return &GLYPH_o;
-    case 'C': return &GLYPH_C;
-    case 'S': return &GLYPH_S;
-    case 'p': return &GLYPH_p;
-    case 'O': return &GLYPH_O;
-
-    case ':': return &GLYPH_COLON;
-    case '.': return &GLYPH_DOT;
-    case '-': return &GLYPH_MINUS;
-    case '=': return &GLYPH_EQUAL;
-    case ' ':
-    default:
-        return &GLYPH_SPACE;
-    }
-}
+        u8 *row = &oled_buffer[page * OLED_WIDTH + x0];
 
-void OLED_ClearTopLine(void)
-{
-    for (int y = 0; y < 8; y++) {
-        for (int x = 0; x < OLED_WIDTH; x++) {
-            OLED_DrawPixel(x, y, 0);
+        if (mask == 0xFF && op != OLED_OP_INVERT) {
+            memset(row, (op == OLED_OP_SET) ? 0xFF : 0x00, w);
+        } else if (op == OLED_OP_SET) {
+            for (int i = 0; i < w; i++) row[i] |= mask;
+        } else if (op == OLED_OP_CLEAR) {
+            for (int i = 0; i < w; i++) row[i] &= (u8)~mask;
+        } else {
+            for (int i = 0; i < w; i++) row[i] ^= mask;
         }
     }
 }
 
-void OLED_DrawChar6x8(int x, int y, char c)
+void OLED_FillRect(int x0, int y0, int x1, int y1, int on)
 {
-    const Glyph6x8 *g = OLED_GetGlyph(c);
-    for (int row = 0; row < 8; row++) {
-        u8 pattern = g->rows[row];
-        for (int col = 0; col < 5; col++) {
-            int on = (pattern & (1 << col)) ? 1 : 0;
-            OLED_DrawPixel(x + col, y + row, on);
-        }
-        OLED_DrawPixel(x + 5, y + row, 0);
-    }
+    OLED_RectOp(x0, y0, x1, y1, on ? OLED_OP_SET : OLED_OP_CLEAR);
 }
 
-void OLED_DrawString6x8(int x, int y, const char *s)
+void OLED_ClearRect(int x0, int y0, int x1, int y1)
 {
-    while (*s && x <= (OLED_WIDTH - 6)) {
-        OLED_DrawChar6x8(x, y, *s++);
-        x += 6;
-    }
+    OLED_RectOp(x0, y0, x1, y1, OLED_OP_CLEAR);
 }
 
-void OLED_ShowVitals(float bpm, float Ta, float To, float spo2)
+void OLED_InvertRect(int x0, int y0, int x1, int y1)
 {
-    char line[40];
+    OLED_RectOp(x0, y0, x1, y1, OLED_OP_INVERT);
+}
 
-    OLED_ClearBuffer();
+void OLED_DrawHLine(int x0, int x1, int y, int on)
+{
+    OLED_RectOp(x0, y, x1, y, on ? OLED_OP_SET : OLED_OP_CLEAR);
+}
 
-    // Línea 0: BPM
-    {
-        int bpm10 = (int)(bpm * 10.0f + 0.5f);
-        if (bpm10 <= 0) {
-            snprintf(line, sizeof(line), "BPM: ---.-");
-        } else {
-            int entero  = bpm10 / 10;
-            int decimal = bpm10 % 10;
-            if (entero > 999) entero = 999;
-            snprintf(line, sizeof(line), "BPM: %3d.%1d", entero, decimal);
-        }
-        OLED_DrawString6x8(0, 0, line);
-    }
+void OLED_DrawVLine(int x, int y0, int y1, int on)
+{
+    OLED_RectOp(x, y0, x, y1, on ? OLED_OP_SET : OLED_OP_CLEAR);
+}
 
-    // Línea 1: Ta y To
-    {
-        if (Ta < -50.0f || Ta > 100.0f) {
-            snprintf(line, sizeof(line), "Ta: --.-C To: --.-C");
-        } else {
-            int ta10 = (int)(Ta * 10.0f + 0.5f);
-            int ta_e = ta10 / 10;
-            int ta_d = (ta10 >= 0) ? (ta10 % 10) : -(ta10 % 10);
+// ===================== FUENTE 6x8 ===================== //
+//
+// Glifos guardados por columnas, en el mismo formato de pagina del SSD1306:
+// cada byte es una columna de 8 pixeles, bit 0 = fila superior. Asi un
+// caracter alineado a pagina (y multiplo de 8) es una copia de 6 bytes, y uno
+// desalineado se reparte entre dos paginas con un shift + OR.
 
-            if (To < -50.0f || To > 100.0f) {
-                snprintf(line, sizeof(line), "Ta:%3d.%1dC To: --.-C",
-                         ta_e, ta_d);
-            } else {
-                int to10 = (int)(To * 10.0f + 0.5f);
-                int to_e = to10 / 10;
-                int to_d = (to10 >= 0) ? (to10 % 10) : -(to10 % 10);
+#define GLYPH_W     6
 
-                snprintf(line, sizeof(line), "Ta:%3d.%1dC To:%3d.%1dC",
-                         ta_e, ta_d, to_e, to_d);
-            }
-        }
-        OLED_DrawString6x8(0, 8, line);
-    }
+typedef struct {
+    u8 cols[GLYPH_W];
+} Glyph6x8;
 
-    // Línea 2: SpO2
-    {
-        if (spo2 <= 0.0f) {
-            snprintf(line, sizeof(line), "SpO2: ---.-");
-        } else {
-            int spo210 = (int)(spo2 * 10.0f + 0.5f);
-            int se = spo210 / 10;
-            int sd = spo210 % 10;
-            if (se > 100) se = 100;
-            snprintf(line, sizeof(line), "SpO2: %3d.%1d", se, sd);
-        }
-        OLED_DrawString6x8(0, 16, line);
-    }
+// ASCII imprimible 0x20..0x7E en una sola tabla const (queda en .rodata),
+// indexada por c - 0x20. Fuente 5x7 clasica + columna de separacion.
+// La tabla sale de tools/font6x8.txt con tools/font6x8.py (--write); el
+// build de Vitis compila esta copia tal cual, y "make test" en test/host
+// verifica que coincida con el .txt.
+#define FONT_FIRST  0x20
+#define FONT_LAST   0x7E
+
+static const Glyph6x8 FONT6x8[FONT_LAST - FONT_FIRST + 1] = {
+    {{0x00,0x00,0x00,0x00,0x00,0x00}}, // 0x20 espacio
+    {{0x00,0x00,0x5F,0x00,0x00,0x00}}, // 0x21 !
+    {{0x00,0x07,0x00,0x07,0x00,0x00}}, // 0x22 "
+    {{0x14,0x7F,0x14,0x7F,0x14,0x00}}, // 0x23 #
+    {{0x24,0x2A,0x7F,0x2A,0x12,0x00}}, // 0x24 $
+    {{0x23,0x13,0x08,0x64,0x62,0x00}}, // 0x25 %
+    {{0x36,0x49,0x55,0x22,0x50,0x00}}, // 0x26 &
+    {{0x00,0x05,0x03,0x00,0x00,0x00}}, // 0x27 '
+    {{0x00,0x1C,0x22,0x41,0x00,0x00}}, // 0x28 (
+    {{0x00,0x41,0x22,0x1C,0x00,0x00}}, // 0x29 )
+    {{0x08,0x2A,0x1C,0x2A,0x08,0x00}}, // 0x2A *
+    {{0x08,0x08,0x3E,0x08,0x08,0x00}}, // 0x2B +
+    {{0x00,0x50,0x30,0x00,0x00,0x00}}, // 0x2C ,
+    {{0x08,0x08,0x08,0x08,0x08,0x00}}, // 0x2D -
+    {{0x00,0x60,0x60,0x00,0x00,0x00}}, // 0x2E .
+    {{0x20,0x10,0x08,0x04,0x02,0x00}}, // 0x2F /
+    {{0x3E,0x51,0x49,0x45,0x3E,0x00}}, // 0x30 0
+    {{0x00,0x42,0x7F,0x40,0x00,0x00}}, // 0x31 1
+    {{0x42,0x61,0x51,0x49,0x46,0x00}}, // 0x32 2
+    {{0x21,0x41,0x45,0x4B,0x31,0x00}}, // 0x33 3
+    {{0x18,0x14,0x12,0x7F,0x10,0x00}}, // 0x34 4
+    {{0x27,0x45,0x45,0x45,0x39,0x00}}, // 0x35 5
+    {{0x3C,0x4A,0x49,0x49,0x30,0x00}}, // 0x36 6
+    {{0x01,0x71,0x09,0x05,0x03,0x00}}, // 0x37 7
+    {{0x36,0x49,0x49,0x49,0x36,0x00}}, // 0x38 8
+    {{0x06,0x49,0x49,0x29,0x1E,0x00}}, // 0x39 9
+    {{0x00,0x36,0x36,0x00,0x00,0x00}}, // 0x3A :
+    {{0x00,0x56,0x36,0x00,0x00,0x00}}, // 0x3B ;
+    {{0x08,0x14,0x22,0x41,0x00,0x00}}, // 0x3C <
+    {{0x14,0x14,0x14,0x14,0x14,0x00}}, // 0x3D =
+    {{0x00,0x41,0x22,0x14,0x08,0x00}}, // 0x3E >
+    {{0x02,0x01,0x51,0x09,0x06,0x00}}, // 0x3F ?
+    {{0x32,0x49,0x79,0x41,0x3E,0x00}}, // 0x40 @
+    {{0x7E,0x11,0x11,0x11,0x7E,0x00}}, // 0x41 A
+    {{0x7F,0x49,0x49,0x49,0x36,0x00}}, // 0x42 B
+    {{0x3E,0x41,0x41,0x41,0x22,0x00}}, // 0x43 C
+    {{0x7F,0x41,0x41,0x22,0x1C,0x00}}, // 0x44 D
+    {{0x7F,0x49,0x49,0x49,0x41,0x00}}, // 0x45 E
+    {{0x7F,0x09,0x09,0x09,0x01,0x00}}, // 0x46 F
+    {{0x3E,0x41,0x49,0x49,0x7A,0x00}}, // 0x47 G
+    {{0x7F,0x08,0x08,0x08,0x7F,0x00}}, // 0x48 H
+    {{0x00,0x41,0x7F,0x41,0x00,0x00}}, // 0x49 I
+    {{0x20,0x40,0x41,0x3F,0x01,0x00}}, // 0x4A J
+    {{0x7F,0x08,0x14,0x22,0x41,0x00}}, // 0x4B K
+    {{0x7F,0x40,0x40,0x40,0x40,0x00}}, // 0x4C L
+    {{0x7F,0x02,0x0C,0x02,0x7F,0x00}}, // 0x4D M
+    {{0x7F,0x04,0x08,0x10,0x7F,0x00}}, // 0x4E N
+    {{0x3E,0x41,0x41,0x41,0x3E,0x00}}, // 0x4F O
+    {{0x7F,0x09,0x09,0x09,0x06,0x00}}, // 0x50 P
+    {{0x3E,0x41,0x51,0x21,0x5E,0x00}}, // 0x51 Q
+    {{0x7F,0x09,0x19,0x29,0x46,0x00}}, // 0x52 R
+    {{0x46,0x49,0x49,0x49,0x31,0x00}}, // 0x53 S
+    {{0x01,0x01,0x7F,0x01,0x01,0x00}}, // 0x54 T
+    {{0x3F,0x40,0x40,0x40,0x3F,0x00}}, // 0x55 U
+    {{0x1F,0x20,0x40,0x20,0x1F,0x00}}, // 0x56 V
+    {{0x3F,0x40,0x38,0x40,0x3F,0x00}}, // 0x57 W
+    {{0x63,0x14,0x08,0x14,0x63,0x00}}, // 0x58 X
+    {{0x07,0x08,0x70,0x08,0x07,0x00}}, // 0x59 Y
+    {{0x61,0x51,0x49,0x45,0x43,0x00}}, // 0x5A Z
+    {{0x00,0x7F,0x41,0x41,0x00,0x00}}, // 0x5B [
+    {{0x02,0x04,0x08,0x10,0x20,0x00}}, // 0x5C barra invertida
+    {{0x00,0x41,0x41,0x7F,0x00,0x00}}, // 0x5D ]
+    {{0x04,0x02,0x01,0x02,0x04,0x00}}, // 0x5E ^
+    {{0x40,0x40,0x40,0x40,0x40,0x00}}, // 0x5F _
+    {{0x00,0x01,0x02,0x04,0x00,0x00}}, // 0x60 `
+    {{0x20,0x54,0x54,0x54,0x78,0x00}}, // 0x61 a
+    {{0x7F,0x48,0x44,0x44,0x38,0x00}}, // 0x62 b
+    {{0x38,0x44,0x44,0x44,0x20,0x00}}, // 0x63 c
+    {{0x38,0x44,0x44,0x48,0x7F,0x00}}, // 0x64 d
+    {{0x38,0x54,0x54,0x54,0x18,0x00}}, // 0x65 e
+    {{0x08,0x7E,0x09,0x01,0x02,0x00}}, // 0x66 f
+    {{0x0C,0x52,0x52,0x52,0x3E,0x00}}, // 0x67 g
+    {{0x7F,0x08,0x04,0x04,0x78,0x00}}, // 0x68 h
+    {{0x00,0x44,0x7D,0x40,0x00,0x00}}, // 0x69 i
+    {{0x20,0x40,0x44,0x3D,0x00,0x00}}, // 0x6A j
+    {{0x7F,0x10,0x28,0x44,0x00,0x00}}, // 0x6B k
+    {{0x00,0x41,0x7F,0x40,0x00,0x00}}, // 0x6C l
+    {{0x7C,0x04,0x18,0x04,0x78,0x00}}, // 0x6D m
+    {{0x7C,0x08,0x04,0x04,0x78,0x00}}, // 0x6E n
+    {{0x38,0x44,0x44,0x44,0x38,0x00}}, // 0x6F o
+    {{0x7C,0x14,0x14,0x14,0x08,0x00}}, // 0x70 p
+    {{0x08,0x14,0x14,0x18,0x7C,0x00}}, // 0x71 q
+    {{0x7C,0x08,0x04,0x04,0x08,0x00}}, // 0x72 r
+    {{0x48,0x54,0x54,0x54,0x20,0x00}}, // 0x73 s
+    {{0x04,0x3F,0x44,0x40,0x20,0x00}}, // 0x74 t
+    {{0x3C,0x40,0x40,0x20,0x7C,0x00}}, // 0x75 u
+    {{0x1C,0x20,0x40,0x20,0x1C,0x00}}, // 0x76 v
+    {{0x3C,0x40,0x30,0x40,0x3C,0x00}}, // 0x77 w
+    {{0x44,0x28,0x10,0x28,0x44,0x00}}, // 0x78 x
+    {{0x0C,0x50,0x50,0x50,0x3C,0x00}}, // 0x79 y
+    {{0x44,0x64,0x54,0x4C,0x44,0x00}}, // 0x7A z
+    {{0x00,0x08,0x36,0x41,0x00,0x00}}, // 0x7B {
+    {{0x00,0x00,0x7F,0x00,0x00,0x00}}, // 0x7C |
+    {{0x00,0x41,0x36,0x08,0x00,0x00}}, // 0x7D }
+    {{0x08,0x04,0x08,0x10,0x08,0x00}}, // 0x7E ~
+};
+
+static inline const Glyph6x8* OLED_GetGlyph(char c)
+{
+    u8 idx = (u8)c - FONT_FIRST;
 
-    OLED_Update();
+    // Fuera de rango (control, >0x7E) se pinta como espacio
+    if (idx > FONT_LAST - FONT_FIRST) idx = 0;
+    return &FONT6x8[idx];
 }
 
-// ===================== HR ===================== //
-
-void HR_Init(void)
+void OLED_ClearTopLine(void)
 {
-    dc_est = 0.0f;
-    ac_prev2 = ac_prev1 = ac_curr = 0.0f;
-    ac_peak_est = 0.0f;
-    samples_since_beat = 0;
-    in_peak = 0;
+    memset(oled_buffer, 0x00, OLED_WIDTH); // pagina 0 completa
+}
 
-    for (int i = 0; i < BPM_HISTORY_LEN; i++) {
-        bpm_hist[i] = 0.0f;
-    }
-    bpm_hist_count = 0;
-    bpm_hist_index = 0;
+// Pinta n caracteres a partir de (x, y). El recorte vertical se resuelve una
+// sola vez por cadena; por caracter solo se recortan columnas si el glifo
+// queda parcialmente fuera de pantalla.
+static void OLED_BlitGlyphs6x8(int x, int y, const char *s, int n)
+{
+    if (y <= -8 || y >= OLED_HEIGHT) return;
 
-    spo2_dc_ir  = 0.0f;
-    spo2_dc_red = 0.0f;
-    spo2_ac_ir  = 0.0f;
-    spo2_ac_red = 0.0f;
+    int page  = y >> 3;
+    int shift = y & 7;
 
-    g_Ta = -1000.0f;
-    g_To = -1000.0f;
-}
+    // Pagina superior (lo) e inferior (hi) que toca la fila de texto
+    u8 *lo = (page >= 0) ? &oled_buffer[page * OLED_WIDTH] : NULL;
+    u8 *hi = (shift != 0 && page + 1 < OLED_PAGES) ? &oled_buffer[(page + 1) * OLED_WIDTH] : NULL;
 
-void HR_ProcessSample(u32 ir, float *bpm_out)
-{
-    samples_since_beat++;
+    u8 keep_lo = (u8)~(0xFF << shift);
+    u8 keep_hi = (u8)~(0xFF >> (8 - shift));
 
-    const float alpha_inv = 16.0f;
-    dc_est += ((float)ir - dc_est) / alpha_inv;
+    for (int i = 0; i < n; i++, x += GLYPH_W) {
+        if (x <= -GLYPH_W || x >= OLED_WIDTH) continue;
 
-    if (dc_est < DC_FINGER_MIN) {
-        samples_since_beat = 0;
-        in_peak = 0;
+        const u8 *g = OLED_GetGlyph(s[i])->cols;
 
-        for (int i = 0; i < BPM_HISTORY_LEN; i++) {
-            bpm_hist[i] = 0.0f;
+        // Caso rapido: glifo completo y alineado a pagina
+        if (shift == 0 && x >= 0 && x <= OLED_WIDTH - GLYPH_W) {
+            memcpy(&lo[x], g, GLYPH_W);
+            continue;
         }
-        bpm_hist_count = 0;
-        bpm_hist_index = 0;
 
-        *bpm_out = 0.0f;
-        return;
-    }
+        int c0 = (x < 0) ? -x : 0;
+        int c1 = (x > OLED_WIDTH - GLYPH_W) ? (OLED_WIDTH - x) : GLYPH_W;
 
-    ac_prev2 = ac_prev1;
-    ac_prev1 = ac_curr;
-    ac_curr  = (float)ir - dc_est;
-
-    float ac_abs = (ac_curr > 0) ? ac_curr : -ac_curr;
+        for (int c = c0; c < c1; c++) {
+            if (lo) lo[x + c] = (u8)((lo[x + c] & keep_lo) | (g[c] << shift));
+            if (hi) hi[x + c] = (u8)((hi[x + c] & keep_hi) | (g[c] >> (8 - shift)));
+        }
+    }
+}
 
-    const float peak_alpha_inv = 8.0f;
-    ac_peak_est += (ac_abs - ac_peak_est) / peak_alpha_inv;
+void OLED_DrawChar6x8(int x, int y, char c)
+{
+    OLED_BlitGlyphs6x8(x, y, &c, 1);
+}
 
-    float dynamic_thresh = ac_peak_est * 0.3f;
-    if (dynamic_thresh < 5.0f) {
-        dynamic_thresh = 5.0f;
+void OLED_DrawString6x8(int x, int y, const char *s)
+{
+    // Solo caracteres completos hacia la derecha, igual que antes
+    int n = 0;
+    while (s[n] && x + n * GLYPH_W <= (OLED_WIDTH - GLYPH_W)) {
+        n++;
     }
+    OLED_BlitGlyphs6x8(x, y, s, n);
+}
 
-    const float BPM_MIN = 40.0f;
-    const float BPM_MAX = 180.0f;
+// ===================== DIGITOS GRANDES ===================== //
+//
+// Fuentes de 16 px (x2) y 24 px (x3) generadas una sola vez al arrancar
+// escalando FONT6x8. Se guardan ya en formato de pagina, asi pintar un
+// digito grande es copiar 2 o 3 filas de bytes, sin rasterizar.
 
-    int min_samples_between_beats = (int)(0.4f * (float)SAMPLE_RATE_HZ);
+#define BIG_CHARS       "0123456789-. "
+#define BIG_NCHARS      13
+#define BIG16_W         (GLYPH_W * 2)
+#define BIG24_W         (GLYPH_W * 3)
 
-    float bpm_display = *bpm_out;
+static u8 big16_cache[BIG_NCHARS][2][BIG16_W];
+static u8 big24_cache[BIG_NCHARS][3][BIG24_W];
 
-    if (!in_peak &&
-        (ac_prev1 > ac_prev2) &&
-        (ac_prev1 > ac_curr) &&
-        (ac_prev1 > dynamic_thresh) &&
-        (samples_since_beat > min_samples_between_beats))
-    {
-        float inst_bpm = 60.0f * (float)SAMPLE_RATE_HZ / (float)samples_since_beat;
+static int OLED_BigIndex(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c == '-') return 10;
+    if (c == '.') return 11;
+    return 12;  // espacio / cualquier otro
+}
 
-        if (inst_bpm >= BPM_MIN && inst_bpm <= BPM_MAX) {
-            bpm_hist[bpm_hist_index] = inst_bpm;
-            bpm_hist_index = (bpm_hist_index + 1) % BPM_HISTORY_LEN;
-            if (bpm_hist_count < BPM_HISTORY_LEN) {
-                bpm_hist_count++;
+// Escala un glifo 6x8 por 'scale' y lo deja en dst[pagina][columna]
+static void OLED_ScaleGlyph(u8 *dst, int scale, char c)
+{
+    const u8 *g = OLED_GetGlyph(c)->cols;
+    int w = GLYPH_W * scale;
+
+    for (int col = 0; col < GLYPH_W; col++) {
+        u32 word = 0;
+        for (int row = 0; row < 8; row++) {
+            if (g[col] & (1 << row)) {
+                word |= ((1u << scale) - 1) << (row * scale);
             }
-
-            float sum = 0.0f;
-            for (int i = 0; i < bpm_hist_count; i++) {
-                sum += bpm_hist[i];
+        }
+        for (int sx = 0; sx < scale; sx++) {
+            for (int p = 0; p < scale; p++) {
+                dst[p * w + col * scale + sx] = (u8)(word >> (p * 8));
             }
-            bpm_display = sum / (float)bpm_hist_count;
         }
-
-        samples_since_beat = 0;
-        in_peak = 1;
-    }
-
-    if (in_peak && ac_curr < dynamic_thresh * 0.3f) {
-        in_peak = 0;
     }
-
-    *bpm_out = bpm_display;
 }
 
-// ===================== SpO2 ===================== //
-
-void SPO2_Update(u32 red_raw, u32 ir_raw, float *spo2_out)
+void OLED_BuildBigCache(void)
 {
-    float red = (float)red_raw;
-    float ir  = (float)ir_raw;
+    const char *chars = BIG_CHARS;
 
-    if (red_raw < 8000 || ir_raw < 8000) {
-        *spo2_out = 0.0f;
-        return;
+    for (int i = 0; i < BIG_NCHARS; i++) {
+        OLED_ScaleGlyph(&big16_cache[i][0][0], 2, chars[i]);
+        OLED_ScaleGlyph(&big24_cache[i][0][0], 3, chars[i]);
     }
+}
 
-    const float dc_alpha_inv = 50.0f;
-    spo2_dc_ir  += (ir  - spo2_dc_ir)  / dc_alpha_inv;
-    spo2_dc_red += (red - spo2_dc_red) / dc_alpha_inv;
-
-    float ir_ac_sample  = ir  - spo2_dc_ir;
-    float red_ac_sample = red - spo2_dc_red;
+// Copia un digito grande del cache en la columna x a partir de 'page'
+static void OLED_BlitBig(int x, int page, int scale, char c)
+{
+    int idx = OLED_BigIndex(c);
+    int w   = GLYPH_W * scale;
+    const u8 *src = (scale == 2) ? &big16_cache[idx][0][0] : &big24_cache[idx][0][0];
 
-    float ir_ac_abs  = (ir_ac_sample  > 0) ? ir_ac_sample  : -ir_ac_sample;
-    float red_ac_abs = (red_ac_sample > 0) ? red_ac_sample : -red_ac_sample;
+    if (x < 0 || x + w > OLED_WIDTH || page < 0 || page + scale > OLED_PAGES) return;
 
-    const float ac_alpha_inv = 50.0f;
-    spo2_ac_ir  += (ir_ac_abs  - spo2_ac_ir)  / ac_alpha_inv;
-    spo2_ac_red += (red_ac_abs - spo2_ac_red) / ac_alpha_inv;
+    for (int p = 0; p < scale; p++) {
+        memcpy(&oled_buffer[(page + p) * OLED_WIDTH + x], &src[p * w], w);
+    }
+}
 
-    float spo2_inst;
+// ===================== PANTALLAS ===================== //
+//
+// Cada valor en pantalla es un campo que recuerda lo que ya pinto; solo se
+// vuelven a pintar los caracteres que cambiaron, y si nada cambio no se
+// entrega frame. Las pantallas rotan cada OLED_SCREEN_DECIM actualizaciones.
 
-    if (spo2_dc_ir  > 1000.0f &&
-        spo2_dc_red > 1000.0f &&
-        spo2_ac_ir  >   10.0f &&
-        spo2_ac_red >   10.0f)
-    {
-        float num = (spo2_ac_red / spo2_dc_red);
-        float den = (spo2_ac_ir  / spo2_dc_ir);
+#define OLED_FIELD_MAX  20
 
-        if (den > 1e-6f) {
-            float R = num / den;
+typedef struct {
+    u8   x;
+    u8   page;
+    u8   scale;     // 1 = 6x8, 2 = 16 px, 3 = 24 px
+    u8   nchars;
+    char last[OLED_FIELD_MAX];
+} OLED_Field;
+
+#define SCREEN_SUMMARY  0   // texto + onda
+#define SCREEN_HR       1   // BPM grande
+#define SCREEN_SPO2     2   // SpO2 grande
+#define SCREEN_COUNT    3
+
+static int oled_screen         = SCREEN_SUMMARY;
+static int oled_screen_counter = 0;
+static int oled_screen_fresh   = 1;    // recien cambiada: falta dibujar todo
+
+// Resumen
+static OLED_Field fld_sum_bpm  = { 0, 0, 1, 10, {0} };
+#if OLED_WAVE_ENABLE
+static OLED_Field fld_sum_spo2 = { 62, 0, 1, 11, {0} };
+#else
+static OLED_Field fld_sum_spo2 = { 0, 2, 1, 11, {0} };
+#endif
+static OLED_Field fld_sum_temp = { 0, 1, 1, 19, {0} };
+
+// BPM grande: 3 digitos de 24 px, SpO2 de 16 px al lado, temperatura abajo
+static OLED_Field fld_hr_big   = { 0, 0, 3, 3, {0} };
+static OLED_Field fld_hr_label = { 60, 0, 1, 4, {0} };
+static OLED_Field fld_hr_spo2  = { 60, 1, 2, 3, {0} };
+static OLED_Field fld_hr_unit  = { 98, 1, 1, 5, {0} };
+static OLED_Field fld_hr_temp  = { 0, 3, 1, 19, {0} };
+
+// SpO2 grande
+static OLED_Field fld_sp_big   = { 0, 0, 3, 3, {0} };
+static OLED_Field fld_sp_label = { 60, 0, 1, 5, {0} };
+static OLED_Field fld_sp_bpm   = { 60, 1, 2, 3, {0} };
+static OLED_Field fld_sp_unit  = { 98, 1, 1, 4, {0} };
+static OLED_Field fld_sp_temp  = { 0, 3, 1, 19, {0} };
+
+static OLED_Field *const oled_fields[] = {
+    &fld_sum_bpm, &fld_sum_spo2, &fld_sum_temp,
+    &fld_hr_big, &fld_hr_label, &fld_hr_spo2, &fld_hr_unit, &fld_hr_temp,
+    &fld_sp_big, &fld_sp_label, &fld_sp_bpm, &fld_sp_unit, &fld_sp_temp
+};
+
+// Pinta s en el campo (rellena con espacios). Devuelve 1 si algo cambio.
+static int OLED_DrawField(OLED_Field *f, const char *s)
+{
+    int changed = 0;
+    int cw = GLYPH_W * f->scale;
 
-            spo2_inst = -20.0f * R + 110.0f;
+    for (int i = 0; i < f->nchars; i++) {
+        char c = *s ? *s++ : ' ';
+        if (c == f->last[i]) continue;
 
-            if (spo2_inst > 100.0f) spo2_inst = 100.0f;
-            if (spo2_inst < 80.0f)  spo2_inst = 80.0f;
+        f->last[i] = c;
+        changed = 1;
+
+        if (f->scale == 1) {
+            OLED_BlitGlyphs6x8(f->x + i * cw, f->page * 8, &c, 1);
         } else {
-            return;
+            OLED_BlitBig(f->x + i * cw, f->page, f->scale, c);
         }
+    }
+    return changed;
+}
+
+static void OLED_SetScreen(int screen)
+{
+    oled_screen       = screen;
+    oled_screen_fresh = 1;
+
+    // Olvidar lo pintado: todos los campos se redibujan
+    for (u32 i = 0; i < sizeof(oled_fields) / sizeof(oled_fields[0]); i++) {
+        memset(oled_fields[i]->last, 0, OLED_FIELD_MAX);
+    }
+
+    OLED_ClearBuffer();
+    if (screen == SCREEN_SUMMARY) {
+        WAVE_Reset();
+    }
+}
+
+// Valor entero para los digitos grandes ("---" si no hay lectura)
+static void OLED_BigValue(char *dst, float v, int max)
+{
+    int vi = (int)(v + 0.5f);
+    if (v <= 0.0f) {
+        FMT_Str(dst, "---");
     } else {
-        return;
+        if (vi > max) vi = max;
+        FMT_Int(dst, vi, 3);
+    }
+}
+
+// "Ta: 25.3C To: 36.6C"
+static void OLED_TempLine(char *line, float Ta, float To)
+{
+    char *p = FMT_Str(line, "Ta:");
+    if (Ta < -50.0f || Ta > 100.0f) {
+        p = FMT_Str(p, " --.-");
+    } else {
+        p = FMT_Float(p, Ta, 1, 5);
+    }
+
+    p = FMT_Str(p, "C To:");
+    if (To < -50.0f || To > 100.0f) {
+        p = FMT_Str(p, " --.-");
+    } else {
+        p = FMT_Float(p, To, 1, 5);
+    }
+    FMT_Str(p, "C");
+}
+
+static int OLED_DrawSummary(float bpm, float Ta, float To, float spo2, int low_q)
+{
+    char line[40];
+    int changed = 0;
+
+    // BPM
+    {
+        int bpm10 = (int)(bpm * 10.0f + 0.5f);
+        char *p = FMT_Str(line, low_q ? "BPM? " : "BPM: ");
+        if (bpm10 <= 0) {
+            FMT_Str(p, "---.-");
+        } else {
+            if (bpm10 > 9999) bpm10 = 9999;
+            FMT_Fixed(p, bpm10, 1, 5);
+        }
+        changed |= OLED_DrawField(&fld_sum_bpm, line);
+    }
+
+    // Ta y To
+    OLED_TempLine(line, Ta, To);
+    changed |= OLED_DrawField(&fld_sum_temp, line);
+
+    // SpO2 (con la onda activa va al lado del BPM en la línea 0)
+    {
+        char *p = FMT_Str(line, low_q ? "SpO2? " : "SpO2: ");
+        if (spo2 <= 0.0f) {
+            FMT_Str(p, "---.-");
+        } else {
+            int spo210 = (int)(spo2 * 10.0f + 0.5f);
+            if (spo210 > 1000) spo210 = 1000;
+            FMT_Fixed(p, spo210, 1, 5);
+        }
+        changed |= OLED_DrawField(&fld_sum_spo2, line);
+    }
+
+    return changed;
+}
+
+static int OLED_DrawHR(float bpm, float Ta, float To, float spo2, int low_q)
+{
+    char line[40];
+    int changed = 0;
+
+    OLED_BigValue(line, bpm, 999);
+    changed |= OLED_DrawField(&fld_hr_big, line);
+    changed |= OLED_DrawField(&fld_hr_label, low_q ? "BPM?" : "BPM");
+
+    OLED_BigValue(line, spo2, 100);
+    changed |= OLED_DrawField(&fld_hr_spo2, line);
+    changed |= OLED_DrawField(&fld_hr_unit, low_q ? "SpO2?" : "SpO2");
+
+    OLED_TempLine(line, Ta, To);
+    changed |= OLED_DrawField(&fld_hr_temp, line);
+
+    return changed;
+}
+
+static int OLED_DrawSpO2(float bpm, float Ta, float To, float spo2, int low_q)
+{
+    char line[40];
+    int changed = 0;
+
+    OLED_BigValue(line, spo2, 100);
+    changed |= OLED_DrawField(&fld_sp_big, line);
+    changed |= OLED_DrawField(&fld_sp_label, low_q ? "SpO2?" : "SpO2%");
+
+    OLED_BigValue(line, bpm, 999);
+    changed |= OLED_DrawField(&fld_sp_bpm, line);
+    changed |= OLED_DrawField(&fld_sp_unit, low_q ? "BPM?" : "BPM");
+
+    OLED_TempLine(line, Ta, To);
+    changed |= OLED_DrawField(&fld_sp_temp, line);
+
+    return changed;
+}
+
+void OLED_ShowVitals(float bpm, float Ta, float To, float spo2, int low_q)
+{
+#if OLED_SCREEN_DECIM > 0
+    oled_screen_counter++;
+    if (oled_screen_counter >= OLED_SCREEN_DECIM) {
+        oled_screen_counter = 0;
+        OLED_SetScreen((oled_screen + 1) % SCREEN_COUNT);
+    }
+#endif
+
+    int changed;
+    switch (oled_screen) {
+    case SCREEN_HR:   changed = OLED_DrawHR(bpm, Ta, To, spo2, low_q);      break;
+    case SCREEN_SPO2: changed = OLED_DrawSpO2(bpm, Ta, To, spo2, low_q);    break;
+    default:          changed = OLED_DrawSummary(bpm, Ta, To, spo2, low_q); break;
+    }
+
+    // Sin cambios no hay frame que mandar
+    if (!changed && !oled_screen_fresh) return;
+    oled_screen_fresh = 0;
+
+    OLED_Present();
+
+#if OLED_PBM_DUMP
+    OLED_DumpPBM(oled_buffer);
+#endif
+}
+
+// ===================== OLED: ENERGIA ===================== //
+//
+// Se llama una vez por actualizacion del OLED. Sin dedo el panel se atenua
+// y luego se apaga (0xAE), y mientras esta apagado no se dibuja ni se manda
+// nada por el bus. Con alarma el panel queda a contraste normal y se
+// invierte por hardware cada actualizacion (0xA7/0xA6), sin redibujar.
+
+#define OLED_PWR_ACTIVE     0
+#define OLED_PWR_DIM        1
+#define OLED_PWR_OFF        2
+
+static int oled_pwr_state    = OLED_PWR_ACTIVE;
+static int oled_idle_ticks   = 0;
+static int oled_inverted     = 0;
+
+static void OLED_SetPowerState(int state)
+{
+    if (state == oled_pwr_state) return;
+
+    if (state == OLED_PWR_OFF) {
+        OLED_SendCommand(0xAE);
+    } else {
+        u8 cmds[3] = {
+            0x81, (state == OLED_PWR_DIM) ? OLED_CONTRAST_DIM : OLED_CONTRAST,
+            0xAF
+        };
+        // 0xAF solo hace falta al volver de apagado
+        OLED_SendCommandList(cmds, (oled_pwr_state == OLED_PWR_OFF) ? 3 : 2);
+    }
+    oled_pwr_state = state;
+}
+
+void OLED_PowerUpdate(int finger, int alarm)
+{
+    if (finger || alarm) {
+        oled_idle_ticks = 0;
+    } else if (oled_idle_ticks < OLED_OFF_TICKS) {
+        oled_idle_ticks++;
+    }
+
+    if (oled_idle_ticks >= OLED_OFF_TICKS) {
+        OLED_SetPowerState(OLED_PWR_OFF);
+    } else if (oled_idle_ticks >= OLED_DIM_TICKS) {
+        OLED_SetPowerState(OLED_PWR_DIM);
+    } else {
+        OLED_SetPowerState(OLED_PWR_ACTIVE);
+    }
+
+    // Parpadeo de alarma: alterna invertido/normal; al terminar, normal
+    int invert = alarm ? !oled_inverted : 0;
+    if (invert != oled_inverted) {
+        OLED_SendCommand(invert ? 0xA7 : 0xA6);
+        oled_inverted = invert;
+    }
+}
+
+int OLED_IsOn(void)
+{
+    return oled_pwr_state != OLED_PWR_OFF;
+}
+
+// ===================== OLED: ONDA PPG ===================== //
+//
+// Barrido tipo monitor: wave_x recorre las columnas en anillo y en cada
+// muestra solo se envia la columna nueva (mas la siguiente en blanco como
+// cursor) con una ventana de 1-2 columnas, unos pocos bytes por muestra en
+// vez de los 512 del frame. La columna tambien se escribe en back y front
+// para que un frame completo en vuelo no la pise con datos viejos.
+
+static int wave_x      = 0;
+static int wave_prev_y = WAVE_HEIGHT / 2;
+
+void WAVE_Reset(void)
+{
+    wave_x      = 0;
+    wave_prev_y = WAVE_HEIGHT / 2;
+
+    OLED_ClearRect(0, WAVE_PAGE0 * 8, OLED_WIDTH - 1, OLED_HEIGHT - 1);
+    memset(&oled_front[WAVE_PAGE0 * OLED_WIDTH], 0x00, WAVE_PAGES * OLED_WIDTH);
+}
+
+// ac: muestra AC del detector de pulso; ac_amp: su estimado de amplitud
+// (ac_peak_est, EMA de |AC|). La escala sale de ahi, sin buscar max/min.
+void WAVE_AddSample(float ac, float ac_amp)
+{
+    // La onda solo vive en la pantalla resumen, y con el panel encendido
+    if (oled_screen != SCREEN_SUMMARY || !OLED_IsOn()) return;
+
+    // Escala: +-2*ac_amp ocupa toda la altura de la zona
+    if (ac_amp < 1.0f) ac_amp = 1.0f;
+    float scale = (float)(WAVE_HEIGHT / 2 - 1) / (2.0f * ac_amp);
+
+    int y = WAVE_HEIGHT / 2 - (int)(ac * scale);
+    if (y < 0) y = 0;
+    if (y > WAVE_HEIGHT - 1) y = WAVE_HEIGHT - 1;
+
+    // Tramo vertical desde la muestra anterior para que la traza sea continua
+    int y0 = (y < wave_prev_y) ? y : wave_prev_y;
+    int y1 = (y < wave_prev_y) ? wave_prev_y : y;
+    wave_prev_y = y;
+
+    int x  = wave_x;
+    int nx = (x + 1 < OLED_WIDTH) ? 2 : 1; // columna nueva + cursor en blanco
+
+    // Datos en orden de la ventana: pagina por pagina, columna por columna
+    u8 data[WAVE_PAGES * 2];
+
+    for (int p = 0; p < WAVE_PAGES; p++) {
+        int top = p * 8;
+        u8 col = 0;
+        if (y1 >= top && y0 < top + 8) {
+            int a = (y0 > top) ? (y0 - top) : 0;
+            int b = (y1 < top + 7) ? (y1 - top) : 7;
+            col = (u8)((0xFF << a) & (0xFF >> (7 - b)));
+        }
+
+        int idx = (WAVE_PAGE0 + p) * OLED_WIDTH + x;
+        oled_buffer[idx] = oled_front[idx] = col;
+        data[p * nx] = col;
+
+        if (nx == 2) {
+            oled_buffer[idx + 1] = oled_front[idx + 1] = 0x00;
+            data[p * nx + 1] = 0x00;
+        }
+    }
+
+    OLED_WriteRegion(x, x + nx - 1, WAVE_PAGE0, OLED_PAGES - 1, data, WAVE_PAGES * nx);
+
+    wave_x = (x + 1 < OLED_WIDTH) ? x + 1 : 0;
+}
+
+// ===================== FILTRO PASABANDA ===================== //
+//
+// Cascada de 2 biquads (Direct Form I): pasa-altos Butterworth 0.5 Hz y
+// pasa-bajos Butterworth 4 Hz. Coeficientes calculados offline (formulas
+// RBJ, Q = 1/sqrt(2), normalizados a a0 = 1) para cada frecuencia de
+// muestreo soportada; en punto fijo son los mismos en Q30.
+//
+// Se filtran BQ_LANES canales a la vez: lane 0 = RED, lane 1 = IR. Con
+// NEON las 2 lanes van en un registro d (el NEON del A9 procesa 64 bits
+// por ciclo: un registro q con dos lanes de relleno costaba el doble sin
+// hacer nada util). BQ_ProcessRefF y BQ_ProcessQ son las referencias
+// escalares; las versiones NEON hacen las mismas operaciones en el mismo
+// orden (VMLA no es fusionada en el A9; en punto fijo VMULL/VMLAL acumulan
+// en 64 bits exactos y VRSHRN redondea igual), asi que dan lo mismo bit a
+// bit.
+
+typedef struct {
+    float b0, b1, b2, a1, a2;
+} BQ_CoefF;
+
+typedef struct {
+    s32 b0, b1, b2, a1, a2;     // Q30
+} BQ_CoefQ;
+
+#if SAMPLE_RATE_HZ == 25
+static const BQ_CoefF BQ_COEF_F[BQ_SECTIONS] = {
+    { 0.914969144f, -1.829938288f, 0.914969144f, -1.822694925f, 0.837181651f },
+    { 0.145323884f,  0.290647768f, 0.145323884f, -0.671029091f, 0.252324626f }
+};
+#if HR_FIXED_POINT
+static const BQ_CoefQ BQ_COEF_Q[BQ_SECTIONS] = {
+    { 982440638, -1964881275, 982440638, -1957103774, 898916953 },
+    { 156040332,   312080664, 156040332,  -720512000, 270931504 }
+};
+#endif
+#elif SAMPLE_RATE_HZ == 50
+static const BQ_CoefF BQ_COEF_F[BQ_SECTIONS] = {
+    { 0.956543226f, -1.913086451f, 0.956543226f, -1.911197067f, 0.914975835f },
+    { 0.046131802f,  0.092263604f, 0.046131802f, -1.307285029f, 0.491812237f }
+};
+#if HR_FIXED_POINT
+static const BQ_CoefQ BQ_COEF_Q[BQ_SECTIONS] = {
+    { 1027080468, -2054160935, 1027080468, -2052132225, 982447822 },
+    {   49533645,    99067291,   49533645, -1403686611, 528079369 }
+};
+#endif
+#elif SAMPLE_RATE_HZ == 100
+static const BQ_CoefF BQ_COEF_F[BQ_SECTIONS] = {
+    { 0.978030479f, -1.956060958f, 0.978030479f, -1.955578240f, 0.956543677f },
+    { 0.013359200f,  0.026718400f, 0.013359200f, -1.647459981f, 0.700896781f }
+};
+#if HR_FIXED_POINT
+static const BQ_CoefQ BQ_COEF_Q[BQ_SECTIONS] = {
+    { 1050152231, -2100304461, 1050152231, -2099786147, 1027080952 },
+    {   14344332,    28688664,   14344332, -1768946685,  752582188 }
+};
+#endif
+#else
+#error "No hay coeficientes de pasabanda para este SAMPLE_RATE_HZ"
+#endif
+
+#if !HR_FIXED_POINT
+// Referencia escalar: y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2
+static __attribute__((unused))
+void BQ_ProcessRefF(BQ_SectionF *sec, const float (*in)[BQ_LANES],
+                    float (*out)[BQ_LANES], int n)
+{
+    for (int i = 0; i < n; i++) {
+        for (int l = 0; l < BQ_LANES; l++) {
+            float x = in[i][l];
+            for (int k = 0; k < BQ_SECTIONS; k++) {
+                const BQ_CoefF *c = &BQ_COEF_F[k];
+                BQ_SectionF *s = &sec[k];
+
+                float y = c->b0 * x;
+                y += c->b1 * s->x1[l];
+                y += c->b2 * s->x2[l];
+                y -= c->a1 * s->y1[l];
+                y -= c->a2 * s->y2[l];
+
+                s->x2[l] = s->x1[l];  s->x1[l] = x;
+                s->y2[l] = s->y1[l];  s->y1[l] = y;
+                x = y;
+            }
+            out[i][l] = x;
+        }
+    }
+}
+
+#if defined(__ARM_NEON)
+// Las 2 lanes en paralelo, mismo orden de operaciones que la referencia.
+// El estado de las secciones se carga una vez y queda en registros d
+// durante todo el bloque.
+static void BQ_ProcessNeonF(BQ_SectionF *sec, const float (*in)[BQ_LANES],
+                            float (*out)[BQ_LANES], int n)
+{
+    float32x2_t x1[BQ_SECTIONS], x2[BQ_SECTIONS];
+    float32x2_t y1[BQ_SECTIONS], y2[BQ_SECTIONS];
+
+    for (int k = 0; k < BQ_SECTIONS; k++) {
+        x1[k] = vld1_f32(sec[k].x1);
+        x2[k] = vld1_f32(sec[k].x2);
+        y1[k] = vld1_f32(sec[k].y1);
+        y2[k] = vld1_f32(sec[k].y2);
     }
 
-    const float spo2_smooth_inv = 8.0f;
+    for (int i = 0; i < n; i++) {
+        float32x2_t x = vld1_f32(in[i]);
 
-    if (*spo2_out <= 0.0f) {
-        *spo2_out = spo2_inst;
-    } else {    
-        *spo2_out += (spo2_inst - *spo2_out) / spo2_smooth_inv;
+        for (int k = 0; k < BQ_SECTIONS; k++) {
+            const BQ_CoefF *c = &BQ_COEF_F[k];
+
+            float32x2_t y = vmul_n_f32(x, c->b0);
+            y = vmla_n_f32(y, x1[k], c->b1);
+            y = vmla_n_f32(y, x2[k], c->b2);
+            y = vmls_n_f32(y, y1[k], c->a1);
+            y = vmls_n_f32(y, y2[k], c->a2);
+
+            x2[k] = x1[k];  x1[k] = x;
+            y2[k] = y1[k];  y1[k] = y;
+            x = y;
+        }
+        vst1_f32(out[i], x);
+    }
+
+    for (int k = 0; k < BQ_SECTIONS; k++) {
+        vst1_f32(sec[k].x1, x1[k]);
+        vst1_f32(sec[k].x2, x2[k]);
+        vst1_f32(sec[k].y1, y1[k]);
+        vst1_f32(sec[k].y2, y2[k]);
+    }
+}
+#endif
+#endif // !HR_FIXED_POINT
+
+#if HR_FIXED_POINT
+// Punto fijo: coeficientes Q30, señal Q8, acumulador de 64 bits
+static __attribute__((unused))
+void BQ_ProcessQ(BQ_SectionQ *sec, const s32 (*in)[BQ_LANES],
+                 s32 (*out)[BQ_LANES], int n)
+{
+    for (int l = 0; l < BQ_LANES; l++) {
+        for (int k = 0; k < BQ_SECTIONS; k++) {
+            const BQ_CoefQ *c = &BQ_COEF_Q[k];
+            BQ_SectionQ *s = &sec[k];
+            s32 x1 = s->x1[l], x2 = s->x2[l];
+            s32 y1 = s->y1[l], y2 = s->y2[l];
+
+            // Seccion k sobre todo el bloque; la entrada de la seccion 0 es
+            // in, las siguientes filtran la salida de la anterior en sitio
+            for (int i = 0; i < n; i++) {
+                s32 x = (k == 0) ? in[i][l] : out[i][l];
+                s64 acc = (s64)c->b0 * x
+                        + (s64)c->b1 * x1
+                        + (s64)c->b2 * x2
+                        - (s64)c->a1 * y1
+                        - (s64)c->a2 * y2;
+                s32 y = (s32)((acc + (1 << 29)) >> 30);
+
+                x2 = x1;  x1 = x;
+                y2 = y1;  y1 = y;
+                out[i][l] = y;
+            }
+
+            s->x1[l] = x1;  s->x2[l] = x2;
+            s->y1[l] = y1;  s->y2[l] = y2;
+        }
+    }
+}
+
+#if defined(__ARM_NEON)
+// Las 2 lanes por muestra: productos 32x32 -> 64 con VMULL/VMLAL/VMLSL y
+// (acc + 2^29) >> 30 con VRSHRN
+static void BQ_ProcessNeonQ(BQ_SectionQ *sec, const s32 (*in)[BQ_LANES],
+                            s32 (*out)[BQ_LANES], int n)
+{
+    int32x2_t x1[BQ_SECTIONS], x2[BQ_SECTIONS];
+    int32x2_t y1[BQ_SECTIONS], y2[BQ_SECTIONS];
+
+    for (int k = 0; k < BQ_SECTIONS; k++) {
+        x1[k] = vld1_s32(sec[k].x1);
+        x2[k] = vld1_s32(sec[k].x2);
+        y1[k] = vld1_s32(sec[k].y1);
+        y2[k] = vld1_s32(sec[k].y2);
+    }
+
+    for (int i = 0; i < n; i++) {
+        int32x2_t x = vld1_s32(in[i]);
+
+        for (int k = 0; k < BQ_SECTIONS; k++) {
+            const BQ_CoefQ *c = &BQ_COEF_Q[k];
+
+            int64x2_t acc = vmull_n_s32(x, c->b0);
+            acc = vmlal_n_s32(acc, x1[k], c->b1);
+            acc = vmlal_n_s32(acc, x2[k], c->b2);
+            acc = vmlsl_n_s32(acc, y1[k], c->a1);
+            acc = vmlsl_n_s32(acc, y2[k], c->a2);
+            int32x2_t y = vrshrn_n_s64(acc, 30);
+
+            x2[k] = x1[k];  x1[k] = x;
+            y2[k] = y1[k];  y1[k] = y;
+            x = y;
+        }
+        vst1_s32(out[i], x);
+    }
+
+    for (int k = 0; k < BQ_SECTIONS; k++) {
+        vst1_s32(sec[k].x1, x1[k]);
+        vst1_s32(sec[k].x2, x2[k]);
+        vst1_s32(sec[k].y1, y1[k]);
+        vst1_s32(sec[k].y2, y2[k]);
+    }
+}
+#endif
+#endif
+
+// Arranca el filtro en regimen permanente para una entrada constante u
+// (evita el transitorio de varios segundos al poner el dedo)
+static void BQ_PrimeLane(PPG_Channel *ch, int lane, float u)
+{
+    for (int k = 0; k < BQ_SECTIONS; k++) {
+        const BQ_CoefF *c = &BQ_COEF_F[k];
+        float y = u * (c->b0 + c->b1 + c->b2) / (1.0f + c->a1 + c->a2);
+#if HR_FIXED_POINT
+        ch->bq[k].x1[lane] = ch->bq[k].x2[lane] = (s32)(u * 256.0f);
+        ch->bq[k].y1[lane] = ch->bq[k].y2[lane] = (s32)(y * 256.0f);
+#else
+        ch->bq[k].x1[lane] = ch->bq[k].x2[lane] = u;
+        ch->bq[k].y1[lane] = ch->bq[k].y2[lane] = y;
+#endif
+        u = y;
+    }
+}
+
+// Filtra un tramo [i0, i1) con dedo; el filtro ya esta arrancado
+static void PPG_FilterRun(PPG_Channel *ch, const u32 *red, const u32 *ir, int i0, int i1)
+{
+#if HR_FIXED_POINT
+    s32 in[PPG_BLOCK_MAX][BQ_LANES];
+    for (int i = i0; i < i1; i++) {
+        in[i][BQ_LANE_RED] = (s32)(red[i] << 8);
+        in[i][BQ_LANE_IR]  = (s32)(ir[i]  << 8);
+    }
+#if defined(__ARM_NEON)
+    BQ_ProcessNeonQ(ch->bq, &in[i0], &ch->bp_out[i0], i1 - i0);
+#else
+    BQ_ProcessQ(ch->bq, &in[i0], &ch->bp_out[i0], i1 - i0);
+#endif
+#else
+    float in[PPG_BLOCK_MAX][BQ_LANES];
+    for (int i = i0; i < i1; i++) {
+        in[i][BQ_LANE_RED] = (float)red[i];
+        in[i][BQ_LANE_IR]  = (float)ir[i];
+    }
+#if defined(__ARM_NEON)
+    BQ_ProcessNeonF(ch->bq, &in[i0], &ch->bp_out[i0], i1 - i0);
+#else
+    BQ_ProcessRefF(ch->bq, &in[i0], &ch->bp_out[i0], i1 - i0);
+#endif
+#endif
+}
+
+void PPG_FrontEndBlock(PPG_Channel *ch, const u32 *red, const u32 *ir, int n)
+{
+    if (n > PPG_BLOCK_MAX) n = PPG_BLOCK_MAX;
+
+    int i = 0;
+    while (i < n) {
+        // Sin dedo no se filtra; al volver el dedo se re-arranca el filtro
+        if (ir[i] < (u32)DC_FINGER_MIN) {
+            ch->bq_primed = 0;
+#if HR_FIXED_POINT
+            ch->bp_out[i][BQ_LANE_RED] = ch->bp_out[i][BQ_LANE_IR] = 0;
+#else
+            ch->bp_out[i][BQ_LANE_RED] = ch->bp_out[i][BQ_LANE_IR] = 0.0f;
+#endif
+            i++;
+            continue;
+        }
+        if (!ch->bq_primed) {
+            BQ_PrimeLane(ch, BQ_LANE_RED, (float)red[i]);
+            BQ_PrimeLane(ch, BQ_LANE_IR,  (float)ir[i]);
+            ch->bq_primed = 1;
+        }
+
+        int j = i + 1;
+        while (j < n && ir[j] >= (u32)DC_FINGER_MIN) j++;
+        PPG_FilterRun(ch, red, ir, i, j);
+        i = j;
+    }
+}
+
+void PPG_FrontEnd(PPG_Channel *ch, u32 red, u32 ir)
+{
+    PPG_FrontEndBlock(ch, &red, &ir, 1);
+}
+
+// ===================== HR: ESTIMADOR ROBUSTO ===================== //
+//
+// Ventana de latidos con suma corrida y copia ordenada. Cada latido cuesta
+// una busqueda binaria y un memmove de a lo sumo HR_RATE_WIN_BEATS-1
+// entradas (un solo bloque, sin recorrer la ventana); la mediana es
+// sorted[n/2] y la media recortada con HR_RATE_TRIM = 1 es la suma menos
+// los dos extremos. Un latido falso (intervalo partido) o perdido
+// (intervalo doble) cae lejos de la mediana y no entra.
+
+static void HR_RateReset(HR_Rate *r)
+{
+    memset(r, 0, sizeof(*r));
+}
+
+// Primera posicion de a[0..n) con valor >= v
+static int HR_RateFind(const u16 *a, int n, u16 v)
+{
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (a[mid] < v) lo = mid + 1;
+        else            hi = mid;
+    }
+    return lo;
+}
+
+static void HR_RateEvictOldest(HR_Rate *r)
+{
+    int tail = r->head - r->count;
+    if (tail < 0) tail += HR_RATE_WIN_BEATS;
+
+    u16 v = r->ring[tail];
+    int k = HR_RateFind(r->sorted, r->count, v);
+    memmove(&r->sorted[k], &r->sorted[k + 1], (r->count - 1 - k) * sizeof(u16));
+    r->sum -= v;
+    r->count--;
+}
+
+// Devuelve 1 si el latido entra a la ventana, 0 si se rechaza
+static int HR_RateUpdate(HR_Rate *r, u16 bpm_q8, u32 now)
+{
+#if HR_RATE_WIN_S > 0
+    // Ventana en segundos: fuera los que ya son viejos
+    while (r->count > 0) {
+        int tail = r->head - r->count;
+        if (tail < 0) tail += HR_RATE_WIN_BEATS;
+        if (now - r->ring_t[tail] <= (u32)(HR_RATE_WIN_S * SAMPLE_RATE_HZ)) break;
+        HR_RateEvictOldest(r);
+    }
+#endif
+
+    if (r->count >= 3) {
+        u32 med = r->sorted[r->count >> 1];
+        u32 dev = (bpm_q8 > med) ? bpm_q8 - med : med - bpm_q8;
+
+        if (dev * 100 > med * HR_RATE_OUTLIER_PCT) {
+            if (++r->rejects < HR_RATE_RELOCK) {
+                return 0;
+            }
+            HR_RateReset(r);
+        }
+    }
+    r->rejects = 0;
+
+    if (r->count == HR_RATE_WIN_BEATS) {
+        HR_RateEvictOldest(r);
     }
+
+    int k = HR_RateFind(r->sorted, r->count, bpm_q8);
+    memmove(&r->sorted[k + 1], &r->sorted[k], (r->count - k) * sizeof(u16));
+    r->sorted[k] = bpm_q8;
+
+    r->ring[r->head]   = bpm_q8;
+    r->ring_t[r->head] = now;
+    r->head = (r->head + 1 < HR_RATE_WIN_BEATS) ? r->head + 1 : 0;
+    r->sum += bpm_q8;
+    r->count++;
+    return 1;
+}
+
+// Media recortada de la ventana en Q8 (0 si esta vacia)
+static u32 HR_RateEstimate(const HR_Rate *r)
+{
+    int n = r->count;
+    if (n == 0) return 0;
+
+    int trim = HR_RATE_TRIM;
+    if (n - 2 * trim < 1) trim = (n - 1) / 2;
+
+    u32 sum = r->sum;
+    for (int k = 0; k < trim; k++) {
+        sum -= r->sorted[k] + r->sorted[n - 1 - k];
+    }
+
+    int m = n - 2 * trim;
+    return (sum + m / 2) / m;
+}
+
+// ===================== HR: AUTOCORRELACION ===================== //
+//
+// Estimador por periodicidad, independiente del detector de picos: sigue
+// funcionando con baja perfusion o ruido, donde los picos fallan. Guarda
+// HR_ACF_WIN muestras del AC (su pendiente, normalizada por su propio
+// nivel medio) y mantiene r[k] exacta de forma incremental: por muestra entra
+// x[n]*x[n-k] y sale el producto que deja la ventana, 2*HR_ACF_NLAGS
+// MACs fijos (~150 a 50 Hz). Cada hop solo busca el maximo de r en la
+// banda 40-180 BPM. Con |x| <= 1023 y a lo sumo 800 muestras por ventana
+// las sumas caben en 32 bits.
+
+#define HR_ACF_XMAX         1023
+#define HR_ACF_SCALE        256         // |pendiente| media -> 256
+
+// Raiz cuadrada entera (por hop o por ventana, no por muestra)
+static u32 ISqrt64(u64 v)
+{
+    u64 r = 0;
+    u64 bit = (u64)1 << 62;
+
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r  = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (u32)r;
+}
+
+static void HR_AcfReset(HR_Acf *a)
+{
+    memset(a, 0, sizeof(*a));
+}
+
+// Maximo local de r en k (k-1 y k+1 existen)
+static inline int HR_AcfIsPeak(const s32 *r, int k)
+{
+    return r[k] > r[k - 1] && r[k] >= r[k + 1];
+}
+
+static void HR_AcfEstimate(HR_Acf *a)
+{
+    const s32 *r = a->r;
+    int best = 0;
+
+    a->bpm_q8  = 0;
+    a->conf_q8 = 0;
+    a->lag     = 0;
+    if (r[0] <= 0) return;
+
+    for (int k = HR_ACF_LAG_MIN; k <= HR_ACF_LAG_MAX; k++) {
+        if (HR_AcfIsPeak(r, k) && (best == 0 || r[k] > r[best])) {
+            best = k;
+        }
+    }
+    if (best == 0 || r[best] <= 0) return;
+
+    // El maximo puede ser el doble o el triple del periodo: si cerca de
+    // best/3 o best/2 hay un pico casi igual de alto, ese es el periodo
+    // (se prueba primero el lag mas corto)
+    for (int div = 3, found = 0; div >= 2 && !found; div--) {
+        int c = best / div;
+        for (int k = c - 1; k <= c + 1; k++) {
+            if (k >= HR_ACF_LAG_MIN && HR_AcfIsPeak(r, k) &&
+                (s64)r[k] * 100 >= (s64)r[best] * 85)
+            {
+                best  = k;
+                found = 1;
+                break;
+            }
+        }
+    }
+
+    // Lag fraccional por la parabola r[best-1], r[best], r[best+1]
+    s64 den  = (s64)r[best - 1] - 2 * (s64)r[best] + r[best + 1];
+    s32 frac = (den < 0) ? (s32)((((s64)r[best - 1] - r[best + 1]) << 7) / den) : 0;
+    if (frac >  128) frac =  128;
+    if (frac < -128) frac = -128;
+
+    u32 lag_q8 = ((u32)best << 8) + frac;
+    u32 bpm_q8 = ((u32)(60 * SAMPLE_RATE_HZ) << 16) / lag_q8;
+    if (bpm_q8 < (40u << 8) || bpm_q8 > (180u << 8)) return;
+
+    a->bpm_q8  = (u16)bpm_q8;
+    a->conf_q8 = (u16)(((s64)r[best] << 8) / r[0]);
+    a->lag     = (u16)best;
+}
+
+// Mejor correlacion normalizada de los lags de la plantilla sobre las
+// sumas acumuladas (una raiz por lag) y las deja en cero. Sin lags todavia
+// no hay evidencia en contra y vale 1. Se cierra cada medio hop: con RSA
+// el RR cambia de un latido al siguiente y una ventana que cruza dos
+// latidos no encaja con un solo lag; media ventana casi siempre cae en uno
+static s16 HR_AcfTmplClose(HR_Acf *a)
+{
+    s32 best = (a->tmpl_n > 0) ? -256 : 256;
+    for (int j = 0; j < a->tmpl_n; j++) {
+        if (a->cxx > 0 && a->cyy[j] > 0) {
+            u32 norm = ISqrt64((u64)a->cxx * (u64)a->cyy[j]);
+            s32 c = (norm > 0) ? (s32)(((s64)a->cxy[j] << 8) / norm) : 0;
+            if (c > best) best = c;
+        }
+        a->cxy[j] = 0;
+        a->cyy[j] = 0;
+    }
+    a->cxx = 0;
+    return (s16)best;
+}
+
+// Una muestra de AC en Q8. Devuelve 1 si
+// cerro un hop (hay estimacion nueva en bpm_q8/conf_q8).
+static int HR_AcfPush(HR_Acf *a, s32 ac_q8)
+{
+    // Pendiente en vez de nivel: la respiracion y la deriva que deja pasar
+    // el pasabanda aplastan r[k] en la banda de HR; la derivada las atenua
+    // y deja los picos de r en el mismo periodo
+    s32 d = ac_q8 - a->prev_q8;
+    a->prev_q8 = ac_q8;
+    s32 d_abs = (d > 0) ? d : -d;
+    a->level_q8 += (d_abs - a->level_q8) >> 4;
+
+    if (a->gain_q16 == 0 && a->level_q8 > 0) {
+        a->gain_q16 = (s32)(((s64)HR_ACF_SCALE << 16) / a->level_q8);
+    }
+
+    s32 x = (s32)(((s64)d * a->gain_q16) >> 16);
+    if (x >  HR_ACF_XMAX) x =  HR_ACF_XMAX;
+    if (x < -HR_ACF_XMAX) x = -HR_ACF_XMAX;
+
+    const int m = HR_ACF_RING - 1;
+    int h = a->head;
+    a->x[h] = (s16)x;
+
+    // Correlacion corta contra el latido anterior, lags cerca del ritmo del
+    // ultimo hop
+    a->cxx += x * x;
+    for (int j = 0; j < a->tmpl_n; j++) {
+        s32 y = a->x[(h - a->tmpl_lo - j) & m];
+        a->cxy[j] += x * y;
+        a->cyy[j] += y * y;
+    }
+
+    // Entra x[n]*x[n-k] y sale x[n-W]*x[n-W-k]. Al arrancar la historia
+    // es cero (reset), asi que la misma cuenta vale desde la primera muestra
+    int o = (h - HR_ACF_WIN) & m;
+    s32 xo = a->x[o];
+    for (int k = 0; k < HR_ACF_NLAGS; k++) {
+        a->r[k] += x * a->x[(h - k) & m] - xo * a->x[(o - k) & m];
+    }
+    if (a->fill < HR_ACF_WIN) a->fill++;
+    a->head = (u16)((h + 1) & m);
+
+    if (++a->hop < HR_ACF_HOP) {
+        if (a->hop == HR_ACF_HOP / 2) a->tmpl_half_q8 = HR_AcfTmplClose(a);
+        return 0;
+    }
+    a->hop = 0;
+
+    // Cierre del hop: media de las dos mitades
+    a->tmpl_q8 = (s16)((a->tmpl_half_q8 + HR_AcfTmplClose(a)) / 2);
+
+    // Ganancia nueva para el proximo hop (una division por hop)
+    if (a->level_q8 > 0) {
+        a->gain_q16 = (s32)(((s64)HR_ACF_SCALE << 16) / a->level_q8);
+    }
+    if (a->fill < HR_ACF_WIN) return 0;
+
+    HR_AcfEstimate(a);
+
+    // Lags de la correlacion con el latido anterior para el proximo hop
+    int dl = a->lag / 5;
+    a->tmpl_lo = (u16)(a->lag - dl);
+    a->tmpl_n  = (a->lag != 0) ? (u16)(2 * dl + 1) : 0;
+    return 1;
+}
+
+// ===================== HRV ===================== //
+//
+// Anillo de intervalos NN alimentado por el detector: entra cada latido
+// aceptado por el estimador de BPM que pasa la edicion NN; uno rechazado
+// (o la perdida del dedo) corta la cadena y el siguiente no aporta
+// diferencia. Cada ventana
+// (HRV_WIN_SHORT_S, HRV_WIN_LONG_S) lleva sus sumas corridas y su propio
+// extremo viejo sobre el mismo anillo, asi que entrar o salir un latido
+// es O(1):
+//   SDNN  = sqrt((n*sum rr^2 - (sum rr)^2) / (n*(n-1)))
+//   RMSSD = sqrt(sum d^2 / m)
+//   pNN50 = nn50 / m
+// Las raices se sacan solo al consultar (HRV_Get).
+
+static void HRV_Reset(HRV_State *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->win[HRV_SHORT].span_ms = HRV_WIN_SHORT_S * 1000u;
+    h->win[HRV_LONG].span_ms  = HRV_WIN_LONG_S  * 1000u;
+}
+
+static inline void HRV_DiffAdd(HRV_Win *w, s32 d, int sign)
+{
+    u32 ad = (u32)((d < 0) ? -d : d);
+    w->ssd  += sign * (s64)(ad * ad);
+    w->m    += sign;
+    w->nn50 += sign * (ad > HRV_NN50_MS);
+}
+
+// Saca el latido mas viejo de la ventana; la diferencia del siguiente
+// deja de contar porque su par ya no esta
+static void HRV_WinEvict(HRV_State *h, HRV_Win *w)
+{
+    const int m = HRV_RING - 1;
+    u32 rr = h->rr[w->tail];
+
+    w->sum  -= rr;
+    w->sum2 -= (u64)rr * rr;
+    w->n--;
+    w->tail = (u16)((w->tail + 1) & m);
+
+    if (w->n > 0 && h->d[w->tail] != HRV_DIFF_NONE) {
+        HRV_DiffAdd(w, h->d[w->tail], -1);
+    }
+}
+
+// Saca de cada ventana los latidos de hace mas de span_ms
+static void HRV_Expire(HRV_State *h, u32 now_ms)
+{
+    for (int k = 0; k < 2; k++) {
+        HRV_Win *w = &h->win[k];
+        while (w->n > 0 && now_ms - h->t[w->tail] > w->span_ms) {
+            HRV_WinEvict(h, w);
+        }
+    }
+}
+
+// Un latido detectado: rr en ms, now_ms reloj del canal, accepted como en
+// HR_Beat
+static void HRV_Push(HRV_State *h, u32 rr_ms, u32 now_ms, int accepted)
+{
+    const int m = HRV_RING - 1;
+
+    if (accepted && rr_ms <= 0xFFFF && h->last_rr != 0 && h->edits < HRV_RELOCK) {
+        u32 dev = (rr_ms > h->last_rr) ? rr_ms - h->last_rr : h->last_rr - rr_ms;
+        if (dev * 100 > (u32)h->last_rr * HRV_EDIT_PCT) {
+            h->edits++;
+            accepted = 0;
+        }
+    }
+
+    if (!accepted || rr_ms > 0xFFFF) {
+        h->chain = 0;
+        HRV_Expire(h, now_ms);
+        return;
+    }
+    h->edits = 0;
+
+    // Anillo lleno (no pasa con rr >= 1/3 s, ver HRV_RING): el mas viejo
+    // sale de la ventana larga y de la corta si seguia ahi
+    if (h->win[HRV_LONG].n == HRV_RING) {
+        if (h->win[HRV_SHORT].n == HRV_RING) HRV_WinEvict(h, &h->win[HRV_SHORT]);
+        HRV_WinEvict(h, &h->win[HRV_LONG]);
+    }
+
+    s32 d = h->chain ? (s32)rr_ms - h->last_rr : 0;
+    if (d > 32767 || d < -32767) h->chain = 0;
+
+    int i = h->head;
+    h->rr[i] = (u16)rr_ms;
+    h->d[i]  = h->chain ? (s16)d : HRV_DIFF_NONE;
+    h->t[i]  = now_ms;
+    h->head  = (u16)((i + 1) & m);
+    h->last_rr = (u16)rr_ms;
+
+    for (int k = 0; k < 2; k++) {
+        HRV_Win *w = &h->win[k];
+
+        if (w->n == 0) w->tail = (u16)i;
+        if (w->n > 0 && h->d[i] != HRV_DIFF_NONE) HRV_DiffAdd(w, d, 1);
+        w->sum  += rr_ms;
+        w->sum2 += (u64)rr_ms * rr_ms;
+        w->n++;
+    }
+    HRV_Expire(h, now_ms);
+
+    h->chain = 1;
+}
+
+static inline void HRV_Break(HRV_State *h)
+{
+    h->chain = 0;
+}
+
+void HRV_Get(const PPG_Channel *ch, int win, HRV_Stats *out)
+{
+    const HRV_Win *w = &ch->hrv.win[win ? HRV_LONG : HRV_SHORT];
+
+    memset(out, 0, sizeof(*out));
+    out->n = w->n;
+
+    if (w->n >= 2) {
+        u64 n = w->n;
+        u64 num = n * w->sum2 - (u64)w->sum * w->sum;
+        out->sdnn_x10 = (u16)ISqrt64((num * 100) / (n * (n - 1)));
+    }
+    if (w->m > 0) {
+        out->rmssd_x10 = (u16)ISqrt64((w->ssd * 100) / w->m);
+        out->pnn50_x10 = (u16)(((u32)w->nn50 * 1000 + w->m / 2) / w->m);
+    }
+}
+
+// ===================== RITMO IRREGULAR ===================== //
+//
+// Tamizaje de FA sobre los intervalos del detector: entra todo latido en
+// 40..180 BPM que pasa SQI_BeatOk, aunque el estimador de BPM lo rechace
+// (los motivos SQI_F_RHYTHM los dispara una FA sola). Un pulso de menos
+// de 1/AF_AMP_DIV del tipico es un pico falso (dicrota o ruido con poca
+// perfusion): corta, y el intervalo siguiente, que arranca en el, tampoco
+// entra. Sobre los ultimos AF_WIN intervalos, con sumas que entran y
+// salen por latido:
+//   CV  = desvio / media de rr                          (una raiz)
+//   TPR = puntos de giro / latidos evaluados (rr[i] mayor o menor que
+//         sus dos vecinos; al azar 2/3, sinusal con RSA bastante menos)
+//   ShE = entropia del histograma de |dRR| (bins relativos al rr medio)
+//         / log2(AF_BINS); con S = suma c*log2(c) (tabla) es
+//         (n*log2(n) - S) / n, y cada latido mueve dos bins
+// Irregular = los tres fuera de lo sinusal. Una racha de AF_ONSET
+// latidos abre episodio y AF_OFFSET regulares lo cierran; inicio y fin se
+// fechan en el latido central de la ventana que dio el veredicto (la
+// ventana cambia de opinion cuando la mitad ya es del otro ritmo). Un
+// corte solo corta las diferencias; perder el dedo cierra el episodio.
+
+// c * log2(c) en Q8, c = 0..AF_WIN
+static const u32 af_clog2c_q8[AF_WIN + 1] = {
+    0, 0, 512, 1217, 2048, 2972, 3971, 5031,
+    6144, 7304, 8504, 9742, 11013, 12315, 13646, 15002,
+    16384, 17789, 19215, 20662, 22128, 23613, 25116, 26635,
+    28170, 29721, 31286, 32866, 34459, 36066, 37685, 39317,
+    40960, 42615, 44281, 45958, 47646, 49344, 51052, 52769,
+    54497, 56233, 57978, 59732, 61495, 63266, 65045, 66833,
+    68628, 70431, 72241, 74059, 75884, 77716, 79556, 81402,
+    83254, 85114, 86979, 88851, 90730, 92614, 94505, 96402,
+    98304,
+};
+
+static inline void AF_HistMove(AF_Win *w, int b, int delta)
+{
+    w->hlog_q8 -= af_clog2c_q8[w->hist[b]];
+    w->hist[b] = (u16)(w->hist[b] + delta);
+    w->hlog_q8 += af_clog2c_q8[w->hist[b]];
+    w->nd = (u16)(w->nd + delta);
+}
+
+static void AF_EpisodeClose(AF_State *a)
+{
+    a->cur.end_ms = a->last_irr_ms;
+    a->ep[a->ep_seq % AF_EPISODES] = a->cur;
+    a->ep_seq++;
+    a->active  = 0;
+    a->reg_run = 0;
+}
+
+// Dedo fuera: ventana nueva y episodio cerrado en su ultimo latido irregular
+static void AF_Lost(AF_State *a)
+{
+    if (a->active) AF_EpisodeClose(a);
+    memset(&a->w, 0, sizeof(a->w));
+    a->amp_ref = 0;
+    a->irregular = 0;
+    a->irr_run = 0;
+    a->reg_run = 0;
+}
+
+static void AF_Push(AF_State *a, u32 rr_ms, u32 now_ms, s32 amp, int ok)
+{
+    AF_Win *w = &a->w;
+    const int m = AF_WIN - 1;
+
+    if (ok && amp < a->amp_ref / AF_AMP_DIV) ok = 0;
+    if (!ok || rr_ms > 0xFFFF) {
+        w->chain = 0;
+        return;
+    }
+    a->amp_ref = (a->amp_ref == 0) ? amp : a->amp_ref + ((amp - a->amp_ref) >> 3);
+
+    // Tras un corte el intervalo arranca en una deteccion dudosa
+    if (w->chain == 0) {
+        w->chain = 1;
+        return;
+    }
+
+    // Ventana llena: el mas viejo sale (su hueco es el que se escribe)
+    int i = w->head;
+    if (w->n == AF_WIN) {
+        w->sum  -= w->rr[i];
+        w->sum2 -= (u32)w->rr[i] * w->rr[i];
+        if (w->bin[i] != AF_NONE) AF_HistMove(w, w->bin[i], -1);
+        if (w->tp[i]  != AF_NONE) {
+            w->ntp_eval--;
+            w->ntp -= w->tp[i];
+        }
+        w->n--;
+    }
+
+    int p = (i - 1) & m;
+    w->bin[i] = AF_NONE;
+    if (w->chain >= 2) {
+        u32 d = (rr_ms > w->rr[p]) ? rr_ms - w->rr[p] : w->rr[p] - rr_ms;
+        u32 b = (w->n > 0) ? (d * w->n * AF_BIN_DIV) / w->sum : AF_BINS - 1;
+        w->bin[i] = (u8)((b < AF_BINS) ? b : AF_BINS - 1);
+        AF_HistMove(w, w->bin[i], 1);
+    }
+
+    // Con este latido se sabe si el anterior fue punto de giro
+    w->tp[i] = AF_NONE;
+    if (w->chain >= 3) {
+        u32 r0 = w->rr[(i - 2) & m], r1 = w->rr[p];
+        u8 tp = (r1 > r0 && r1 > rr_ms) || (r1 < r0 && r1 < rr_ms);
+        w->tp[p] = tp;
+        w->ntp_eval++;
+        w->ntp += tp;
+    }
+
+    w->rr[i] = (u16)rr_ms;
+    w->t[i]  = now_ms;
+    w->sum  += rr_ms;
+    w->sum2 += rr_ms * rr_ms;
+    w->n++;
+    w->head = (u16)((i + 1) & m);
+    if (w->chain < 3) w->chain++;
+
+    if (w->n < AF_MIN_BEATS || w->nd == 0 || w->ntp_eval == 0) return;
+
+    u64 n = w->n;
+    u64 var = (n * w->sum2 - (u64)w->sum * w->sum) / (n * (n - 1));
+    a->cv_x1000  = (u16)(ISqrt64(var * 1000000u) * n / w->sum);
+    a->tpr_x1000 = (u16)(((u32)w->ntp * 1000) / w->ntp_eval);
+    u32 h_q8 = (af_clog2c_q8[w->nd] - w->hlog_q8) / w->nd;
+    a->she_x1000 = (u16)((h_q8 * 1000) / (256 * 4));    // log2(AF_BINS) = 4
+
+    a->irregular = a->cv_x1000  >= AF_CV_MIN_X1000 &&
+                   a->she_x1000 >= AF_SHE_MIN_X1000 &&
+                   a->tpr_x1000 >= AF_TPR_LO_X1000 &&
+                   a->tpr_x1000 <= AF_TPR_HI_X1000;
+
+    if (a->irregular) {
+        // El veredicto es de toda la ventana: se fecha en su mitad
+        int back = (w->n > AF_WIN / 2) ? AF_WIN / 2 : w->n - 1;
+        u32 t_mid = w->t[(i - back) & m];
+
+        if (a->irr_run++ == 0) a->cand_ms = t_mid;
+        a->reg_run = 0;
+        a->last_irr_ms = t_mid;
+        if (!a->active && a->irr_run >= AF_ONSET) {
+            a->active = 1;
+            a->cur.start_ms = a->cand_ms;
+        }
+    } else {
+        a->irr_run = 0;
+        if (a->active && ++a->reg_run >= AF_OFFSET) AF_EpisodeClose(a);
+    }
+}
+
+void AF_Get(const PPG_Channel *ch, AF_Stats *out)
+{
+    const AF_State *a = &ch->af;
+
+    memset(out, 0, sizeof(*out));
+    out->n = a->w.n;
+    if (a->w.n >= AF_MIN_BEATS) {
+        out->cv_x1000  = a->cv_x1000;
+        out->tpr_x1000 = a->tpr_x1000;
+        out->she_x1000 = a->she_x1000;
+        out->irregular = a->irregular;
+    }
+    out->active = a->active;
+    if (a->active) out->start_ms = a->cur.start_ms;
+}
+
+int AF_ReadEpisodes(const PPG_Channel *ch, u32 *seq, AF_Episode *out, int max)
+{
+    const AF_State *a = &ch->af;
+    u32 s = *seq;
+    int k = 0;
+
+    if ((s32)(a->ep_seq - s) < 0) s = a->ep_seq;               // canal reiniciado
+    if (a->ep_seq - s > AF_EPISODES) s = a->ep_seq - AF_EPISODES;
+
+    while (s != a->ep_seq && k < max) {
+        out[k++] = a->ep[s % AF_EPISODES];
+        s++;
+    }
+    *seq = s;
+    return k;
+}
+
+// ===================== RESPIRACION ===================== //
+//
+// Por cada latido aceptado entran tres valores que la respiracion modula:
+// la linea base del IR (el dc que ya estima el HR), la amplitud pico a
+// valle del AC y el intervalo RR. Cada serie se interpola linealmente a
+// una grilla de RESP_FS Hz (a lo sumo 3 puntos por latido), se le resta
+// la tendencia (EMA 1/16, ~1 resp/min) y se cuentan los cruces
+// ascendentes por cero con histeresis de 1/4 del nivel medio:
+//   resp/min = 60 * (cruces - 1) / (ultimo - primero)   en RESP_WIN_S
+// Fusion: media de las tres si coinciden (a RESP_FUSE_SPREAD resp/min);
+// si no, media del par mas cercano que coincide (la tercera es la que se
+// fue); sin ningun par que coincida, 0 (la respiracion no se ve clara).
+// Costo fijo por latido, nada por muestra. El latido muestrea la
+// respiracion: sirve hasta ~HR/3 resp/min (unas 23 a 70 BPM).
+
+static void RESP_Reset(RESP_State *st)
+{
+    memset(st, 0, sizeof(*st));
+}
+
+static void RESP_SeriesPoint(RESP_Series *r, s32 v, u32 t_ms, int first)
+{
+    const int m = RESP_XMAX;
+
+    if (first) {
+        r->trend = v;
+        r->level = 0;
+        r->state = 0;
+        return;
+    }
+
+    r->trend += (v - r->trend) >> 4;
+    s32 x = v - r->trend;
+    s32 ax = (x > 0) ? x : -x;
+    r->level += (ax - r->level) >> 3;
+
+    s32 h = r->level >> 2;
+    if (x > h && r->state != 1) {
+        if (r->state == -1) {
+            r->xt[r->xhead] = t_ms;
+            r->xhead = (u8)((r->xhead + 1) % m);
+            if (r->xn < m) r->xn++;
+        }
+        r->state = 1;
+    } else if (x < -h) {
+        r->state = -1;
+    }
+}
+
+static void RESP_SeriesEstimate(RESP_Series *r, u32 now_ms)
+{
+    const int m = RESP_XMAX;
+
+    // Fuera los cruces que dejaron la ventana
+    while (r->xn > 0 &&
+           now_ms - r->xt[(r->xhead + m - r->xn) % m] > RESP_WIN_S * 1000u)
+    {
+        r->xn--;
+    }
+
+    r->brpm_q8 = 0;
+    if (r->xn >= 3) {
+        u32 t0 = r->xt[(r->xhead + m - r->xn) % m];
+        u32 t1 = r->xt[(r->xhead + m - 1) % m];
+        if (t1 > t0) {
+            u32 q8 = (u32)(((u64)(r->xn - 1) * 60000u << 8) / (t1 - t0));
+            r->brpm_q8 = (q8 > 0xFFFF) ? 0xFFFF : (u16)q8;
+        }
+    }
+}
+
+// Un latido aceptado: t_ms reloj del canal; base y amp en Q8, rr en ms
+static void RESP_Beat(RESP_State *st, u32 t_ms, s32 base, s32 amp, s32 rr)
+{
+    const u32 step = 1000 / RESP_FS;
+    s32 v[3] = { base, amp, rr };
+
+    if (!st->primed || t_ms - st->t_prev > RESP_GAP_MS) {
+        // Primer latido o hueco: la grilla arranca de nuevo (los cruces
+        // ya contados siguen valiendo mientras esten en la ventana)
+        for (int k = 0; k < 3; k++) {
+            st->s[k].prev = v[k];
+            RESP_SeriesPoint(&st->s[k], v[k], t_ms, 1);
+        }
+        st->t_prev = t_ms;
+        st->t_grid = t_ms + step;
+        st->primed = 1;
+        return;
+    }
+
+    u32 dt = t_ms - st->t_prev;
+    while (dt > 0 && (s32)(t_ms - st->t_grid) >= 0) {
+        u32 w = st->t_grid - st->t_prev;
+        for (int k = 0; k < 3; k++) {
+            RESP_Series *r = &st->s[k];
+            s32 vg = r->prev + (s32)(((s64)(v[k] - r->prev) * w) / dt);
+            RESP_SeriesPoint(r, vg, st->t_grid, 0);
+        }
+        st->t_grid += step;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        RESP_Series *r = &st->s[k];
+        r->prev = v[k];
+        RESP_SeriesEstimate(r, t_ms);
+    }
+    st->t_prev = t_ms;
+
+    const u32 a = st->s[0].brpm_q8, b = st->s[1].brpm_q8, c = st->s[2].brpm_q8;
+    const u32 spread = RESP_FUSE_SPREAD << 8;
+    u32 lo = a, hi = a;
+    if (b < lo) lo = b;
+    if (b > hi) hi = b;
+    if (c < lo) lo = c;
+    if (c > hi) hi = c;
+
+    if (lo != 0 && hi - lo <= spread) {
+        st->brpm_q8 = (u16)((a + b + c) / 3);
+        return;
+    }
+
+    // Par mas cercano entre los que tienen estimacion
+    const u32 pa[3] = { a, a, b }, pb[3] = { b, c, c };
+    u32 best = spread + 1;
+    st->brpm_q8 = 0;
+    for (int k = 0; k < 3; k++) {
+        if (pa[k] == 0 || pb[k] == 0) continue;
+        u32 d = (pa[k] > pb[k]) ? pa[k] - pb[k] : pb[k] - pa[k];
+        if (d < best) {
+            best = d;
+            st->brpm_q8 = (u16)((pa[k] + pb[k]) / 2);
+        }
+    }
+}
+
+float RESP_Rate(const PPG_Channel *ch)
+{
+    return (float)ch->resp.brpm_q8 * (1.0f / 256.0f);
+}
+
+float RESP_SeriesRate(const PPG_Channel *ch, int series)
+{
+    if (series < 0 || series > 2) return 0.0f;
+    return (float)ch->resp.s[series].brpm_q8 * (1.0f / 256.0f);
+}
+
+// ===================== CALIDAD DE SEÑAL ===================== //
+//
+// Por muestra (costo fijo: 2 comparaciones de recorte, una normalizacion
+// y x^2, x^4, AC^2 acumulados) y por ventana de SQI_WIN muestras:
+//   curtosis = n * sum x^4 / (sum x^2)^2   (seno 1.5, pulso limpio ~2-5;
+//                                            los golpes la disparan)
+//   pi       = rms(AC) / media(IR)         contra la referencia de
+//                                            ventanas buenas
+//   periodo  = confianza de la autocorrelacion (8 s)
+//   plantilla= correlacion del ultimo segundo con el latido anterior, el
+//              mejor lag a +-20 % del ritmo en cada medio segundo
+//              (HR_Acf.tmpl_q8; el movimiento la baja de ~0.95 a < 0.8)
+// Los motivos de una ventana rigen para las muestras siguientes (la
+// ventana se evalua al cerrarse); recorte, saltos y correlacion baja
+// bloquean al instante. Corre antes del HR, asi que ve la ACF como quedo
+// al final del bloque anterior.
+
+static void SQI_WindowClose(PPG_Channel *ch)
+{
+    SQI_State *q = &ch->sqi;
+    u8 f = 0;
+
+    u32 rms_q4 = ISqrt64(q->e2 / q->n);
+    u32 pi_q24 = (q->dc_sum > 0)
+               ? (u32)((((u64)rms_q4 * q->n) << 20) / q->dc_sum) : 0;
+
+    // Curtosis (solo si x ya estaba normalizada en esta ventana)
+    q->kurt_q8 = 0;
+    if (q->gain_q16 != 0 && q->s2 > 0) {
+        u64 k = (((q->s4 << 8) / q->s2) * q->n) / q->s2;
+        q->kurt_q8 = (k > 0xFFFF) ? 0xFFFF : (u16)k;
+        if (q->kurt_q8 > (SQI_KURT_MAX << 8)) f |= SQI_F_KURT;
+    }
+
+    if (q->pi_ref_q24 != 0 &&
+        (pi_q24 > 2 * q->pi_ref_q24 || 2 * pi_q24 < q->pi_ref_q24))
+    {
+        f |= SQI_F_PERFUSION;
+    }
+
+    if (ch->acf.fill >= HR_ACF_WIN && ch->acf.conf_q8 < SQI_CONF_MIN_Q8) {
+        f |= SQI_F_PERIOD;
+    }
+
+    // Perfusion fuera de rango por si sola varias ventanas: cambio real
+    if (f == SQI_F_PERFUSION && ++q->pi_bad >= SQI_RELOCK) {
+        q->pi_ref_q24 = 0;
+        f = 0;
+    }
+    if (!(f & SQI_F_PERFUSION)) q->pi_bad = 0;
+
+    if (f == 0) {
+        if (q->pi_ref_q24 == 0) {
+            q->pi_ref_q24 = pi_q24;
+        } else {
+            q->pi_ref_q24 += ((s32)(pi_q24 - q->pi_ref_q24)) >> 2;
+        }
+    }
+
+    q->win_flags = f;
+    q->gain_q16  = (rms_q4 > 0) ? (s32)((1u << 20) / rms_q4) : 0;
+    q->s4 = 0;
+    q->s2 = 0;
+    q->e2 = 0;
+    q->dc_sum = 0;
+    q->n = 0;
+}
+
+void SQI_UpdateBlock(PPG_Channel *ch, const u32 *red, const u32 *ir, int n)
+{
+    SQI_State *q = &ch->sqi;
+    const s32 spike = SQI_SPIKE * 256;
+
+    if (n > PPG_BLOCK_MAX) n = PPG_BLOCK_MAX;
+
+    for (int i = 0; i < n; i++) {
+        if (red[i] < 8000 || ir[i] < 8000) {
+            memset(q, 0, sizeof(*q));
+            q->flags = SQI_F_NOFINGER;
+            ch->sqi_low[i] = SQI_F_NOFINGER;
+            continue;
+        }
+
+        u8 inst = 0;
+        if (red[i] >= SQI_CLIP_RAW || ir[i] >= SQI_CLIP_RAW) inst |= SQI_F_CLIP;
+        if (ch->acf.fill >= HR_ACF_WIN && ch->acf.tmpl_q8 < SQI_TMPL_MIN_Q8) {
+            inst |= SQI_F_TEMPLATE;
+        }
+
+#if HR_BANDPASS && HR_FIXED_POINT
+        s32 ac = ch->bp_out[i][BQ_LANE_IR];
+#elif HR_BANDPASS
+        s32 ac = (s32)(ch->bp_out[i][BQ_LANE_IR] * 256.0f);
+#else
+        s32 x_raw = (s32)(ir[i] << 8);
+        q->dc_q8 += (x_raw - q->dc_q8) >> 4;
+        s32 ac = x_raw - q->dc_q8;
+#endif
+        s32 ac_q4 = ac >> 4;
+        q->e2 += (u64)((s64)ac_q4 * ac_q4);
+        q->dc_sum += ir[i];
+
+        s32 x = (s32)(((s64)ac * q->gain_q16) >> 16);
+        if (q->gain_q16 != 0 && (x > spike || x < -spike)) inst |= SQI_F_SPIKE;
+        if (x >  2047) x =  2047;
+        if (x < -2047) x = -2047;
+        u32 x2 = (u32)(x * x);
+        q->s2 += x2;
+        q->s4 += (u64)x2 * x2;
+
+        if (inst) {
+            q->hold = SQI_WIN;
+            q->hold_flags |= inst;
+        } else if (q->hold > 0 && --q->hold == 0) {
+            q->hold_flags = 0;
+        }
+
+        if (++q->n >= SQI_WIN) SQI_WindowClose(ch);
+
+        q->flags = q->win_flags | q->hold_flags;
+        ch->sqi_low[i] = q->flags;
+    }
+}
+
+int PPG_QualityOk(const PPG_Channel *ch)
+{
+    return ch->sqi.flags == 0;
+}
+
+u8 PPG_QualityFlags(const PPG_Channel *ch)
+{
+    return ch->sqi.flags;
+}
+
+int PPG_BpmAlarm(const PPG_Channel *ch)
+{
+    if ((int)(ch->bpm + 0.5f) < BPM_ALARM_THRESHOLD || !HR_FingerPresent(ch)) return 0;
+
+    return ch->sample_count - ch->bpm_at <= PPG_ALARM_FRESH ||
+           SQI_BeatOk(ch->sqi.flags);
+}
+
+// ===================== HR ===================== //
+
+#if HR_FIXED_POINT
+
+int HR_ProcessBlock(PPG_Channel *ch, const u32 *ir, const u32 *t_ms, int n,
+                    HR_Beat *beats, int max_beats)
+{
+    // Estado a locales: el bucle trabaja en registros y se guarda al final
+    s32 dc     = ch->dc;
+    s32 prev2  = ch->ac_prev2;
+    s32 prev1  = ch->ac_prev1;
+    s32 curr   = ch->ac_curr;
+    s32 peak   = ch->ac_peak;
+    s32 pfrac  = ch->peak_frac;
+    s32 trough = ch->ac_trough;
+    int since  = ch->samples_since_beat;
+    u32 now    = ch->sample_count;
+    int inpk   = ch->in_peak;
+    float bpm  = ch->bpm;
+    int nbeats = 0;
+    int bn     = 0;
+
+    const int min_samples_between_beats = (int)(0.4f * (float)SAMPLE_RATE_HZ);
+
+    if (n > PPG_BLOCK_MAX) n = PPG_BLOCK_MAX;
+
+    for (int i = 0; i < n; i++) {
+        since++;
+        now++;
+
+        s32 x = (s32)(ir[i] << HR_Q);
+        dc += (x - dc) >> 4;
+
+        if (dc < ((s32)DC_FINGER_MIN << HR_Q)) {
+            since = 0;
+            inpk  = 0;
+            pfrac = 0;
+
+            HR_RateReset(&ch->rate);
+            HR_AcfReset(&ch->acf);
+            HRV_Break(&ch->hrv);
+            AF_Lost(&ch->af);
+            RESP_Reset(&ch->resp);
+
+            ch->ac_blk[i] = 0;
+            bpm = 0.0f;
+            continue;
+        }
+
+        prev2 = prev1;
+        prev1 = curr;
+#if HR_BANDPASS
+        curr  = ch->bp_out[i][BQ_LANE_IR];
+#else
+        curr  = x - dc;
+#endif
+        ch->ac_blk[i] = curr;
+
+        s32 ac_abs = (curr > 0) ? curr : -curr;
+        peak += (ac_abs - peak) >> 3;
+        if (curr < trough) trough = curr;
+
+        HR_AcfPush(&ch->acf, curr);
+
+        s32 dynamic_thresh = (s32)(((s64)peak * 77) >> 8);
+        if (dynamic_thresh < (5 << HR_Q)) {
+            dynamic_thresh = 5 << HR_Q;
+        }
+
+        if (!inpk &&
+            (prev1 > prev2) &&
+            (prev1 > curr) &&
+            (prev1 > dynamic_thresh) &&
+            (since > min_samples_between_beats))
+        {
+            // Vertice de la parabola por prev2/prev1/curr: el pico esta en
+            // prev1 + frac, |frac| <= 1/2 muestra (den < 0 en un maximo)
+            s32 frac = 0;
+#if HR_PEAK_INTERP
+            s32 den = prev2 - 2 * prev1 + curr;
+            frac = (s32)(((s64)(prev2 - curr) << (HR_Q - 1)) / den);
+            if (frac >  (1 << (HR_Q - 1))) frac =  (1 << (HR_Q - 1));
+            if (frac < -(1 << (HR_Q - 1))) frac = -(1 << (HR_Q - 1));
+#endif
+            u32 rr_q = ((u32)since << HR_Q) + frac - pfrac;
+            pfrac = frac;
+
+            u32 inst_q = ((u32)(60 * SAMPLE_RATE_HZ) << (2 * HR_Q)) / rr_q;
+            if (inst_q < (40u << HR_Q) || inst_q > (180u << HR_Q)) inst_q = 0;
+            int accepted = 0;
+
+            if (inst_q != 0 && SQI_BeatOk(ch->sqi_low[i]) &&
+                HR_RateUpdate(&ch->rate, (u16)inst_q, now))
+            {
+                accepted = 1;
+                bpm = (float)HR_RateEstimate(&ch->rate) * (1.0f / (1 << HR_Q));
+                ch->bpm_at = now;
+            }
+
+            // En 64 bits: rr_q * 1000 pasa de 32 tras ~335 s sin latido
+            u32 rr_ms  = (u32)(((u64)rr_q * 1000u) / ((u32)SAMPLE_RATE_HZ << HR_Q));
+            u32 now_ms = now * (1000 / SAMPLE_RATE_HZ);
+            HRV_Push(&ch->hrv, rr_ms, now_ms, accepted);
+            AF_Push(&ch->af, rr_ms, now_ms, prev1 - trough,
+                    inst_q != 0 && SQI_BeatOk(ch->sqi_low[i]));
+            if (accepted) {
+                RESP_Beat(&ch->resp, now_ms, dc, prev1 - trough, (s32)rr_ms);
+            }
+            trough = curr;
+
+            if (beats && t_ms && nbeats < max_beats) {
+                // El pico es la muestra anterior (prev1)
+                beats[nbeats].t_ms     = t_ms[i] - 1000 / SAMPLE_RATE_HZ
+                                       + (frac * 1000) / (SAMPLE_RATE_HZ << HR_Q);
+                beats[nbeats].rr_ms    = (u16)rr_ms;
+                beats[nbeats].accepted = (u8)accepted;
+                beats[nbeats].bpm      = (float)inst_q * (1.0f / (1 << HR_Q));
+                nbeats++;
+            }
+
+            ch->beat_idx[bn++] = (u8)i;
+            since = 0;
+            inpk  = 1;
+        }
+
+        if (inpk && curr < (s32)(((s64)dynamic_thresh * 77) >> 8)) {
+            inpk = 0;
+        }
+    }
+
+    ch->dc       = dc;
+    ch->ac_prev2 = prev2;
+    ch->ac_prev1 = prev1;
+    ch->ac_curr  = curr;
+    ch->ac_peak  = peak;
+    ch->peak_frac = pfrac;
+    ch->ac_trough = trough;
+    ch->samples_since_beat = since;
+    ch->sample_count = now;
+    ch->in_peak  = inpk;
+    ch->beat_n   = bn;
+
+    // Retenido demasiado tiempo: ya no es una lectura
+    if (now - ch->bpm_at > PPG_HOLD) bpm = 0.0f;
+
+    ch->bpm = bpm;
+    return nbeats;
+}
+
+void HR_ProcessSample(PPG_Channel *ch, u32 ir, float *bpm_out)
+{
+    HR_ProcessBlock(ch, &ir, NULL, 1, NULL, 0);
+    *bpm_out = ch->bpm;
+}
+
+int HR_FingerPresent(const PPG_Channel *ch)
+{
+    return ch->dc >= ((s32)DC_FINGER_MIN << HR_Q);
+}
+
+float HR_AcSample(const PPG_Channel *ch, int i)
+{
+    return (float)ch->ac_blk[i] * (1.0f / (1 << HR_Q));
+}
+
+float HR_AcAmplitude(const PPG_Channel *ch)
+{
+    return (float)ch->ac_peak * (1.0f / (1 << HR_Q));
+}
+
+#else
+
+int HR_ProcessBlock(PPG_Channel *ch, const u32 *ir, const u32 *t_ms, int n,
+                    HR_Beat *beats, int max_beats)
+{
+    // Estado a locales: el bucle trabaja en registros y se guarda al final
+    float dc    = ch->dc;
+    float prev2 = ch->ac_prev2;
+    float prev1 = ch->ac_prev1;
+    float curr  = ch->ac_curr;
+    float peak  = ch->ac_peak;
+    float pfrac = ch->peak_frac;
+    float trough = ch->ac_trough;
+    int   since = ch->samples_since_beat;
+    u32   now   = ch->sample_count;
+    int   inpk  = ch->in_peak;
+    float bpm_display = ch->bpm;
+    int   nbeats = 0;
+    int   bn     = 0;
+
+    const float alpha_inv = 16.0f;
+    const float peak_alpha_inv = 8.0f;
+
+    const float BPM_MIN = 40.0f;
+    const float BPM_MAX = 180.0f;
+
+    const int min_samples_between_beats = (int)(0.4f * (float)SAMPLE_RATE_HZ);
+
+    if (n > PPG_BLOCK_MAX) n = PPG_BLOCK_MAX;
+
+    for (int i = 0; i < n; i++) {
+        since++;
+        now++;
+
+        dc += ((float)ir[i] - dc) / alpha_inv;
+
+        if (dc < DC_FINGER_MIN) {
+            since = 0;
+            inpk  = 0;
+            pfrac = 0;
+
+            HR_RateReset(&ch->rate);
+            HR_AcfReset(&ch->acf);
+            HRV_Break(&ch->hrv);
+            AF_Lost(&ch->af);
+            RESP_Reset(&ch->resp);
+
+            ch->ac_blk[i] = 0.0f;
+            bpm_display = 0.0f;
+            continue;
+        }
+
+        prev2 = prev1;
+        prev1 = curr;
+#if HR_BANDPASS
+        curr  = ch->bp_out[i][BQ_LANE_IR];
+#else
+        curr  = (float)ir[i] - dc;
+#endif
+        ch->ac_blk[i] = curr;
+
+        float ac_abs = (curr > 0) ? curr : -curr;
+        peak += (ac_abs - peak) / peak_alpha_inv;
+        if (curr < trough) trough = curr;
+
+        HR_AcfPush(&ch->acf, (s32)(curr * 256.0f));
+
+        float dynamic_thresh = peak * 0.3f;
+        if (dynamic_thresh < 5.0f) {
+            dynamic_thresh = 5.0f;
+        }
+
+        if (!inpk &&
+            (prev1 > prev2) &&
+            (prev1 > curr) &&
+            (prev1 > dynamic_thresh) &&
+            (since > min_samples_between_beats))
+        {
+            // Vertice de la parabola por prev2/prev1/curr: el pico esta en
+            // prev1 + frac, |frac| <= 1/2 muestra
+            float frac = 0.0f;
+#if HR_PEAK_INTERP
+            frac = 0.5f * (prev2 - curr) / (prev2 - 2.0f * prev1 + curr);
+#endif
+            float rr = (float)since + frac - pfrac;
+            pfrac = frac;
+
+            float inst_bpm = 60.0f * (float)SAMPLE_RATE_HZ / rr;
+            int in_range = (inst_bpm >= BPM_MIN && inst_bpm <= BPM_MAX);
+            int accepted = 0;
+
+            if (in_range && SQI_BeatOk(ch->sqi_low[i]) &&
+                HR_RateUpdate(&ch->rate, (u16)(inst_bpm * 256.0f + 0.5f), now))
+            {
+                accepted = 1;
+                bpm_display = (float)HR_RateEstimate(&ch->rate) * (1.0f / 256.0f);
+                ch->bpm_at = now;
+            }
+
+            u32 rr_ms  = (u32)(rr * 1000.0f / SAMPLE_RATE_HZ + 0.5f);
+            u32 now_ms = now * (1000 / SAMPLE_RATE_HZ);
+            HRV_Push(&ch->hrv, rr_ms, now_ms, accepted);
+            AF_Push(&ch->af, rr_ms, now_ms, (s32)((prev1 - trough) * 256.0f),
+                    in_range && SQI_BeatOk(ch->sqi_low[i]));
+            if (accepted) {
+                RESP_Beat(&ch->resp, now_ms, (s32)(dc * 256.0f),
+                          (s32)((prev1 - trough) * 256.0f), (s32)rr_ms);
+            }
+            trough = curr;
+
+            if (beats && t_ms && nbeats < max_beats) {
+                // El pico es la muestra anterior (prev1)
+                beats[nbeats].t_ms     = t_ms[i] - (u32)((1.0f - frac) * 1000.0f / SAMPLE_RATE_HZ + 0.5f);
+                beats[nbeats].rr_ms    = (u16)rr_ms;
+                beats[nbeats].accepted = (u8)accepted;
+                beats[nbeats].bpm      = in_range ? inst_bpm : 0.0f;
+                nbeats++;
+            }
+
+            ch->beat_idx[bn++] = (u8)i;
+            since = 0;
+            inpk  = 1;
+        }
+
+        if (inpk && curr < dynamic_thresh * 0.3f) {
+            inpk = 0;
+        }
+    }
+
+    ch->dc       = dc;
+    ch->ac_prev2 = prev2;
+    ch->ac_prev1 = prev1;
+    ch->ac_curr  = curr;
+    ch->ac_peak  = peak;
+    ch->peak_frac = pfrac;
+    ch->ac_trough = trough;
+    ch->samples_since_beat = since;
+    ch->sample_count = now;
+    ch->in_peak  = inpk;
+    ch->beat_n   = bn;
+
+    // Retenido demasiado tiempo: ya no es una lectura
+    if (now - ch->bpm_at > PPG_HOLD) bpm_display = 0.0f;
+
+    ch->bpm = bpm_display;
+    return nbeats;
+}
+
+void HR_ProcessSample(PPG_Channel *ch, u32 ir, float *bpm_out)
+{
+    HR_ProcessBlock(ch, &ir, NULL, 1, NULL, 0);
+    *bpm_out = ch->bpm;
+}
+
+int HR_FingerPresent(const PPG_Channel *ch)
+{
+    return ch->dc >= DC_FINGER_MIN;
+}
+
+float HR_AcSample(const PPG_Channel *ch, int i)
+{
+    return ch->ac_blk[i];
+}
+
+float HR_AcAmplitude(const PPG_Channel *ch)
+{
+    return ch->ac_peak;
+}
+
+#endif
+
+float HR_AcfBpm(const PPG_Channel *ch)
+{
+    return (float)ch->acf.bpm_q8 * (1.0f / 256.0f);
+}
+
+float HR_AcfConfidence(const PPG_Channel *ch)
+{
+    return (float)ch->acf.conf_q8 * (1.0f / 256.0f);
+}
+
+// ===================== MORFOLOGIA ===================== //
+//
+// Rasgos de cada latido sobre el IR crudo (Q8, enteros comunes a float y
+// punto fijo). El pasabanda del HR deforma el pulso (atrasa el pico y
+// lleva el valle a media diastole), asi que aqui solo marca cuando cerrar:
+// la ventana va del pico crudo del latido anterior (x[0]) hasta la
+// deteccion del HR, que llega unas muestras despues del pico crudo. Una
+// pasada sobre la ventana termina el latido anterior y encuentra el nuevo:
+//   bajada    = cruce de la media amplitud del anterior
+//   muesca    = minimo local de la bajada, antes del pie, seguido de una
+//               subida de al menos amplitud / MORPH_NOTCH_DIV
+//   pie, pico = minimo de la ventana y maximo despues de el (el pico con
+//               vertice de parabola, como el HR)
+// y el frente de subida (pie -> pico, pocas muestras) da el cruce de
+// subida por (pie + pico) / 2; los cruces son lineales entre muestras:
+//   subida    = pico - pie         ancho = bajada - subida
+//   perfusion = (pico - pie) / DC, con la suma del crudo que junta el SpO2
+// Las muestras desde el pico nuevo pasan al frente para la proxima
+// ventana. El registro sale al anillo un latido despues de su pico.
+// Costo: una copia por muestra y una pasada de 60 * fs / BPM muestras por
+// latido. A 25 Hz la muesca casi nunca llega a verse.
+
+static void MORPH_Reset(MORPH_State *m)
+{
+    // El anillo y seq quedan para el lector
+    m->len    = 0;
+    m->low_q  = 0;
+    m->primed = 0;
+}
+
+static inline void MORPH_Sample(MORPH_State *m, s32 x_q8, u8 low_q)
+{
+    if (m->len < MORPH_WIN) m->x[m->len] = x_q8;
+    if (m->len <= MORPH_WIN) m->len++;
+    m->low_q |= low_q;
+}
+
+// Vertice de la parabola por a/b/c (b el extremo): desplazamiento desde b
+// en Q8 de muestra, |d| <= 1/2
+static inline s32 MORPH_Vertex(s32 a, s32 b, s32 c)
+{
+#if HR_PEAK_INTERP
+    s32 den = a - 2 * b + c;
+    if (den == 0) return 0;
+    s32 d = (s32)(((s64)(a - c) << 7) / den);
+    if (d >  128) d =  128;
+    if (d < -128) d = -128;
+    return d;
+#else
+    (void)a; (void)b; (void)c;
+    return 0;
+#endif
+}
+
+// Cruce del nivel entre las muestras j-1 (a) y j (b): posicion en Q8
+static inline s32 MORPH_Cross(int j, s32 a, s32 b, s32 lvl)
+{
+    s32 pos = (j - 1) << 8;
+    if (b != a) pos += (s32)(((s64)(lvl - a) << 8) / (b - a));
+    return pos;
+}
+
+// Q8 de muestra -> ms (saturado)
+static inline u16 MORPH_Ms(s32 q8)
+{
+    if (q8 <= 0) return 0;
+    u32 ms = (u32)(((u64)q8 * 1000u) / ((u32)SAMPLE_RATE_HZ << 8));
+    return (ms > 0xFFFF) ? 0xFFFF : (u16)ms;
+}
+
+// Cierra la ventana en una deteccion del HR: now = reloj del canal en
+// x[len-1], ir_sum / ir_len = DC del tramo (la del SpO2)
+static void MORPH_BeatClose(MORPH_State *m, u32 now, u32 ir_sum, u32 ir_len)
+{
+    s32 *w = m->x;
+    int L = m->len;
+
+    if (L > MORPH_WIN) {
+        // Latido de menos de 40 BPM: se corta la cadena
+        MORPH_Reset(m);
+        return;
+    }
+
+    // Pasada unica: bajada y muesca del anterior; pie (mn) y pico (mx,
+    // maximo despues del pie) del nuevo. La muesca va sobre el crudo
+    // suavizado (1 2 1) / 4: es chica y el ruido la inventa.
+    s32 half = m->half_q8, hy = m->hyst_q8;
+    s32 down = 0;
+    int have_down = 0;
+    int nst = 0, lmin_j = -1, notch_j = -1, notch_end = 0;
+    s32 lmin = w[0], lmax = 0;
+    s32 mn = w[0], mx = w[0];
+    int mn_j = 0, mx_j = 0;
+
+    for (int j = 1; j < L; j++) {
+        s32 v  = w[j];
+        s32 vs = (j < L - 1) ? (w[j - 1] + 2 * v + w[j + 1]) >> 2 : v;
+
+        if (m->primed) {
+            if (!have_down && v < half && w[j - 1] >= half) {
+                down = MORPH_Cross(j, w[j - 1], v, half);
+                have_down = 1;
+            }
+            if (nst == 0) {
+                if (vs < lmin) {
+                    lmin = vs;
+                    lmin_j = j;
+                } else if (vs > lmin + hy) {
+                    nst  = 1;
+                    lmax = vs;
+                }
+            } else if (vs > lmax) {
+                lmax = vs;
+            } else if (vs < lmax - hy) {
+                if (notch_j < 0) {
+                    notch_j   = lmin_j;
+                    notch_end = j;
+                }
+                nst    = 0;
+                lmin   = vs;
+                lmin_j = j;
+            }
+        }
+
+        if (v < mn) {
+            mn = mx = v;
+            mn_j = mx_j = j;
+        } else if (v > mx) {
+            mx   = v;
+            mx_j = j;
+        }
+    }
+
+    if (mx_j <= mn_j || mx_j >= L - 1) {
+        // Sin pulso en la ventana (el HR detecto otra cosa)
+        MORPH_Reset(m);
+        return;
+    }
+
+    // Frente de subida: primer cruce de la media amplitud nueva
+    s32 amp = mx - mn;
+    s32 lvl = mn + (amp >> 1);
+    s32 up  = mn_j << 8;
+    for (int j = mn_j + 1; j <= mx_j; j++) {
+        if (w[j] >= lvl) {
+            up = MORPH_Cross(j, w[j - 1], w[j], lvl);
+            break;
+        }
+    }
+
+    s32 pk_pos = (mx_j << 8) + MORPH_Vertex(w[mx_j - 1], mx, w[mx_j + 1]);
+    s32 mn_pos = mn_j << 8;
+    if (mn_j > 0) mn_pos += MORPH_Vertex(w[mn_j - 1], mn, w[mn_j + 1]);
+
+    // Termina el latido anterior (pico en x[0] + pk_frac) y sale al anillo
+    if (m->primed) {
+        MORPH_Beat *r = &m->pend;
+        if (have_down && m->up_q8 > 0) {
+            r->width_ms = MORPH_Ms(m->up_q8 + down - m->pk_frac);
+        }
+        if (notch_j > 0 && notch_end < mn_j) {
+            r->flags   |= MORPH_F_NOTCH;
+            r->notch_ms = MORPH_Ms((notch_j << 8) - m->pk_frac);
+        }
+        if (m->low_q) r->flags |= MORPH_F_LOWQ;
+
+        m->ring[m->seq & (MORPH_RING - 1)] = *r;
+        m->seq++;
+    }
+
+    // Empieza el nuevo: todo lo que se sabe hasta su pico
+    MORPH_Beat *r = &m->pend;
+    memset(r, 0, sizeof(*r));
+    u64 t_q8 = ((u64)(now - (u32)(L - 1)) << 8) + (u64)pk_pos;
+    r->t_ms    = (u32)((t_q8 * 1000u) / ((u32)SAMPLE_RATE_HZ << 8));
+    r->rr_ms   = m->primed ? MORPH_Ms(pk_pos - m->pk_frac) : 0;
+    r->rise_ms = MORPH_Ms(pk_pos - mn_pos);
+    if (ir_sum > 0) {
+        u64 pi = ((u64)amp * ir_len * 10000u) / ((u64)ir_sum << 8);
+        r->pi_x100 = (pi > 0xFFFF) ? 0xFFFF : (u16)pi;
+    }
+    if (m->low_q) r->flags |= MORPH_F_LOWQ;
+
+    m->up_q8   = pk_pos - up;
+    m->pk_frac = pk_pos - (mx_j << 8);
+    m->half_q8 = lvl;
+    m->hyst_q8 = amp / MORPH_NOTCH_DIV;
+    m->primed  = 1;
+
+    // Del pico nuevo en adelante es la proxima ventana
+    m->len = (u16)(L - mx_j);
+    memmove(w, w + mx_j, (size_t)m->len * sizeof(w[0]));
+    m->low_q = 0;
+}
+
+int MORPH_Read(const PPG_Channel *ch, u32 *seq, MORPH_Beat *out, int max)
+{
+    const MORPH_State *m = &ch->morph;
+    u32 s = *seq;
+    int k = 0;
+
+    if ((s32)(m->seq - s) < 0) s = m->seq;                   // canal reiniciado
+    if (m->seq - s > MORPH_RING) s = m->seq - MORPH_RING;
+
+    while (s != m->seq && k < max) {
+        out[k++] = m->ring[s & (MORPH_RING - 1)];
+        s++;
+    }
+    *seq = s;
+    return k;
+}
+
+// ===================== SpO2 ===================== //
+//
+// Ratio of ratios por latido, en enteros (comun a float y punto fijo). El
+// latido va de una deteccion del HR a la siguiente; en ese tramo se toma
+// el AC pico a valle de cada canal (salida del pasabanda, o el crudo sin
+// pasabanda) y la DC como media del crudo:
+//   pi     = ac * len / (256 * suma)        perfusion, Q24
+//   R      = pi_red / pi_ir                 Q16
+//   spo2   = SPO2_Calibrate(cal, R)         Q8, tabla del lote
+//   salida += (spo2 - salida) >> SPO2_BEAT_SHIFT
+// Se descartan latidos fuera de 40..180 BPM, con AC < SPO2_AC_MIN o con
+// alguna muestra de calidad baja (SQI).
+
+// Curva por defecto: ajuste cuadratico de referencia del MAX30102
+// (-45.060 R^2 + 30.354 R + 94.845), muestreado cada 1/16 desde R = 0.375
+// (su maximo) hasta 1.375
+static const u16 spo2_cal_max30102_q8[17] = {
+    25572, 25472, 25282, 25001, 24631, 24170, 23620, 22979, 22248,
+    21427, 20516, 19514, 18423, 17241, 15970, 14608, 13156,
+};
+
+static const SPO2_Cal SPO2_CAL_DEFAULT = {
+    24576,      // 0.375 en Q16
+    12,         // paso 1/16
+    17,
+    spo2_cal_max30102_q8,
+};
+
+// La tabla tiene que tener al menos 2 puntos, SpO2 que no sube con R y a
+// lo sumo 100 %; si no, el canal se queda con la que tenia
+int SPO2_SetCalibration(PPG_Channel *ch, const SPO2_Cal *cal)
+{
+    if (!cal || !cal->spo2_q8 || cal->n < 2 || cal->step_shift > 24) return XST_INVALID_PARAM;
+
+    for (int i = 0; i < cal->n; i++) {
+        if (cal->spo2_q8[i] > (100u << 8)) return XST_INVALID_PARAM;
+        if (i > 0 && cal->spo2_q8[i] > cal->spo2_q8[i - 1]) return XST_INVALID_PARAM;
+    }
+
+    ch->spo2_cal = cal;
+    return XST_SUCCESS;
+}
+
+u32 SPO2_Calibrate(const SPO2_Cal *cal, u32 r_q16)
+{
+    if (r_q16 <= cal->r0_q16) return cal->spo2_q8[0];
+
+    u32 d   = r_q16 - cal->r0_q16;
+    u32 idx = d >> cal->step_shift;
+    if (idx >= (u32)(cal->n - 1)) return cal->spo2_q8[cal->n - 1];
+
+    u32 frac = d & ((1u << cal->step_shift) - 1);
+    s32 y0 = cal->spo2_q8[idx];
+    s32 y1 = cal->spo2_q8[idx + 1];
+    return (u32)(y0 + (s32)(((s64)(y1 - y0) * frac) >> cal->step_shift));
+}
+
+static void SPO2_BeatStart(SPO2_Beat *b)
+{
+    b->red_sum = b->ir_sum = 0;
+    b->len  = 0;
+    b->open = 1;
+    b->low_q = 0;
+}
+
+// Perfusion ac/dc en Q24 (ac en Q8, dc = suma/len)
+static inline u32 SPO2_PerfusionQ24(s32 ac_q8, u32 sum, u32 len)
+{
+    return (u32)((((u64)ac_q8 * len) << 16) / sum);
+}
+
+// Cierra el latido en curso; si es valido actualiza R y la estimacion
+static void SPO2_BeatClose(PPG_Channel *ch, u32 now)
+{
+    SPO2_Beat *b = &ch->spo2_beat;
+    const u32 len_min = (60 * SAMPLE_RATE_HZ) / 180;
+    const u32 len_max = (60 * SAMPLE_RATE_HZ) / 40;
+
+    if (b->open && SQI_BeatOk(b->low_q) && b->len >= len_min && b->len <= len_max) {
+        s32 ac_red = b->red_max - b->red_min;
+        s32 ac_ir  = b->ir_max  - b->ir_min;
+
+        if (ac_red >= (SPO2_AC_MIN << 8) && ac_ir >= (SPO2_AC_MIN << 8)) {
+            u32 pi_red = SPO2_PerfusionQ24(ac_red, b->red_sum, b->len);
+            u32 pi_ir  = SPO2_PerfusionQ24(ac_ir,  b->ir_sum,  b->len);
+
+            if (pi_ir > 0) {
+                b->r_q16 = (u32)(((u64)pi_red << 16) / pi_ir);
+
+                s32 inst = (s32)SPO2_Calibrate(ch->spo2_cal, b->r_q16);
+                if (b->spo2_q8 <= 0) {
+                    b->spo2_q8 = inst;
+                } else {
+                    b->spo2_q8 += (inst - b->spo2_q8) >> SPO2_BEAT_SHIFT;
+                }
+                ch->spo2_at = now;
+            }
+        }
+    }
+
+    SPO2_BeatStart(b);
+}
+
+void SPO2_UpdateBlock(PPG_Channel *ch, const u32 *red_raw, const u32 *ir_raw, int n)
+{
+    SPO2_Beat *b = &ch->spo2_beat;
+    const u32 len_max = (60 * SAMPLE_RATE_HZ) / 40;
+    int next = 0;
+
+    if (n > PPG_BLOCK_MAX) n = PPG_BLOCK_MAX;
+
+    // Reloj del canal de la muestra 0 (el HR ya lo avanzo todo el bloque)
+    u32 now = ch->sample_count - (u32)n + 1;
+
+    for (int i = 0; i < n; i++, now++) {
+        int is_beat = (next < ch->beat_n && ch->beat_idx[next] == i);
+        if (is_beat) next++;
+
+        if (red_raw[i] < 8000 || ir_raw[i] < 8000) {
+            memset(b, 0, sizeof(*b));
+            MORPH_Reset(&ch->morph);
+            continue;
+        }
+
+        if (b->open && b->len <= len_max) {
+#if HR_BANDPASS && HR_FIXED_POINT
+            s32 red_ac = ch->bp_out[i][BQ_LANE_RED];
+            s32 ir_ac  = ch->bp_out[i][BQ_LANE_IR];
+#elif HR_BANDPASS
+            s32 red_ac = (s32)(ch->bp_out[i][BQ_LANE_RED] * 256.0f);
+            s32 ir_ac  = (s32)(ch->bp_out[i][BQ_LANE_IR]  * 256.0f);
+#else
+            // Sin pasabanda el pico a valle del crudo ya es el AC
+            s32 red_ac = (s32)(red_raw[i] << 8);
+            s32 ir_ac  = (s32)(ir_raw[i]  << 8);
+#endif
+            if (b->len == 0) {
+                b->red_max = b->red_min = red_ac;
+                b->ir_max  = b->ir_min  = ir_ac;
+            }
+            if (red_ac > b->red_max) b->red_max = red_ac;
+            if (red_ac < b->red_min) b->red_min = red_ac;
+            if (ir_ac  > b->ir_max)  b->ir_max  = ir_ac;
+            if (ir_ac  < b->ir_min)  b->ir_min  = ir_ac;
+            b->red_sum += red_raw[i];
+            b->ir_sum  += ir_raw[i];
+            b->low_q   |= ch->sqi_low[i];
+            b->len++;
+        }
+
+        MORPH_Sample(&ch->morph, (s32)(ir_raw[i] << 8), ch->sqi_low[i]);
+
+        // El latido incluye la muestra de la deteccion (el pico es la anterior)
+        if (is_beat) {
+            MORPH_BeatClose(&ch->morph, now, b->ir_sum, b->len);
+            SPO2_BeatClose(ch, now);
+        }
+    }
+
+    // Retenido demasiado tiempo: la proxima lectura buena arranca de cero
+    if (ch->sample_count - ch->spo2_at > PPG_HOLD) b->spo2_q8 = 0;
+
+    ch->spo2 = (float)b->spo2_q8 * (1.0f / 256.0f);
+}
+
+void SPO2_Update(PPG_Channel *ch, u32 red_raw, u32 ir_raw, float *spo2_out)
+{
+    SPO2_UpdateBlock(ch, &red_raw, &ir_raw, 1);
+    *spo2_out = ch->spo2;
+}
+
+// ===================== CANAL PPG ===================== //
+
+void PPG_ChannelInit(PPG_Channel *ch)
+{
+    memset(ch, 0, sizeof(*ch));
+    ch->Ta = -1000.0f;
+    ch->To = -1000.0f;
+    ch->spo2_cal = &SPO2_CAL_DEFAULT;
+    HRV_Reset(&ch->hrv);
+}
+
+void PPG_ChannelReset(PPG_Channel *ch)
+{
+    float Ta = ch->Ta;
+    float To = ch->To;
+    const SPO2_Cal *cal = ch->spo2_cal;
+
+    PPG_ChannelInit(ch);
+    ch->Ta = Ta;
+    ch->To = To;
+    ch->spo2_cal = cal;
+}
+
+int PPG_ChannelProcess(PPG_Channel *ch, const u32 *red, const u32 *ir,
+                       const u32 *t_ms, int n, HR_Beat *beats, int max_beats)
+{
+    PPG_FrontEndBlock(ch, red, ir, n);
+    SQI_UpdateBlock(ch, red, ir, n);
+    int nbeats = HR_ProcessBlock(ch, ir, t_ms, n, beats, max_beats);
+    SPO2_UpdateBlock(ch, red, ir, n);
+    return nbeats;
+}
+
+// ===================== TENDENCIAS ===================== //
+
+static const u16 trend_res_s[TREND_LEVELS] = { 1, 60, 900, 3600 };
+static const u16 trend_ring[TREND_LEVELS] = {
+    TREND_DEPTH_1S + 1, TREND_DEPTH_1M + 1, TREND_DEPTH_15M + 1, TREND_DEPTH_1H + 1
+};
+static const u16 trend_base[TREND_LEVELS] = {
+    0,
+    TREND_DEPTH_1S + 1,
+    TREND_DEPTH_1S + TREND_DEPTH_1M + 2,
+    TREND_DEPTH_1S + TREND_DEPTH_1M + TREND_DEPTH_15M + 3,
+};
+
+void TREND_Init(TREND_Store *tr)
+{
+    memset(tr, 0, sizeof(*tr));
+}
+
+// Indice en b[sig] de la cubeta del periodo k en el nivel l, o -1 si es
+// posterior a la mas nueva o ya salio del anillo
+static int TREND_Slot(const TREND_Store *tr, int sig, int l, u32 k)
+{
+    const u32 depth = trend_ring[l];
+    u32 back = tr->last[sig][l] - k;
+    u32 head = tr->head[sig][l];
+
+    if ((s32)back < 0 || back >= depth) return -1;
+    return trend_base[l] + (int)((head >= back) ? head - back : head + depth - back);
+}
+
+// Periodo k nuevo: el anillo avanza vaciando las cubetas que pasaron (a lo
+// sumo el anillo). Uno viejo todavia en el anillo se actualiza en su lugar.
+static void TREND_LevelPush(TREND_Store *tr, int sig, int l, u32 k, s16 v)
+{
+    u32 gap = k - tr->last[sig][l];
+
+    if ((s32)gap > 0) {
+        TREND_Bucket *ring = &tr->b[sig][trend_base[l]];
+        const u32 depth = trend_ring[l];
+        u32 head = tr->head[sig][l];
+
+        if (gap > depth) gap = depth;
+        while (gap--) {
+            if (++head == depth) head = 0;
+            memset(&ring[head], 0, sizeof(ring[head]));
+        }
+        tr->last[sig][l] = k;
+        tr->head[sig][l] = (u16)head;
+    }
+
+    int slot = TREND_Slot(tr, sig, l, k);
+    if (slot < 0) return;
+
+    TREND_Bucket *b = &tr->b[sig][slot];
+    if (b->n == 0) {
+        b->min = v;
+        b->max = v;
+    } else {
+        if (v < b->min) b->min = v;
+        if (v > b->max) b->max = v;
+    }
+    b->sum += v;
+    b->n++;
+}
+
+void TREND_Push(TREND_Store *tr, int sig, u32 t_ms, float v)
+{
+    if (sig < 0 || sig >= TREND_SIGNALS) return;
+
+    float x = v * 100.0f + ((v >= 0.0f) ? 0.5f : -0.5f);
+    if (x >  32767.0f) x =  32767.0f;
+    if (x < -32768.0f) x = -32768.0f;
+
+    u32 t_s = t_ms / 1000;
+    if (!tr->primed[sig] || (s32)(t_s - tr->first_s[sig]) < 0) {
+        tr->first_s[sig] = t_s;
+    }
+    for (int l = 0; l < TREND_LEVELS; l++) {
+        u32 k = t_s / trend_res_s[l];
+        if (!tr->primed[sig]) tr->last[sig][l] = k;
+        TREND_LevelPush(tr, sig, l, k, (s16)x);
+    }
+    tr->primed[sig] = 1;
+}
+
+void TREND_PushChannel(TREND_Store *tr, const PPG_Channel *ch)
+{
+    if (ch->beat_n == 0 || !SQI_BeatOk(ch->sqi.flags)) return;
+
+    u32 t_ms = ch->sample_count * (1000 / SAMPLE_RATE_HZ);
+    if (ch->bpm  > 0.0f) TREND_Push(tr, TREND_BPM,  t_ms, ch->bpm);
+    if (ch->spo2 > 0.0f) TREND_Push(tr, TREND_SPO2, t_ms, ch->spo2);
+}
+
+int TREND_Query(const TREND_Store *tr, int sig, u32 t0_ms, u32 t1_ms,
+                TREND_Summary *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (sig < 0 || sig >= TREND_SIGNALS || !tr->primed[sig]) return -1;
+    if ((s32)(t1_ms - t0_ms) <= 0) return -1;
+
+    // Antes del primer dato no hay nada que buscar en niveles gruesos
+    u32 t0_s = t0_ms / 1000, t1_s = (t1_ms - 1) / 1000;
+    if ((s32)(t0_s - tr->first_s[sig]) < 0) t0_s = tr->first_s[sig];
+    if ((s32)(t1_s - t0_s) < 0) return -1;
+
+    // Nivel mas fino cuyo anillo todavia tiene el comienzo de la ventana
+    int l = 0;
+    while (l < TREND_LEVELS - 1 &&
+           (s32)(tr->last[sig][l] - t0_s / trend_res_s[l]) >= trend_ring[l])
+    {
+        l++;
+    }
+
+    // Solo las cubetas que quedan: a lo sumo una vuelta del anillo
+    u32 last = tr->last[sig][l];
+    u32 k0 = t0_s / trend_res_s[l], k1 = t1_s / trend_res_s[l];
+    if ((s32)(k1 - last) > 0) k1 = last;
+    if ((s32)(last - k0) >= trend_ring[l]) k0 = last - (trend_ring[l] - 1);
+    if ((s32)(k1 - k0) < 0) return -1;
+
+    out->t0_ms = k0 * trend_res_s[l] * 1000;
+    out->t1_ms = (k1 + 1) * trend_res_s[l] * 1000;
+
+    s64 sum = 0;
+    for (u32 k = k0; (s32)(k1 - k) >= 0; k++) {
+        int slot = TREND_Slot(tr, sig, l, k);
+        if (slot < 0 || tr->b[sig][slot].n == 0) continue;
+
+        const TREND_Bucket *b = &tr->b[sig][slot];
+        if (out->n == 0 || b->min < out->min) out->min = b->min;
+        if (out->n == 0 || b->max > out->max) out->max = b->max;
+        sum    += b->sum;
+        out->n += b->n;
+    }
+
+    if (out->n == 0) return -1;
+    out->mean = (s16)(sum / (s64)out->n);
+    return l;
 }
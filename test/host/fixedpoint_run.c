@@ -0,0 +1,25 @@
+// El firmware compilado con HR_FIXED_POINT=1 dentro de la prueba float
+// test_fixedpoint: se compila con -fvisibility=hidden y objcopy
+// --localize-hidden deja local todo menos FixedRun, asi que las dos copias
+// de main.c conviven en el mismo ejecutable.
+
+#include "harness.h"
+
+#if !HR_FIXED_POINT
+#error "fixedpoint_run.c se compila con -DHR_FIXED_POINT=1"
+#endif
+
+// Procesa n muestras de a una en un canal nuevo y deja bpm y spo2 despues
+// de cada una
+__attribute__((visibility("default")))
+void FixedRun(const u32 *red, const u32 *ir, int n, float *bpm, float *spo2)
+{
+    static PPG_Channel ch;
+    PPG_ChannelInit(&ch);
+
+    for (int i = 0; i < n; i++) {
+        PPG_ChannelProcess(&ch, &red[i], &ir[i], NULL, 1, NULL, 0);
+        bpm[i]  = ch.bpm;
+        spo2[i] = ch.spo2;
+    }
+}
@@ -0,0 +1,12 @@
+// Binario estatico que usa snprintf con enteros y float, para medir cuanto
+// codigo de glibc arrastra contra las funciones FMT_* ("make fmt-size").
+
+#include <stdio.h>
+
+int main(int argc, char **argv)
+{
+    char b[32];
+    (void)argv;
+    snprintf(b, sizeof(b), "%*.*f %d", 5, 1, argc * 1.5, argc);
+    return puts(b) < 0;
+}
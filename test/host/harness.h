@@ -0,0 +1,79 @@
+// Arnes comun de las pruebas de host: compila el firmware completo
+// (src/main.c) con los drivers de stubs.c; su main() queda como fw_main.
+// Cada prueba es un ejecutable que devuelve 0 si todo paso. Con el
+// argumento "bench" ademas mide tiempos por llamada.
+
+#ifndef HARNESS_H
+#define HARNESS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define main fw_main
+#include "../../src/main.c"
+#undef main
+
+// Modelo del panel OLED (stubs.c): RAM, inversion y encendido segun lo que
+// llego por I2C
+extern u8  stub_oled_ram[8][132];
+extern int stub_oled_inverted;
+extern int stub_oled_on;
+extern int stub_oled_scrolling;
+extern int stub_oled_contrast;
+extern u32 stub_oled_bytes;
+
+// Modelo de la FIFO del MAX30102 (stubs.c): muestras esperando, la
+// muestra k del flujo y los bytes que pasaron por el bus
+extern int stub_max_fifo;
+extern u32 stub_max_seq;
+extern u32 stub_max_bytes;
+u32 StubMaxRed(u32 k);
+u32 StubMaxIr(u32 k);
+
+static int test_failures;
+
+#define CHECK(cond, ...)                                                   \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            test_failures++;                                               \
+            printf("FALLA %s:%d: ", __FILE__, __LINE__);                   \
+            printf(__VA_ARGS__);                                           \
+            printf("\n");                                                  \
+        }                                                                  \
+    } while (0)
+
+static inline int TestBenchMode(int argc, char **argv)
+{
+    return argc > 1 && strcmp(argv[1], "bench") == 0;
+}
+
+static inline double TestNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Generador reproducible (LCG) para fixtures sinteticos: uniforme en [0, 1)
+static unsigned test_seed = 12345u;
+
+static inline double TestRand(void)
+{
+    test_seed = test_seed * 1103515245u + 12345u;
+    return ((test_seed >> 8) & 0xFFFFFF) / 16777216.0;
+}
+
+static inline int TestDone(const char *name)
+{
+    if (test_failures) {
+        printf("%s: %d fallas\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,104 @@
+// Subconjunto de <arm_neon.h> en C escalar, para compilar y probar en el
+// host los caminos NEON del firmware (-D__ARM_NEON -I neon). Cada
+// intrinseco hace lo que dice el manual de ARM para ARMv7: VMLA/VMLS
+// redondean el producto antes de sumar (compilar con -ffp-contract=off
+// para que gcc no los fusione), VMLAL/VMLSL acumulan en 64 bits sin
+// saturar y VRSHRN suma 2^(n-1) antes de desplazar y trunca a 32 bits.
+
+#ifndef HOST_ARM_NEON_H
+#define HOST_ARM_NEON_H
+
+#include <stdint.h>
+
+typedef struct { float   v[2]; } float32x2_t;
+typedef struct { int32_t v[2]; } int32x2_t;
+typedef struct { int64_t v[2]; } int64x2_t;
+
+static inline float32x2_t vld1_f32(const float *p)
+{
+    float32x2_t r = { { p[0], p[1] } };
+    return r;
+}
+
+static inline void vst1_f32(float *p, float32x2_t a)
+{
+    p[0] = a.v[0];
+    p[1] = a.v[1];
+}
+
+static inline float32x2_t vmul_n_f32(float32x2_t a, float b)
+{
+    float32x2_t r = { { a.v[0] * b, a.v[1] * b } };
+    return r;
+}
+
+static inline float32x2_t vmla_n_f32(float32x2_t a, float32x2_t b, float c)
+{
+    float32x2_t r;
+    for (int l = 0; l < 2; l++) {
+        float p = b.v[l] * c;
+        r.v[l] = a.v[l] + p;
+    }
+    return r;
+}
+
+static inline float32x2_t vmls_n_f32(float32x2_t a, float32x2_t b, float c)
+{
+    float32x2_t r;
+    for (int l = 0; l < 2; l++) {
+        float p = b.v[l] * c;
+        r.v[l] = a.v[l] - p;
+    }
+    return r;
+}
+
+static inline int32x2_t vld1_s32(const int32_t *p)
+{
+    int32x2_t r = { { p[0], p[1] } };
+    return r;
+}
+
+static inline void vst1_s32(int32_t *p, int32x2_t a)
+{
+    p[0] = a.v[0];
+    p[1] = a.v[1];
+}
+
+static inline int64x2_t vmull_n_s32(int32x2_t a, int32_t b)
+{
+    int64x2_t r = { { (int64_t)a.v[0] * b, (int64_t)a.v[1] * b } };
+    return r;
+}
+
+static inline int64x2_t vmlal_n_s32(int64x2_t a, int32x2_t b, int32_t c)
+{
+    int64x2_t r;
+    for (int l = 0; l < 2; l++) {
+        r.v[l] = (int64_t)((uint64_t)a.v[l] + (uint64_t)((int64_t)b.v[l] * c));
+    }
+    return r;
+}
+
+static inline int64x2_t vmlsl_n_s32(int64x2_t a, int32x2_t b, int32_t c)
+{
+    int64x2_t r;
+    for (int l = 0; l < 2; l++) {
+        r.v[l] = (int64_t)((uint64_t)a.v[l] - (uint64_t)((int64_t)b.v[l] * c));
+    }
+    return r;
+}
+
+// n fijo en tiempo de compilacion, como en el intrinseco real (1..32)
+#define vrshrn_n_s64(a, n)  host_vrshrn_s64((a), (n))
+
+static inline int32x2_t host_vrshrn_s64(int64x2_t a, int n)
+{
+    int32x2_t r;
+    for (int l = 0; l < 2; l++) {
+        __int128 x = (__int128)a.v[l] + ((__int128)1 << (n - 1));
+        r.v[l] = (int32_t)(int64_t)(x >> n);
+    }
+    return r;
+}
+
+#endif
@@ -0,0 +1,108 @@
+// Señal PPG sintetica para las pruebas: pulso de subida rapida con onda
+// dicrota, DC con respiracion, perfusion y R (SpO2) fijos y ruido
+// gaussiano. SYN_Next da una muestra a SAMPLE_RATE_HZ y devuelve 1 cuando
+// la fase pasa por el pico: ahi el llamador puede cambiar rr y el RR
+// medido entre picos es exactamente el que eligio.
+//
+// Con rise > 0 el pulso es por tramos, con rasgos conocidos para la
+// morfologia: subida (1 - cos) del pie al pico en rise s, bajada hasta la
+// muesca dicrota (SYN_NOTCH_LVL) a notch s del pico, onda dicrota
+// (SYN_DIC_LVL, SYN_DIC_S despues) y caida en cuarto de coseno hasta el
+// pie, con pendiente para que el pie quede en una muestra. notch = 0: sin
+// muesca, la bajada dura SYN_FALL_S y sigue plana hasta la caida al pie.
+
+#ifndef PPG_SYNTH_H
+#define PPG_SYNTH_H
+
+#include <math.h>
+
+typedef struct {
+    double t;                   // s desde el inicio
+    double ph;                  // fase del latido [0, 1), pico en 0.2
+    double rr;                  // s del latido en curso
+    double pi;                  // AC/DC del IR
+    double ratio;               // R = (AC/DC rojo) / (AC/DC IR)
+    double resp_hz;             // respiracion: frecuencia y modulacion del DC
+    double resp_dc;             // (fraccion del DC)
+    double resp_amp;            // y de la amplitud del pulso
+    double noise;               // rms en cuentas
+    int    finger;              // 0 = sin dedo (IR/rojo ~100 cuentas)
+    double rise;                // s pie -> pico (0 = pulso gaussiano)
+    double notch;               // s pico -> muesca (0 = sin muesca)
+} SYN_Ppg;
+
+#define SYN_NOTCH_LVL   0.45
+#define SYN_DIC_LVL     0.55
+#define SYN_DIC_S       0.08
+#define SYN_FALL_S      0.20            // bajada sin muesca
+
+static inline double SYN_Gauss(void)
+{
+    double a = TestRand() + 1e-12, b = TestRand();
+    return sqrt(-2.0 * log(a)) * cos(2.0 * M_PI * b);
+}
+
+static inline void SYN_Init(SYN_Ppg *g, double rr)
+{
+    memset(g, 0, sizeof(*g));
+    g->rr       = rr;
+    g->pi       = 0.02;
+    g->ratio    = 0.5;
+    g->resp_hz  = 0.25;
+    g->resp_dc  = 0.008;
+    g->noise    = 20.0;
+    g->finger   = 1;
+}
+
+// Pulso por tramos a t s del pico (-rise <= t < rr - rise), pie 0, pico 1
+static inline double SYN_Shape(const SYN_Ppg *g, double t)
+{
+    double foot  = g->rr - g->rise;
+    double fall  = (g->notch > 0.0) ? g->notch : SYN_FALL_S;
+    double dic   = (g->notch > 0.0) ? SYN_DIC_LVL : SYN_NOTCH_LVL;
+    double t_dic = fall + SYN_DIC_S;
+
+    if (t < 0.0) return 0.5 * (1.0 - cos(M_PI * (t + g->rise) / g->rise));
+    if (t < fall) {
+        return SYN_NOTCH_LVL + (1.0 - SYN_NOTCH_LVL) * 0.5 * (1.0 + cos(M_PI * t / fall));
+    }
+    if (t < t_dic) {
+        return SYN_NOTCH_LVL + (dic - SYN_NOTCH_LVL) * 0.5 * (1.0 - cos(M_PI * (t - fall) / SYN_DIC_S));
+    }
+    return dic * cos(0.5 * M_PI * (t - t_dic) / (foot - t_dic));
+}
+
+static inline int SYN_Next(SYN_Ppg *g, u32 *red, u32 *ir)
+{
+    double ph0 = g->ph;
+    g->t  += 1.0 / SAMPLE_RATE_HZ;
+    g->ph += 1.0 / (g->rr * SAMPLE_RATE_HZ);
+    if (g->ph >= 1.0) g->ph -= 1.0;
+    int peak = (ph0 < 0.2 && g->ph >= 0.2);
+
+    if (!g->finger) {
+        *ir = *red = 100;
+        return 0;
+    }
+
+    double pulse;
+    if (g->rise > 0.0) {
+        double t = (g->ph - 0.2) * g->rr;
+        if (t < -g->rise)              t += g->rr;  // diastole del latido anterior
+        else if (t >= g->rr - g->rise) t -= g->rr;  // subida del siguiente
+        pulse = SYN_Shape(g, t);
+    } else {
+        pulse = exp(-pow((g->ph - 0.2) / 0.08, 2))
+              + 0.35 * exp(-pow((g->ph - 0.5) / 0.07, 2));
+    }
+    double resp  = sin(2.0 * M_PI * g->resp_hz * g->t);
+    double amp   = 1.0 + g->resp_amp * resp;
+    double dc_ir = 100000.0 * (1.0 + g->resp_dc * resp);
+    double dc_rd =  80000.0 * (1.0 + g->resp_dc * resp);
+
+    *ir  = (u32)(dc_ir + g->pi * dc_ir * amp * pulse + g->noise * SYN_Gauss());
+    *red = (u32)(dc_rd + g->ratio * g->pi * dc_rd * amp * pulse + g->noise * SYN_Gauss());
+    return peak;
+}
+
+#endif
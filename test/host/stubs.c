@@ -0,0 +1,228 @@
+// Drivers Xilinx para correr el firmware en el host: el I2C acepta todo y
+// lee ceros, el GPIO no hace nada, xil_printf va a stdout y los sleep no
+// esperan. Alcanza para compilar src/main.c entero y llamar a sus modulos.
+// Lo que va a la direccion del OLED (0x3C) lo interpreta un modelo de la
+// RAM del SSD1306/SH1106 (stub_oled_*), para ver lo que mostraria el panel,
+// y la FIFO del MAX30102 (0x57) entrega stub_max_fifo muestras conocidas.
+
+#include "xparameters.h"
+#include "xil_types.h"
+#include "xiicps.h"
+#include "xgpio.h"
+#include "xil_printf.h"
+#include "sleep.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+// ---- Modelo del panel OLED ---- //
+//
+// RAM de 8 paginas x 132 columnas. Modo pagina (SH1106, y el SSD1306 tras
+// el reset): 0xB0+pag y columna con 0x0n/0x1n, la columna avanza sola. Con
+// 0x20 0x00 (SSD1306) pasa a horizontal: ventana 0x21/0x22 y al final de
+// cada fila de la ventana sigue en la pagina siguiente. 0x81 fija el
+// contraste, 0xA6/0xA7 invierte, 0xAE/0xAF apaga/enciende y 0x2F/0x2E
+// arranca/para el scroll; el resto de los comandos solo se saltea con sus
+// argumentos.
+
+u8  stub_oled_ram[8][132];
+int stub_oled_inverted;
+int stub_oled_on;
+int stub_oled_scrolling;
+int stub_oled_contrast;
+u32 stub_oled_bytes;                    // bytes I2C al panel (con el de control)
+
+static int oled_horizontal;
+static int oled_col, oled_page;
+static int oled_c0, oled_c1 = 131, oled_p0, oled_p1 = 7;
+
+static int OledCmdArgs(u8 c)
+{
+    switch (c) {
+    case 0x26: case 0x27:
+        return 6;
+    case 0x29: case 0x2A:
+        return 5;
+    case 0x21: case 0x22: case 0xA3:
+        return 2;
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xAD: case 0xD3:
+    case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void OledCommands(const u8 *b, int n)
+{
+    for (int i = 0; i < n; ) {
+        u8 c = b[i];
+        int na = OledCmdArgs(c);
+        const u8 *a = &b[i + 1];
+        if (i + 1 + na > n) return;
+
+        if (c == 0x20)                   oled_horizontal = (a[0] == 0x00);
+        else if (c == 0x21)              { oled_c0 = a[0]; oled_c1 = a[1]; oled_col = oled_c0; }
+        else if (c == 0x22)              { oled_p0 = a[0] & 7; oled_p1 = a[1] & 7; oled_page = oled_p0; }
+        else if (c == 0x81)              stub_oled_contrast = a[0];
+        else if (c == 0xA6 || c == 0xA7) stub_oled_inverted = (c == 0xA7);
+        else if (c == 0xAE || c == 0xAF) stub_oled_on = (c == 0xAF);
+        else if (c == 0x2E || c == 0x2F) stub_oled_scrolling = (c == 0x2F);
+        else if (c >= 0xB0 && c <= 0xB7) oled_page = c & 7;
+        else if (c <= 0x0F)              oled_col = (oled_col & 0xF0) | c;
+        else if (c >= 0x10 && c <= 0x1F) oled_col = (oled_col & 0x0F) | ((c & 0x0F) << 4);
+        i += 1 + na;
+    }
+}
+
+static void OledData(const u8 *b, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (oled_col < 132) stub_oled_ram[oled_page][oled_col] = b[i];
+
+        if (!oled_horizontal) {
+            if (oled_col < 131) oled_col++;
+        } else if (oled_col < oled_c1) {
+            oled_col++;
+        } else {
+            oled_col  = oled_c0;
+            oled_page = (oled_page < oled_p1) ? oled_page + 1 : oled_p0;
+        }
+    }
+}
+
+// ---- Modelo de la FIFO del MAX30102 ---- //
+//
+// 0x04..0x06 (punteros) dicen que hay stub_max_fifo muestras (32 = llena,
+// con OVF_COUNTER); leer FIFO_DATA (0x07) las consume en orden. La muestra
+// numero k del flujo es StubMaxRed(k) / StubMaxIr(k), con basura en los
+// bits 18..23 que el driver tiene que descartar.
+
+int stub_max_fifo;
+u32 stub_max_seq;                       // muestras entregadas desde el inicio
+u32 stub_max_bytes;                     // bytes en el bus, con el de direccion
+
+static u8 max_reg;
+
+u32 StubMaxRed(u32 k) { return (0x10000u + k * 37u) & 0x3FFFF; }
+u32 StubMaxIr(u32 k)  { return (0x20000u + k * 53u) & 0x3FFFF; }
+
+static void MaxRead(u8 *b, int n)
+{
+    memset(b, 0, (size_t)n);
+    if (max_reg == 0x04 && n >= 3) {
+        b[0] = (u8)(stub_max_fifo & 0x1F);      // FIFO_WR_PTR (RD_PTR = 0)
+        b[1] = (u8)(stub_max_fifo >= 32);       // OVF_COUNTER
+    } else if (max_reg == 0x07) {
+        for (int i = 0; i + 6 <= n && stub_max_fifo > 0; i += 6, stub_max_fifo--) {
+            u32 red = StubMaxRed(stub_max_seq) | 0xFC0000u;
+            u32 ir  = StubMaxIr(stub_max_seq)  | 0xFC0000u;
+            stub_max_seq++;
+            b[i + 0] = (u8)(red >> 16); b[i + 1] = (u8)(red >> 8); b[i + 2] = (u8)red;
+            b[i + 3] = (u8)(ir  >> 16); b[i + 4] = (u8)(ir  >> 8); b[i + 5] = (u8)ir;
+        }
+    }
+}
+
+s32 XIicPs_MasterSendPolled(XIicPs *InstancePtr, u8 *MsgPtr, s32 ByteCount, u16 SlaveAddr)
+{
+    (void)InstancePtr;
+    if (SlaveAddr == 0x3C && ByteCount > 0) {
+        stub_oled_bytes += (u32)ByteCount;
+        if (MsgPtr[0] == 0x40) OledData(&MsgPtr[1], ByteCount - 1);
+        else                   OledCommands(&MsgPtr[1], ByteCount - 1);
+    }
+    if (SlaveAddr == 0x57 && ByteCount > 0) {
+        max_reg = MsgPtr[0];
+        stub_max_bytes += 1u + (u32)ByteCount;
+    }
+    return XST_SUCCESS;
+}
+
+s32 XIicPs_MasterRecvPolled(XIicPs *InstancePtr, u8 *MsgPtr, s32 ByteCount, u16 SlaveAddr)
+{
+    (void)InstancePtr;
+    if (SlaveAddr == 0x57) {
+        MaxRead(MsgPtr, ByteCount);
+        stub_max_bytes += 1u + (u32)ByteCount;
+    } else {
+        memset(MsgPtr, 0, (size_t)ByteCount);
+    }
+    return XST_SUCCESS;
+}
+
+s32 XIicPs_BusIsBusy(XIicPs *InstancePtr)
+{
+    (void)InstancePtr;
+    return 0;
+}
+
+XIicPs_Config *XIicPs_LookupConfig(u16 DeviceId)
+{
+    static XIicPs_Config cfg;
+    (void)DeviceId;
+    return &cfg;
+}
+
+s32 XIicPs_CfgInitialize(XIicPs *InstancePtr, XIicPs_Config *ConfigPtr, u32 EffectiveAddr)
+{
+    (void)InstancePtr; (void)ConfigPtr; (void)EffectiveAddr;
+    return XST_SUCCESS;
+}
+
+void XIicPs_Reset(XIicPs *InstancePtr)
+{
+    (void)InstancePtr;
+}
+
+s32 XIicPs_SetSClk(XIicPs *InstancePtr, u32 FsclHz)
+{
+    (void)InstancePtr; (void)FsclHz;
+    return XST_SUCCESS;
+}
+
+s32 XIicPs_SetOptions(XIicPs *InstancePtr, u32 Options)
+{
+    (void)InstancePtr; (void)Options;
+    return XST_SUCCESS;
+}
+
+s32 XIicPs_ClearOptions(XIicPs *InstancePtr, u32 Options)
+{
+    (void)InstancePtr; (void)Options;
+    return XST_SUCCESS;
+}
+
+int XGpio_Initialize(XGpio *InstancePtr, u16 DeviceId)
+{
+    (void)InstancePtr; (void)DeviceId;
+    return XST_SUCCESS;
+}
+
+void XGpio_SetDataDirection(XGpio *InstancePtr, unsigned Channel, u32 DirectionMask)
+{
+    (void)InstancePtr; (void)Channel; (void)DirectionMask;
+}
+
+void XGpio_DiscreteWrite(XGpio *InstancePtr, unsigned Channel, u32 Mask)
+{
+    (void)InstancePtr; (void)Channel; (void)Mask;
+}
+
+void xil_printf(const char8 *ctrl1, ...)
+{
+    va_list args;
+    va_start(args, ctrl1);
+    vprintf(ctrl1, args);
+    va_end(args);
+}
+
+void usleep(unsigned long useconds)
+{
+    (void)useconds;
+}
+
+void sleep(unsigned int seconds)
+{
+    (void)seconds;
+}
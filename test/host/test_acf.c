@@ -0,0 +1,100 @@
+// Estimador por autocorrelacion: BPM contra el ritmo generado de 47 a
+// 139 BPM con perfusion normal y muy baja (donde el detector de picos
+// pierde latidos), confianza con pulso y con ruido solo, y r[k]
+// incremental contra la suma directa sobre la ventana.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+static PPG_Channel ch;
+
+// Un minuto a ritmo fijo desde un canal nuevo
+static void Run(double bpm, double pi, double noise)
+{
+    SYN_Ppg g;
+    SYN_Init(&g, 60.0 / bpm);
+    g.pi = pi;
+    g.noise = noise;
+    PPG_ChannelInit(&ch);
+
+    while (g.t < 60.0) {
+        u32 red, ir;
+        SYN_Next(&g, &red, &ir);
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+    }
+}
+
+static void TestSweep(double pi, double mae_max)
+{
+    double e_acf = 0.0, e_pk = 0.0, conf = 0.0;
+    int n = 0, ok = 0;
+
+    for (double bpm = 47.3; bpm < 140.0; bpm += 6.1) {
+        Run(bpm, pi, 20.0);
+        double a = HR_AcfBpm(&ch);
+        e_acf += fabs(a - bpm);
+        e_pk  += fabs(ch.bpm - bpm);
+        conf  += HR_AcfConfidence(&ch);
+        ok    += fabs(a - bpm) < 1.0;
+        n++;
+    }
+
+    printf("acf: PI %.1f%%: error medio ACF %.2f BPM (%d/%d a menos de 1), BPM mostrado %.2f, "
+           "confianza media %.2f\n", 100.0 * pi, e_acf / n, ok, n, e_pk / n, conf / n);
+    CHECK(e_acf / n < mae_max, "PI %.3f: error medio %.2f BPM", pi, e_acf / n);
+    CHECK(ok == n, "PI %.3f: %d de %d ritmos a mas de 1 BPM", pi, n - ok, n);
+    CHECK(conf / n > 0.5, "PI %.3f: confianza %.2f", pi, conf / n);
+}
+
+// Sin pulso (solo ruido) la confianza tiene que quedar baja
+static void TestNoise(void)
+{
+    Run(75.0, 0.0, 200.0);
+    printf("acf: ruido solo: %.1f BPM, confianza %.2f\n", HR_AcfBpm(&ch), HR_AcfConfidence(&ch));
+    CHECK(HR_AcfConfidence(&ch) < 0.3, "confianza %.2f sin pulso", HR_AcfConfidence(&ch));
+}
+
+// r[k] llevado muestra a muestra = suma directa de x[n] x[n-k] en la ventana
+static void TestExact(void)
+{
+    Run(83.0, 0.02, 20.0);
+    const HR_Acf *a = &ch.acf;
+    const int m = HR_ACF_RING - 1;
+    int bad = 0;
+
+    for (int k = 0; k < HR_ACF_NLAGS; k++) {
+        s64 s = 0;
+        for (int j = 0; j < HR_ACF_WIN; j++) {
+            int i = (a->head - 1 - j) & m;
+            s += (s64)a->x[i] * a->x[(i - k) & m];
+        }
+        bad += s != a->r[k];
+    }
+    CHECK(bad == 0, "%d lags de r[k] no coinciden con la suma directa", bad);
+}
+
+static void Bench(void)
+{
+    const int N = 2000000;
+    static HR_Acf a;
+    HR_AcfReset(&a);
+
+    double t0 = TestNowNs();
+    for (int i = 0; i < N; i++) {
+        HR_AcfPush(&a, (s32)(2000.0 * sin(i * 0.13)) * 256);
+    }
+    double t1 = TestNowNs();
+    printf("acf bench: HR_AcfPush %.1f ns por muestra (con el hop), HR_Acf %u B\n",
+           (t1 - t0) / N, (unsigned)sizeof(HR_Acf));
+}
+
+int main(int argc, char **argv)
+{
+    // A 25 Hz el lag tiene 40 ms de paso y la parabola deja ~0.15 BPM
+    TestSweep(0.02, 0.2);
+    TestSweep(0.002, 0.3);
+    TestNoise();
+    TestExact();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_acf");
+}
@@ -0,0 +1,196 @@
+// Tamizaje de FA: sensibilidad (latidos de FA con la ventana irregular) y
+// especificidad (latidos sinusales sin ella), primero con intervalos
+// directos a AF_Push y despues de punta a punta sobre PPG sintetico; los
+// episodios cerrados contra el tramo de FA.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+static PPG_Channel ch;
+
+// Intervalos (ms) del latido b: sinusal con arritmia respiratoria,
+// sinusal con 5 % de extrasistoles (latido corto y pausa compensadora),
+// sinusal con deriva lenta grande (ejercicio), bigeminismo (corto y largo
+// alternados: la tasa de puntos de giro tiende a 1) y FA (CV ~0.2, al azar)
+enum { RR_SINUS, RR_ECTOPIC, RR_DRIFT, RR_BIGEMINY, RR_AF };
+static const char *const rr_name[] = { "sinusal", "extrasistoles", "deriva", "bigeminismo", "FA" };
+
+static double NextRr(int kind, int b, double base)
+{
+    static int pend;
+    double r;
+
+    switch (kind) {
+    case RR_SINUS:
+        return base * (1.0 + 0.06 * sin(2.0 * M_PI * b / 4.5)) + 10.0 * SYN_Gauss();
+    case RR_ECTOPIC:
+        r = base * (1.0 + 0.04 * sin(2.0 * M_PI * b / 4.5)) + 10.0 * SYN_Gauss();
+        if (pend) { pend = 0; return r * 1.3; }
+        if (TestRand() < 0.05) { pend = 1; return r * 0.7; }
+        return r;
+    case RR_DRIFT:
+        return base * (1.0 + 0.15 * sin(2.0 * M_PI * b / 60.0) + 0.08 * sin(2.0 * M_PI * b / 4.0))
+             + 15.0 * SYN_Gauss();
+    case RR_BIGEMINY:
+        return base * ((b & 1) ? 1.25 : 0.75) + 15.0 * SYN_Gauss();
+    default:
+        r = base * (1.0 + 0.22 * SYN_Gauss());
+        return (r < 330.0) ? 330.0 : r;
+    }
+}
+
+// Cada ritmo solo, 3000 latidos a 75, 55 y 120 BPM (sin, con ventana llena)
+static void TestRhythms(void)
+{
+    for (int base = 500; base <= 1100; base += 300) {
+        for (int kind = RR_SINUS; kind <= RR_AF; kind++) {
+            PPG_ChannelInit(&ch);
+            u32 now = 0;
+            int n = 0, irr = 0;
+            for (int b = 0; b < 3000; b++) {
+                u32 rr = (u32)NextRr(kind, b, base);
+                now += rr;
+                AF_Push(&ch.af, rr, now, 1000, 1);
+                AF_Stats st;
+                AF_Get(&ch, &st);
+                if (st.n < AF_MIN_BEATS) continue;
+                n++;
+                irr += st.irregular;
+            }
+            int episodes = (int)ch.af.ep_seq + ch.af.active;
+            printf("af: %-13s RR %4d ms: irregulares %5.1f%%, episodios %d\n",
+                   rr_name[kind], base, 100.0 * irr / n, episodes);
+            if (kind == RR_AF) {
+                CHECK(irr >= n * 97 / 100, "FA %d ms: %d de %d irregulares", base, irr, n);
+            } else {
+                CHECK(irr <= n * 2 / 100, "%s %d ms: %d de %d irregulares",
+                      rr_name[kind], base, irr, n);
+                CHECK(episodes == 0, "%s %d ms: %d episodios", rr_name[kind], base, episodes);
+            }
+        }
+    }
+}
+
+// Sinusal -> FA -> sinusal con un latido malo en medio de la FA, 20
+// veces con otra semilla: un solo episodio por corrida. Los bordes se
+// fechan en la mitad de la ventana; el error esperado es de unos pocos
+// latidos y el peor caso media ventana.
+static void TestEpisode(void)
+{
+    int worst_on = 0, worst_off = 0;
+    double sum_on = 0.0, sum_off = 0.0;
+    const int runs = 20;
+
+    for (int run = 0; run < runs; run++) {
+        PPG_ChannelInit(&ch);
+        u32 now = 0, t_on = 0, t_off = 0;
+        for (int b = 0; b < 1500; b++) {
+            int af = b >= 400 && b < 900;
+            u32 rr = (u32)NextRr(af ? RR_AF : RR_SINUS, b, 800);
+            now += rr;
+            if (b == 400) t_on = now;
+            if (b == 899) t_off = now;
+            AF_Push(&ch.af, rr, now, 1000, b != 600);
+        }
+
+        AF_Episode ep[AF_EPISODES];
+        u32 seq = 0;
+        int k = AF_ReadEpisodes(&ch, &seq, ep, AF_EPISODES);
+        CHECK(k == 1 && !ch.af.active, "corrida %d: %d episodios%s", run, k,
+              ch.af.active ? " y uno abierto" : "");
+        if (k < 1) continue;
+
+        int d_on = (int)(ep[0].start_ms - t_on), d_off = (int)(ep[0].end_ms - t_off);
+        sum_on  += abs(d_on);
+        sum_off += abs(d_off);
+        if (abs(d_on)  > abs(worst_on))  worst_on  = d_on;
+        if (abs(d_off) > abs(worst_off)) worst_off = d_off;
+    }
+
+    printf("af: bordes del episodio en %d corridas: inicio %.1f s medio (peor %+.1f s), "
+           "fin %.1f s medio (peor %+.1f s)\n", runs, sum_on / runs / 1000.0,
+           worst_on / 1000.0, sum_off / runs / 1000.0, worst_off / 1000.0);
+    CHECK(sum_on / runs < 10000.0 && sum_off / runs < 10000.0, "error medio de los bordes");
+    CHECK(abs(worst_on) < AF_WIN / 2 * 800 && abs(worst_off) < AF_WIN / 2 * 800,
+          "borde a mas de media ventana");
+}
+
+// PPG de punta a punta: sinusal 0..300 s, FA 300..700 s, sinusal hasta
+// 1000 s. Un latido cuenta cuando la ventana ya no mezcla ritmos.
+static void TestPpg(double pi)
+{
+    const double af0 = 300.0, af1 = 700.0, t_end = 1000.0;
+    SYN_Ppg g;
+    SYN_Init(&g, 0.85);
+    g.pi = pi;
+    PPG_ChannelInit(&ch);
+
+    int n_sr = 0, irr_sr = 0, n_af = 0, irr_af = 0;
+    while (g.t < t_end) {
+        u32 red, ir;
+        if (SYN_Next(&g, &red, &ir)) {
+            int af = g.t > af0 && g.t < af1;
+            g.rr = af ? 0.75 * (1.0 + 0.2 * SYN_Gauss())
+                      : 0.85 + 0.05 * sin(2.0 * M_PI * g.t / 4.0) + 0.02 * SYN_Gauss();
+            if (g.rr < 0.35) g.rr = 0.35;
+
+            AF_Stats st;
+            AF_Get(&ch, &st);
+            if (st.n >= AF_MIN_BEATS && g.t > 80.0) {
+                if (g.t > af0 + 40.0 && g.t < af1) {
+                    n_af++;
+                    irr_af += st.irregular;
+                } else if (g.t < af0 || g.t > af1 + 60.0) {
+                    n_sr++;
+                    irr_sr += st.irregular;
+                }
+            }
+        }
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+    }
+
+    AF_Episode ep[AF_EPISODES];
+    u32 seq = 0;
+    int k = AF_ReadEpisodes(&ch, &seq, ep, AF_EPISODES);
+    printf("af: PPG %d Hz PI %.1f%%: irregulares sinusal %.1f%% FA %.1f%%, %d episodio(s)",
+           SAMPLE_RATE_HZ, 100.0 * pi, 100.0 * irr_sr / n_sr, 100.0 * irr_af / n_af, k);
+    for (int j = 0; j < k; j++) printf(" %.1f..%.1f s", ep[j].start_ms / 1000.0, ep[j].end_ms / 1000.0);
+    printf("\n");
+
+    CHECK(irr_sr == 0, "PI %.3f: %d de %d latidos sinusales irregulares", pi, irr_sr, n_sr);
+    CHECK(irr_af >= n_af * 95 / 100, "PI %.3f: %d de %d latidos de FA", pi, irr_af, n_af);
+    CHECK(k == 1 && !ch.af.active, "PI %.3f: %d episodios", pi, k);
+    if (k == 1) {
+        CHECK(ep[0].start_ms < (af0 + 20.0) * 1000.0 && ep[0].end_ms > (af1 - 20.0) * 1000.0 &&
+              ep[0].start_ms > (af0 - 30.0) * 1000.0 && ep[0].end_ms < (af1 + 30.0) * 1000.0,
+              "PI %.3f: el episodio no cubre la FA", pi);
+    }
+}
+
+static void Bench(void)
+{
+    const int N = 2000000;
+    static u32 rr[4096];
+    for (int i = 0; i < 4096; i++) rr[i] = (u32)NextRr(RR_AF, i, 750);
+
+    PPG_ChannelInit(&ch);
+    u32 t = 0;
+    double t0 = TestNowNs();
+    for (int i = 0; i < N; i++) {
+        t += rr[i & 4095];
+        AF_Push(&ch.af, rr[i & 4095], t, 1000, 1);
+    }
+    double t1 = TestNowNs();
+    printf("af bench: %.1f ns por latido, AF_State %u B\n",
+           (t1 - t0) / N, (unsigned)sizeof(AF_State));
+}
+
+int main(int argc, char **argv)
+{
+    TestRhythms();
+    TestEpisode();
+    TestPpg(0.02);
+    TestPpg(0.01);
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_af");
+}
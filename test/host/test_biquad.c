@@ -0,0 +1,159 @@
+// Pasabanda: la cascada del firmware (float o Q30 segun HR_FIXED_POINT)
+// contra la misma cascada en double con los coeficientes float, y con
+// -D__ARM_NEON (neon/arm_neon.h) el camino NEON contra la referencia
+// escalar, que tiene que dar igual bit a bit, salidas y estado.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+#define NSAMP   (200 * SAMPLE_RATE_HZ)
+
+#if HR_FIXED_POINT
+typedef s32 Sample;
+typedef BQ_SectionQ Section;
+#define TO_UNITS    (1.0 / 256.0)           // Q8 -> cuentas
+#else
+typedef float Sample;
+typedef BQ_SectionF Section;
+#define TO_UNITS    1.0
+#endif
+
+static Sample in[NSAMP][BQ_LANES];
+static Sample out_ref[NSAMP][BQ_LANES];
+static Sample out_neon[NSAMP][BQ_LANES];
+static double out_dbl[NSAMP][BQ_LANES];
+
+static void Prime(Section *sec, const Sample *x0)
+{
+    static PPG_Channel ch;
+    PPG_ChannelInit(&ch);
+    for (int l = 0; l < BQ_LANES; l++) {
+        BQ_PrimeLane(&ch, l, (float)x0[l] * (float)TO_UNITS);
+    }
+    memcpy(sec, ch.bq, sizeof(ch.bq));
+}
+
+// Cascada en double desde el mismo arranque en regimen permanente
+static void RunDouble(void)
+{
+    double x1[BQ_SECTIONS][BQ_LANES], x2[BQ_SECTIONS][BQ_LANES];
+    double y1[BQ_SECTIONS][BQ_LANES], y2[BQ_SECTIONS][BQ_LANES];
+
+    for (int l = 0; l < BQ_LANES; l++) {
+        double u = in[0][l] * TO_UNITS;
+        for (int k = 0; k < BQ_SECTIONS; k++) {
+            const BQ_CoefF *c = &BQ_COEF_F[k];
+            double y = u * ((double)c->b0 + c->b1 + c->b2) / (1.0 + c->a1 + c->a2);
+            x1[k][l] = x2[k][l] = u;
+            y1[k][l] = y2[k][l] = y;
+            u = y;
+        }
+    }
+
+    for (int i = 0; i < NSAMP; i++) {
+        for (int l = 0; l < BQ_LANES; l++) {
+            double x = in[i][l] * TO_UNITS;
+            for (int k = 0; k < BQ_SECTIONS; k++) {
+                const BQ_CoefF *c = &BQ_COEF_F[k];
+                double y = c->b0 * x + c->b1 * x1[k][l] + c->b2 * x2[k][l]
+                         - c->a1 * y1[k][l] - c->a2 * y2[k][l];
+                x2[k][l] = x1[k][l];  x1[k][l] = x;
+                y2[k][l] = y1[k][l];  y1[k][l] = y;
+                x = y;
+            }
+            out_dbl[i][l] = x;
+        }
+    }
+}
+
+// Bloques de 1..PPG_BLOCK_MAX muestras, como llegan de la FIFO
+static void RunBlocks(void (*fn)(Section *, const Sample (*)[BQ_LANES],
+                                 Sample (*)[BQ_LANES], int),
+                      Sample (*out)[BQ_LANES], Section *sec_end)
+{
+    Section sec[BQ_SECTIONS];
+    Prime(sec, in[0]);
+
+    unsigned seed = test_seed;
+    for (int i = 0; i < NSAMP; ) {
+        int n = 1 + (int)(TestRand() * PPG_BLOCK_MAX);
+        if (n > NSAMP - i) n = NSAMP - i;
+        fn(sec, &in[i], &out[i], n);
+        i += n;
+    }
+    test_seed = seed;
+    memcpy(sec_end, sec, sizeof(sec));
+}
+
+#if HR_FIXED_POINT
+#define REF_FN      BQ_ProcessQ
+#define NEON_FN     BQ_ProcessNeonQ
+#else
+#define REF_FN      BQ_ProcessRefF
+#define NEON_FN     BQ_ProcessNeonF
+#endif
+
+int main(int argc, char **argv)
+{
+    SYN_Ppg g;
+    SYN_Init(&g, 0.8);
+    g.noise = 50.0;
+    for (int i = 0; i < NSAMP; i++) {
+        u32 red, ir;
+        if (SYN_Next(&g, &red, &ir)) g.rr = 0.8 + 0.05 * SYN_Gauss();
+        // Un escalon grande a mitad de camino (dedo que se mueve)
+        if (i > NSAMP / 2) { red += 20000; ir += 30000; }
+#if HR_FIXED_POINT
+        in[i][BQ_LANE_RED] = (s32)(red << 8);
+        in[i][BQ_LANE_IR]  = (s32)(ir  << 8);
+#else
+        in[i][BQ_LANE_RED] = (float)red;
+        in[i][BQ_LANE_IR]  = (float)ir;
+#endif
+    }
+
+    Section sec_ref[BQ_SECTIONS];
+    RunBlocks(REF_FN, out_ref, sec_ref);
+    RunDouble();
+
+    // Error contra double, en cuentas del ADC, y el AC tipico como escala
+    double err = 0.0, ac = 0.0;
+    for (int i = SAMPLE_RATE_HZ; i < NSAMP; i++) {
+        for (int l = 0; l < BQ_LANES; l++) {
+            double e = fabs(out_ref[i][l] * TO_UNITS - out_dbl[i][l]);
+            if (e > err) err = e;
+            if (fabs(out_dbl[i][l]) > ac) ac = fabs(out_dbl[i][l]);
+        }
+    }
+    printf("biquad %s %d Hz: error max contra double %.4f cuentas (pico AC %.0f)\n",
+           HR_FIXED_POINT ? "Q30" : "float", SAMPLE_RATE_HZ, err, ac);
+    // Q8 trunca a 1/256 de cuenta y el Q30 redondea los coeficientes;
+    // float pierde ~1e-7 relativo del DC (~1e5) en cada seccion
+    CHECK(err < (HR_FIXED_POINT ? 0.5 : 0.1), "error %.4f cuentas", err);
+
+#if defined(__ARM_NEON)
+    Section sec_neon[BQ_SECTIONS];
+    RunBlocks(NEON_FN, out_neon, sec_neon);
+    CHECK(memcmp(out_ref, out_neon, sizeof(out_ref)) == 0, "NEON no da igual que la referencia");
+    CHECK(memcmp(sec_ref, sec_neon, sizeof(sec_ref)) == 0, "estado NEON distinto de la referencia");
+    printf("biquad: NEON igual bit a bit a la referencia escalar (%d muestras)\n", NSAMP);
+#else
+    (void)out_neon;
+#endif
+
+    if (TestBenchMode(argc, argv)) {
+        Section sec[BQ_SECTIONS];
+        Prime(sec, in[0]);
+        double t0 = TestNowNs();
+        for (int r = 0; r < 20; r++) {
+            for (int i = 0; i + PPG_BLOCK_MAX <= NSAMP; i += PPG_BLOCK_MAX) {
+                REF_FN(sec, &in[i], &out_ref[i], PPG_BLOCK_MAX);
+            }
+        }
+        double t1 = TestNowNs();
+        printf("biquad bench: escalar %.1f ns por muestra (2 lanes, 2 secciones)\n",
+               (t1 - t0) / (20.0 * NSAMP));
+    }
+
+    return TestDone("test_biquad");
+}
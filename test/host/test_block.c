@@ -0,0 +1,150 @@
+// Camino por bloques: Max30102_ReadFifo contra el modelo de FIFO de
+// stubs.c (cuentas, FIFO llena, max menor que lo que hay y los 18 bits
+// utiles) y PPG_ChannelProcess con bloques de 1, 8 y 32 muestras, que
+// tiene que dar las mismas lecturas que el camino por muestra
+// (HR_ProcessSample / SPO2_Update) sobre la misma senal. En bench, ns por
+// muestra de la lectura de FIFO (y el tiempo de bus I2C que costaria en la
+// placa) y del procesamiento en cada tamano.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+#define SECS    40
+
+static PPG_Channel ch;
+static u32 sig_red[SECS * SAMPLE_RATE_HZ], sig_ir[SECS * SAMPLE_RATE_HZ];
+
+static void TestReadFifo(void)
+{
+    static const struct { int avail, max, want; } cases[] = {
+        { 0, 32, 0 }, { 1, 32, 1 }, { 8, 32, 8 }, { 31, 32, 31 },
+        { 32, 32, 32 }, { 20, 8, 8 },
+    };
+    for (u32 c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        u32 red[PPG_BLOCK_MAX], ir[PPG_BLOCK_MAX];
+        u32 first = stub_max_seq;
+        int n = -1;
+        stub_max_fifo = cases[c].avail;
+        int st = Max30102_ReadFifo(red, ir, cases[c].max, &n);
+        CHECK(st == XST_SUCCESS && n == cases[c].want, "ReadFifo %d en la FIFO, max %d: %d muestras",
+              cases[c].avail, cases[c].max, n);
+
+        int bad = 0;
+        for (int i = 0; i < n; i++) {
+            bad += red[i] != StubMaxRed(first + (u32)i) || ir[i] != StubMaxIr(first + (u32)i);
+        }
+        CHECK(bad == 0, "ReadFifo %d muestras: %d distintas", n, bad);
+    }
+    stub_max_fifo = 0;
+}
+
+// Lecturas de ch cada 32 muestras (donde terminan bloques de los tres
+// tamanos); n = tamano de bloque (0 = por muestra)
+#define N_READ  (SECS * SAMPLE_RATE_HZ / 32)
+
+static void Run(int n, float *bpm, float *spo2)
+{
+    const int total = N_READ * 32;
+    PPG_ChannelInit(&ch);
+    for (int i = 0; i < total; ) {
+        int k = n ? n : 1;
+        if (n) {
+            PPG_ChannelProcess(&ch, &sig_red[i], &sig_ir[i], NULL, k, NULL, 0);
+        } else {
+            float b, s;
+            PPG_FrontEndBlock(&ch, &sig_red[i], &sig_ir[i], 1);
+            SQI_UpdateBlock(&ch, &sig_red[i], &sig_ir[i], 1);
+            HR_ProcessSample(&ch, sig_ir[i], &b);
+            SPO2_Update(&ch, sig_red[i], sig_ir[i], &s);
+        }
+        i += k;
+        if (i % 32 == 0) {
+            bpm[i / 32 - 1]  = ch.bpm;
+            spo2[i / 32 - 1] = ch.spo2;
+        }
+    }
+}
+
+static void TestSizes(void)
+{
+    static const int sizes[] = { 1, 8, 32 };
+    float bpm0[N_READ], spo20[N_READ], bpm[N_READ], spo2[N_READ];
+
+    Run(0, bpm0, spo20);
+    CHECK(fabs(bpm0[N_READ - 1] - 75.0f) < 1.0f, "por muestra: %.1f BPM", bpm0[N_READ - 1]);
+
+    for (int s = 0; s < 3; s++) {
+        Run(sizes[s], bpm, spo2);
+        int diff = 0;
+        for (int k = 0; k < N_READ; k++) diff += bpm[k] != bpm0[k] || spo2[k] != spo20[k];
+        printf("block %2d: %.1f BPM, SpO2 %.1f %%, %d de %d lecturas distintas del camino por muestra\n",
+               sizes[s], bpm[N_READ - 1], spo2[N_READ - 1], diff, N_READ);
+        CHECK(diff == 0, "bloques de %d: %d de %d lecturas distintas", sizes[s], diff, N_READ);
+    }
+}
+
+static void Bench(void)
+{
+    static const int sizes[] = { 1, 8, 32 };
+    const int total = SECS * SAMPLE_RATE_HZ, REPS = 20;
+    volatile u32 sink = 0;
+
+    for (int s = 0; s < 3; s++) {
+        int n = sizes[s];
+        u32 red[PPG_BLOCK_MAX], ir[PPG_BLOCK_MAX];
+        int got;
+
+        u32 bytes0 = stub_max_bytes;
+        double t0 = TestNowNs();
+        for (int r = 0; r < REPS * total / n; r++) {
+            stub_max_fifo = n;
+            Max30102_ReadFifo(red, ir, PPG_BLOCK_MAX, &got);
+            sink += ir[got - 1];
+        }
+        double fifo = (TestNowNs() - t0) / ((double)REPS * total);
+        // En la placa manda el bus: 9 bits por byte a 400 kHz, mas start,
+        // repeated start y stop (~1 byte por transaccion, ya contado)
+        double bus = (stub_max_bytes - bytes0) * 9.0 / 400e3 * 1e6 / ((double)REPS * total / n * n);
+
+        t0 = TestNowNs();
+        for (int r = 0; r < REPS; r++) {
+            PPG_ChannelInit(&ch);
+            for (int i = 0; i + n <= total; i += n) {
+                PPG_ChannelProcess(&ch, &sig_red[i], &sig_ir[i], NULL, n, NULL, 0);
+            }
+        }
+        double proc = (TestNowNs() - t0) / ((double)REPS * (total / n * n));
+
+        printf("block bench: bloques de %2d: ReadFifo %6.1f ns por muestra (bus I2C %5.1f us), "
+               "PPG_ChannelProcess %6.1f ns por muestra\n", n, fifo, bus, proc);
+    }
+
+    // Camino por muestra con las funciones viejas (una llamada por etapa)
+    double t0 = TestNowNs();
+    for (int r = 0; r < REPS; r++) {
+        PPG_ChannelInit(&ch);
+        for (int i = 0; i < total; i++) {
+            float b, s;
+            PPG_FrontEndBlock(&ch, &sig_red[i], &sig_ir[i], 1);
+            SQI_UpdateBlock(&ch, &sig_red[i], &sig_ir[i], 1);
+            HR_ProcessSample(&ch, sig_ir[i], &b);
+            SPO2_Update(&ch, sig_red[i], sig_ir[i], &s);
+        }
+    }
+    printf("block bench: HR_ProcessSample + SPO2_Update %6.1f ns por muestra\n",
+           (TestNowNs() - t0) / ((double)REPS * total));
+    stub_max_fifo = 0;
+    (void)sink;
+}
+
+int main(int argc, char **argv)
+{
+    SYN_Ppg g;
+    SYN_Init(&g, 0.8);
+    for (int i = 0; i < SECS * SAMPLE_RATE_HZ; i++) SYN_Next(&g, &sig_red[i], &sig_ir[i]);
+
+    TestReadFifo();
+    TestSizes();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_block");
+}
@@ -0,0 +1,119 @@
+// 64 canales independientes procesados uno tras otro, en bloques de FIFO,
+// cada uno con su propio ritmo entre 50 y 145 BPM: todos tienen que seguir
+// el suyo, y un canal repetido solo con la misma entrada tiene que dar
+// exactamente lo mismo que entre los otros 63 (no hay estado compartido).
+// En bench, ns por segundo de senal de un canal y cuantos canales entran
+// en un nucleo a tiempo real.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+#define N_CH        64
+#define BLOCK       8               // rafaga de FIFO tipica
+#define SECS        60
+#define WITNESS     17              // canal que se repite solo
+
+static PPG_Channel chs[N_CH];
+static PPG_Channel alone;
+
+static u32 w_red[SECS * SAMPLE_RATE_HZ], w_ir[SECS * SAMPLE_RATE_HZ];
+static float w_bpm[SECS], w_spo2[SECS];
+
+static double Target(int c)
+{
+    return 50.0 + 95.0 * c / (N_CH - 1);
+}
+
+static void TestChannels(void)
+{
+    static SYN_Ppg g[N_CH];
+    double err[N_CH] = { 0 };
+    int n_err = 0;
+
+    for (int c = 0; c < N_CH; c++) {
+        SYN_Init(&g[c], 60.0 / Target(c));
+        PPG_ChannelInit(&chs[c]);
+    }
+
+    const int total = SECS * SAMPLE_RATE_HZ;
+    for (int i = 0; i < total; i += BLOCK) {
+        for (int c = 0; c < N_CH; c++) {
+            u32 red[BLOCK], ir[BLOCK];
+            for (int k = 0; k < BLOCK; k++) SYN_Next(&g[c], &red[k], &ir[k]);
+            PPG_ChannelProcess(&chs[c], red, ir, NULL, BLOCK, NULL, 0);
+            if (c == WITNESS) {
+                memcpy(&w_red[i], red, sizeof(red));
+                memcpy(&w_ir[i],  ir,  sizeof(ir));
+            }
+        }
+
+        // Una lectura por segundo, despues del enganche
+        int s = (i + BLOCK) / SAMPLE_RATE_HZ;
+        if ((i + BLOCK) % SAMPLE_RATE_HZ < BLOCK && s > 0 && s <= SECS) {
+            w_bpm[s - 1]  = chs[WITNESS].bpm;
+            w_spo2[s - 1] = chs[WITNESS].spo2;
+            if (s > 20) {
+                for (int c = 0; c < N_CH; c++) err[c] += fabs(chs[c].bpm - Target(c));
+                n_err++;
+            }
+        }
+    }
+
+    double worst = 0.0;
+    int worst_c = 0;
+    for (int c = 0; c < N_CH; c++) {
+        err[c] /= n_err;
+        if (err[c] > worst) { worst = err[c]; worst_c = c; }
+        CHECK(err[c] <= 1.0, "canal %d (%.1f BPM): error medio %.2f BPM", c, Target(c), err[c]);
+    }
+    printf("channels: %d canales de %.0f a %.0f BPM, peor error medio %.2f BPM (canal %d, %.1f BPM), "
+           "%u bytes por canal\n", N_CH, Target(0), Target(N_CH - 1), worst, worst_c,
+           Target(worst_c), (unsigned)sizeof(PPG_Channel));
+
+    // El testigo, solo y con la misma entrada
+    PPG_ChannelInit(&alone);
+    int diff = 0;
+    for (int i = 0; i < total; i += BLOCK) {
+        PPG_ChannelProcess(&alone, &w_red[i], &w_ir[i], NULL, BLOCK, NULL, 0);
+        int s = (i + BLOCK) / SAMPLE_RATE_HZ;
+        if ((i + BLOCK) % SAMPLE_RATE_HZ < BLOCK && s > 0 && s <= SECS) {
+            diff += alone.bpm != w_bpm[s - 1] || alone.spo2 != w_spo2[s - 1];
+        }
+    }
+    CHECK(diff == 0, "canal %d solo: %d lecturas distintas de las de entre %d canales", WITNESS, diff, N_CH);
+}
+
+// Entrada precalculada (10 s por canal) y procesada en el orden del
+// firmware: un bloque por canal, todos los canales, siguiente bloque
+static void Bench(void)
+{
+    enum { B_SECS = 10, B_N = B_SECS * SAMPLE_RATE_HZ, REPS = 10 };
+    static u32 red[N_CH][B_N], ir[N_CH][B_N];
+
+    for (int c = 0; c < N_CH; c++) {
+        SYN_Ppg g;
+        SYN_Init(&g, 60.0 / Target(c));
+        for (int i = 0; i < B_N; i++) SYN_Next(&g, &red[c][i], &ir[c][i]);
+        PPG_ChannelInit(&chs[c]);
+    }
+
+    double t0 = TestNowNs();
+    for (int r = 0; r < REPS; r++) {
+        for (int i = 0; i + BLOCK <= B_N; i += BLOCK) {
+            for (int c = 0; c < N_CH; c++) {
+                PPG_ChannelProcess(&chs[c], &red[c][i], &ir[c][i], NULL, BLOCK, NULL, 0);
+            }
+        }
+    }
+    double secs = (double)(B_N / BLOCK * BLOCK) / SAMPLE_RATE_HZ;
+    double ns   = (TestNowNs() - t0) / (N_CH * secs * REPS);
+    printf("channels bench: %.0f ns por segundo de senal de un canal (%d Hz, bloques de %d), "
+           "%.0f canales por nucleo a tiempo real (host)\n", ns, SAMPLE_RATE_HZ, BLOCK, 1e9 / ns);
+}
+
+int main(int argc, char **argv)
+{
+    TestChannels();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_channels");
+}
@@ -0,0 +1,64 @@
+// Camino de punto fijo contra el float sobre las mismas muestras: el
+// firmware float (harness.h) y una segunda copia con HR_FIXED_POINT=1
+// (fixedpoint_run.c) procesan el mismo PPG sintetico, 50/72/120 BPM con
+// tres R, y se compara el BPM y la SpO2 de los dos en cada muestra, y los
+// dos contra el ritmo y la curva de SpO2.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+#if HR_FIXED_POINT
+#error "test_fixedpoint es la copia float; la de punto fijo es fixedpoint_run.c"
+#endif
+
+#define NSAMP   (60 * SAMPLE_RATE_HZ)
+
+void FixedRun(const u32 *red, const u32 *ir, int n, float *bpm, float *spo2);
+
+static PPG_Channel ch;
+static u32 red[NSAMP], ir[NSAMP];
+static float bpm_x[NSAMP], spo2_x[NSAMP];
+
+int main(int argc, char **argv)
+{
+    static const double rates[] = { 50.0, 72.0, 120.0 };
+    static const double ratios[] = { 0.5, 0.7, 0.9 };
+    double d_bpm = 0.0, d_spo2 = 0.0, d_bpm_end = 0.0, d_spo2_end = 0.0;
+    double e_bpm = 0.0, e_spo2 = 0.0;
+    (void)argc; (void)argv;
+
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 3; b++) {
+            SYN_Ppg g;
+            SYN_Init(&g, 60.0 / rates[a]);
+            g.ratio = ratios[b];
+            for (int i = 0; i < NSAMP; i++) SYN_Next(&g, &red[i], &ir[i]);
+
+            FixedRun(red, ir, NSAMP, bpm_x, spo2_x);
+            PPG_ChannelInit(&ch);
+            for (int i = 0; i < NSAMP; i++) {
+                PPG_ChannelProcess(&ch, &red[i], &ir[i], NULL, 1, NULL, 0);
+                if (i < 10 * SAMPLE_RATE_HZ) continue;
+                double db = fabs(ch.bpm - bpm_x[i]), ds = fabs(ch.spo2 - spo2_x[i]);
+                if (db > d_bpm)  d_bpm  = db;
+                if (ds > d_spo2) d_spo2 = ds;
+            }
+
+            double r = ratios[b];
+            double curve = -45.060 * r * r + 30.354 * r + 94.845;
+            double db = fabs(ch.bpm - bpm_x[NSAMP - 1]), ds = fabs(ch.spo2 - spo2_x[NSAMP - 1]);
+            if (db > d_bpm_end)  d_bpm_end  = db;
+            if (ds > d_spo2_end) d_spo2_end = ds;
+            if (fabs(bpm_x[NSAMP - 1] - rates[a]) > e_bpm)   e_bpm  = fabs(bpm_x[NSAMP - 1] - rates[a]);
+            if (fabs(spo2_x[NSAMP - 1] - curve) > e_spo2)    e_spo2 = fabs(spo2_x[NSAMP - 1] - curve);
+        }
+    }
+
+    printf("fixedpoint: punto fijo - float al final: %.4f BPM, %.4f%% SpO2; "
+           "maximo desde 10 s: %.4f BPM, %.4f%% SpO2\n", d_bpm_end, d_spo2_end, d_bpm, d_spo2);
+    printf("fixedpoint: punto fijo contra lo generado: %.3f BPM, %.3f%% SpO2\n", e_bpm, e_spo2);
+    CHECK(d_bpm_end < 0.01 && d_spo2_end < 0.01, "al final: %.4f BPM, %.4f%%", d_bpm_end, d_spo2_end);
+    CHECK(d_bpm < 0.05 && d_spo2 < 0.1, "desde 10 s: %.4f BPM, %.4f%%", d_bpm, d_spo2);
+    CHECK(e_bpm < 0.5 && e_spo2 < 1.0, "contra lo generado: %.3f BPM, %.3f%%", e_bpm, e_spo2);
+    return TestDone("test_fixedpoint");
+}
@@ -0,0 +1,167 @@
+// Formateo sin snprintf (FMT_Int, FMT_Fixed, FMT_Q) contra snprintf sobre
+// valores de borde: 0, negativos, INT_MIN/INT_MAX, acarreo del redondeo
+// (9.995 -> 10.00), anchos menores y mayores que el numero, y valores al
+// azar. En bench, ns por llamada contra snprintf; el tamano de codigo lo
+// imprime "make bench" (fmt-size).
+//
+// Dos diferencias a proposito con printf en FMT_Q: los empates redondean
+// lejos de cero (printf al par sobre el valor binario exacto) y un negativo
+// que redondea a cero se escribe sin signo ("0.0", no "-0.0").
+
+#include "harness.h"
+#include <limits.h>
+
+static int n_checked;
+
+static void Same(const char *got, const char *want, const char *what)
+{
+    n_checked++;
+    CHECK(strcmp(got, want) == 0, "%s: \"%s\", snprintf \"%s\"", what, got, want);
+}
+
+static void CheckInt(s32 v, int width)
+{
+    char got[32], want[32], what[64];
+    char *end = FMT_Int(got, v, width);
+    snprintf(want, sizeof(want), "%*d", width, (int)v);
+    snprintf(what, sizeof(what), "FMT_Int(%d, %d)", (int)v, width);
+    Same(got, want, what);
+    CHECK(end == got + strlen(got), "%s: puntero de fin", what);
+}
+
+static void CheckFixed(s32 v, int decimals, int width)
+{
+    char got[32], want[32], what[64];
+    char *end = FMT_Fixed(got, v, decimals, width);
+    // v / 10^d en double esta a mucho menos de media unidad del ultimo
+    // decimal: %.*f da exactamente los digitos de v
+    snprintf(want, sizeof(want), "%*.*f", width, decimals, (double)v / FMT_POW10[decimals]);
+    snprintf(what, sizeof(what), "FMT_Fixed(%d, %d, %d)", (int)v, decimals, width);
+    Same(got, want, what);
+    CHECK(end == got + strlen(got), "%s: puntero de fin", what);
+}
+
+static void CheckQ(s32 q, int frac_bits, int decimals, int width)
+{
+    char got[32], want[32], what[64];
+    double x = ldexp((double)q, -frac_bits);        // exacto
+
+    // Empate exacto en el ultimo decimal: comparar con el vecino hacia afuera
+    s64 scaled = ((s64)(q < 0 ? -(s64)q : q)) * FMT_POW10[decimals];
+    if (frac_bits > 0 && (scaled & (((s64)1 << frac_bits) - 1)) == ((s64)1 << (frac_bits - 1))) {
+        x = nextafter(x, (q < 0) ? -INFINITY : INFINITY);
+    }
+    snprintf(want, sizeof(want), "%*.*f", width, decimals, x);
+
+    // "-0.00" -> " 0.00" (mismo ancho)
+    char *m = strchr(want, '-');
+    if (m && strspn(m + 1, "0.") == strlen(m + 1)) {
+        memmove(m, m + 1, strlen(m));
+        if ((int)strlen(want) < width) {
+            memmove(want + 1, want, strlen(want) + 1);
+            want[0] = ' ';
+        }
+    }
+
+    FMT_Q(got, q, frac_bits, decimals, width);
+    snprintf(what, sizeof(what), "FMT_Q(%d, Q%d, %d, %d)", (int)q, frac_bits, decimals, width);
+    Same(got, want, what);
+}
+
+static void TestEdges(void)
+{
+    static const s32 ints[] = {
+        0, 1, -1, 9, 10, -10, 99, 100, 12345, -12345, 999999999, -999999999,
+        INT_MAX, INT_MIN, INT_MIN + 1,
+    };
+    for (u32 i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        for (int w = 0; w <= 13; w++) {
+            CheckInt(ints[i], w);
+            for (int d = 0; d <= FMT_MAX_DECIMALS; d++) CheckFixed(ints[i], d, w);
+        }
+    }
+
+    // Fijos con la parte entera en cero y negativos chicos: "-0.5", "0.05"
+    for (s32 v = -120; v <= 120; v++) {
+        for (int d = 1; d <= 3; d++) CheckFixed(v, d, 6);
+    }
+
+    // Q: acarreo del redondeo (9.995 -> 10.00, 0.96 -> 1.0, 99.95 -> 100.0),
+    // empates, negativos que redondean a cero y los extremos de s32
+    static const struct { double x; int f, d; } qs[] = {
+        { 9.995, 16, 2 }, { -9.995, 16, 2 }, { 0.96, 8, 1 }, { 99.95, 8, 1 },
+        { 99.96, 16, 1 }, { 0.5, 1, 0 }, { -0.5, 1, 0 }, { 2.5, 1, 0 },
+        { 0.125, 8, 2 }, { -0.125, 8, 2 }, { -0.004, 8, 1 }, { -0.0001, 16, 3 },
+        { 0.0, 16, 4 }, { 1.0, 0, 2 }, { 72.4, 8, 1 }, { 97.8, 16, 2 },
+    };
+    for (u32 i = 0; i < sizeof(qs) / sizeof(qs[0]); i++) {
+        s32 q = (s32)lround(ldexp(qs[i].x, qs[i].f));
+        for (int w = 0; w <= 8; w += 4) CheckQ(q, qs[i].f, qs[i].d, w);
+    }
+    for (int f = 16; f <= 30; f++) {
+        for (int d = 0; d <= FMT_MAX_DECIMALS; d++) {
+            if (ldexp(2147483648.0, -f) * FMT_POW10[d] >= 2147483647.0) continue;   // no entra en s32
+            CheckQ(INT_MIN, f, d, 0);
+            CheckQ(INT_MAX, f, d, 0);
+        }
+    }
+}
+
+// Al azar en todo el rango (FMT_Q en el rango donde el resultado entra en s32)
+static void TestRandom(void)
+{
+    for (int i = 0; i < 200000; i++) {
+        s32 v = (s32)(u32)(TestRand() * 4294967296.0);
+        int d = (int)(TestRand() * (FMT_MAX_DECIMALS + 1));
+        int w = (int)(TestRand() * 14);
+        CheckInt(v, w);
+        CheckFixed(v, d, w);
+
+        int f = 8 + (int)(TestRand() * 23);
+        while (ldexp(fabs((double)v), -f) * FMT_POW10[d] >= 2147483647.0) f++;
+        CheckQ(v, f, d, w & 7);
+    }
+    printf("fmt: %d comparaciones contra snprintf\n", n_checked);
+}
+
+static volatile char bench_sink;
+
+static void Bench(void)
+{
+    const int N = 2000000;
+    char b[32];
+    double t[6];
+
+    double t0 = TestNowNs();
+    for (int i = 0; i < N; i++) { FMT_Int(b, i * 37 - 1000000, 6); bench_sink = b[0]; }
+    t[0] = TestNowNs() - t0;
+    t0 = TestNowNs();
+    for (int i = 0; i < N; i++) { snprintf(b, sizeof(b), "%6d", i * 37 - 1000000); bench_sink = b[0]; }
+    t[1] = TestNowNs() - t0;
+
+    t0 = TestNowNs();
+    for (int i = 0; i < N; i++) { FMT_Fixed(b, i % 2000, 1, 5); bench_sink = b[0]; }
+    t[2] = TestNowNs() - t0;
+    t0 = TestNowNs();
+    for (int i = 0; i < N; i++) { snprintf(b, sizeof(b), "%5.1f", (i % 2000) / 10.0); bench_sink = b[0]; }
+    t[3] = TestNowNs() - t0;
+
+    t0 = TestNowNs();
+    for (int i = 0; i < N; i++) { FMT_Q(b, i * 13, 16, 2, 6); bench_sink = b[0]; }
+    t[4] = TestNowNs() - t0;
+    t0 = TestNowNs();
+    for (int i = 0; i < N; i++) { snprintf(b, sizeof(b), "%6.2f", (i * 13) / 65536.0); bench_sink = b[0]; }
+    t[5] = TestNowNs() - t0;
+
+    printf("fmt bench: FMT_Int %.1f ns (snprintf %%6d %.1f), FMT_Fixed %.1f ns (%%5.1f %.1f), "
+           "FMT_Q %.1f ns (%%6.2f %.1f)\n",
+           t[0] / N, t[1] / N, t[2] / N, t[3] / N, t[4] / N, t[5] / N);
+}
+
+int main(int argc, char **argv)
+{
+    TestEdges();
+    TestRandom();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_fmt");
+}
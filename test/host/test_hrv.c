@@ -0,0 +1,210 @@
+// HRV: las sumas corridas de las dos ventanas contra la fuerza bruta sobre
+// todos los latidos que HRV_Push dejo entrar (intervalos sueltos con
+// extrasistoles, huecos y cambios de ritmo), y de punta a punta RMSSD,
+// SDNN y pNN50 sobre PPG sintetico contra los intervalos que se generaron.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+#define MAXB    20000
+
+static PPG_Channel ch;
+
+static u32 beat_rr[MAXB], beat_t[MAXB];
+static u8  beat_in[MAXB], beat_chain[MAXB];
+static int nb;
+
+typedef struct {
+    int n;
+    double rmssd, sdnn, pnn50;
+} RefStats;
+
+// Latidos dentro de span_ms de now; una diferencia cuenta si el latido
+// siguio a otro que entro (sin corte) y ese tambien esta en la ventana
+static void Reference(u32 now, u32 span_ms, RefStats *r)
+{
+    double s = 0.0, s2 = 0.0, ssd = 0.0;
+    int n = 0, m = 0, nn50 = 0;
+
+    for (int k = 0; k < nb; k++) {
+        if (!beat_in[k] || now - beat_t[k] > span_ms) continue;
+        n++;
+        s  += beat_rr[k];
+        s2 += (double)beat_rr[k] * beat_rr[k];
+        if (k > 0 && beat_chain[k] && beat_in[k - 1] && now - beat_t[k - 1] <= span_ms) {
+            double d = (double)beat_rr[k] - beat_rr[k - 1];
+            ssd  += d * d;
+            nn50 += fabs(d) > HRV_NN50_MS;
+            m++;
+        }
+    }
+    r->n     = n;
+    r->sdnn  = (n > 1) ? sqrt((s2 - s * s / n) / (n - 1)) : 0.0;
+    r->rmssd = m ? sqrt(ssd / m) : 0.0;
+    r->pnn50 = m ? 100.0 * nn50 / m : 0.0;
+}
+
+static void TestBruteForce(void)
+{
+    PPG_ChannelInit(&ch);
+    HRV_State *h = &ch.hrv;
+    u32 now = 0;
+    int chain = 0, nq = 0;
+    double worst[3] = { 0.0, 0.0, 0.0 };
+
+    for (int b = 0; b < MAXB; b++) {
+        double rr = 800.0 + 60.0 * sin(b * 0.3) + 40.0 * (TestRand() - 0.5);
+        if (TestRand() < 0.02) rr += 300.0;                     // pausa
+        if (b > 3000 && b < 3100) rr = 400.0 + 20.0 * TestRand();
+        if (b > 9000 && b < 9010) rr = 4000.0;                  // hueco
+        int acc = TestRand() > 0.05 && rr < 1300.0;
+
+        u32 r = (u32)rr;
+        now += r;
+        u16 head = h->head;
+        HRV_Push(h, r, now, acc);
+
+        beat_rr[b]    = r;
+        beat_t[b]     = now;
+        beat_in[b]    = h->head != head;
+        beat_chain[b] = (u8)chain;
+        chain = beat_in[b];
+        nb = b + 1;
+
+        if (b % 97 != 0 || b < 10) continue;
+        for (int w = 0; w < 2; w++) {
+            HRV_Stats st;
+            RefStats ref;
+            HRV_Get(&ch, w, &st);
+            Reference(now, w ? HRV_WIN_LONG_S * 1000u : HRV_WIN_SHORT_S * 1000u, &ref);
+            nq++;
+
+            CHECK(st.n == ref.n, "latido %d ventana %d: n %d / %d", b, w, st.n, ref.n);
+            double e[3] = {
+                fabs(st.rmssd_x10 / 10.0 - ref.rmssd),
+                fabs(st.sdnn_x10  / 10.0 - ref.sdnn),
+                fabs(st.pnn50_x10 / 10.0 - ref.pnn50),
+            };
+            for (int q = 0; q < 3; q++) {
+                if (e[q] > worst[q]) worst[q] = e[q];
+            }
+        }
+    }
+
+    printf("hrv: %d latidos, %d consultas: error max RMSSD %.2f ms SDNN %.2f ms pNN50 %.2f%%\n",
+           nb, nq, worst[0], worst[1], worst[2]);
+    // HRV_Get trunca las raices a decimas y redondea pNN50 a decimas
+    CHECK(worst[0] <= 0.1 && worst[1] <= 0.1 && worst[2] <= 0.05 + 1e-9,
+          "error contra la fuerza bruta");
+}
+
+// Edicion NN: un intervalo a mas de HRV_EDIT_PCT del NN anterior no entra
+// hasta HRV_RELOCK seguidos; el que re-engancha entra sin diferencia
+static void TestEditing(void)
+{
+    PPG_ChannelInit(&ch);
+    HRV_State *h = &ch.hrv;
+    u32 now = 0;
+
+    for (int i = 0; i < 10; i++) HRV_Push(h, 800, now += 800, 1);
+    u16 n0 = h->win[HRV_LONG].n, m0 = h->win[HRV_LONG].m;
+
+    HRV_Push(h, 500, now += 500, 1);                // extrasistole
+    HRV_Push(h, 1100, now += 1100, 1);              // pausa
+    CHECK(h->win[HRV_LONG].n == n0, "entro un intervalo editado");
+    HRV_Push(h, 810, now += 810, 1);
+    CHECK(h->win[HRV_LONG].n == n0 + 1 && h->win[HRV_LONG].m == m0,
+          "el latido tras la edicion aporto diferencia");
+
+    // Salto real de ritmo: HRV_RELOCK editados y despues re-engancha
+    for (int i = 0; i < HRV_RELOCK; i++) HRV_Push(h, 500, now += 500, 1);
+    CHECK(h->win[HRV_LONG].n == n0 + 1, "entro el salto antes de HRV_RELOCK");
+    HRV_Push(h, 500, now += 500, 1);
+    HRV_Push(h, 500, now += 500, 1);
+    CHECK(h->win[HRV_LONG].n == n0 + 3 && h->win[HRV_LONG].m == m0 + 1,
+          "no re-engancho tras HRV_RELOCK (n %d, m %d)", h->win[HRV_LONG].n, h->win[HRV_LONG].m);
+}
+
+// PPG con arritmia respiratoria y RR al azar: la ventana larga contra los
+// intervalos generados en los ultimos HRV_WIN_LONG_S
+static void TestPpg(void)
+{
+    static double rr_gen[2000], t_gen[2000];
+    int ng = 0;
+    const double t_end = HRV_WIN_LONG_S + 10.0;
+    SYN_Ppg g;
+    SYN_Init(&g, 0.85);
+    PPG_ChannelInit(&ch);
+
+    double last_pk = -1.0;
+    while (g.t < t_end) {
+        u32 red, ir;
+        if (SYN_Next(&g, &red, &ir)) {
+            // Instante del pico entre muestras (la fase es lineal)
+            double pk = g.t - (g.ph - 0.2) * g.rr;
+            if (last_pk > 0.0 && ng < 2000) {
+                rr_gen[ng] = pk - last_pk;
+                t_gen[ng]  = g.t;
+                ng++;
+            }
+            last_pk = pk;
+            g.rr = 0.85 + 0.05 * sin(2.0 * M_PI * g.t / 4.0) + 0.02 * SYN_Gauss();
+        }
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+    }
+
+    double s = 0.0, s2 = 0.0, ssd = 0.0;
+    int n = 0, m = 0, nn50 = 0;
+    for (int k = 0; k < ng; k++) {
+        if (g.t - t_gen[k] > HRV_WIN_LONG_S) continue;
+        double x = rr_gen[k] * 1000.0;
+        s  += x;
+        s2 += x * x;
+        if (n > 0) {
+            double d = x - rr_gen[k - 1] * 1000.0;
+            ssd  += d * d;
+            nn50 += fabs(d) > HRV_NN50_MS;
+            m++;
+        }
+        n++;
+    }
+    double rmssd = sqrt(ssd / m), sdnn = sqrt((s2 - s * s / n) / (n - 1)), pnn50 = 100.0 * nn50 / m;
+
+    HRV_Stats st;
+    HRV_Get(&ch, HRV_LONG, &st);
+    printf("hrv: PPG %d Hz, %d s: RMSSD %.1f / %.1f ms, SDNN %.1f / %.1f ms, "
+           "pNN50 %.1f / %.1f %%, n %d / %d (medido / generado)\n",
+           SAMPLE_RATE_HZ, HRV_WIN_LONG_S, st.rmssd_x10 / 10.0, rmssd, st.sdnn_x10 / 10.0, sdnn,
+           st.pnn50_x10 / 10.0, pnn50, st.n, n);
+    // El pasabanda mezcla un poco cada pico con sus vecinos y el RR medido
+    // varia ~4 % menos que el generado, sobre todo latido a latido
+    CHECK(fabs(st.rmssd_x10 / 10.0 - rmssd) < 0.05 * rmssd, "RMSSD");
+    CHECK(fabs(st.sdnn_x10  / 10.0 - sdnn)  < 0.05 * sdnn, "SDNN");
+    CHECK(fabs(st.pnn50_x10 / 10.0 - pnn50) < 5.0, "pNN50");
+    CHECK(st.n >= n * 95 / 100 && st.n <= n, "latidos en la ventana");
+}
+
+static void Bench(void)
+{
+    const int N = 5000000;
+    PPG_ChannelInit(&ch);
+    u32 now = 0;
+
+    double t0 = TestNowNs();
+    for (int i = 0; i < N; i++) {
+        u32 rr = 800 + ((u32)i * 7919u) % 80u;
+        HRV_Push(&ch.hrv, rr, now += rr, 1);
+    }
+    double t1 = TestNowNs();
+    printf("hrv bench: HRV_Push %.1f ns por latido, HRV_State %u B\n",
+           (t1 - t0) / N, (unsigned)sizeof(HRV_State));
+}
+
+int main(int argc, char **argv)
+{
+    TestBruteForce();
+    TestEditing();
+    TestPpg();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_hrv");
+}
@@ -0,0 +1,214 @@
+// Morfologia por latido (MORPH_Read) sobre el pulso por tramos de
+// ppg_synth.h, con subida, muesca dicrota y ancho conocidos: varias
+// frecuencias y subidas, con y sin muesca. Un tramo con movimiento tiene
+// que salir marcado MORPH_F_LOWQ. En bench, ns por latido de MORPH_Sample
+// + MORPH_BeatClose, fuera del resto del canal.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+static PPG_Channel ch;
+
+// Ancho a media amplitud del pulso por tramos: la subida cruza en -rise/2
+// y la bajada es monotona hasta la muesca (o SYN_FALL_S)
+static double ExpectedWidth(const SYN_Ppg *g)
+{
+    double lo = 0.0, hi = (g->notch > 0.0) ? g->notch : SYN_FALL_S;
+    for (int i = 0; i < 60; i++) {
+        double mid = 0.5 * (lo + hi);
+        if (SYN_Shape(g, mid) > 0.5) lo = mid;
+        else                         hi = mid;
+    }
+    return 0.5 * g->rise + lo;
+}
+
+// PI que ve el firmware: amplitud sobre el DC medio del latido
+static double ExpectedPi(const SYN_Ppg *g)
+{
+    const int N = 20000;
+    double sum = 0.0;
+    for (int i = 0; i < N; i++) sum += SYN_Shape(g, -g->rise + g->rr * (i + 0.5) / N);
+    return 10000.0 * g->pi / (1.0 + g->pi * sum / N);
+}
+
+enum { E_RR, E_RISE, E_WIDTH, E_NOTCH, E_PI, E_COUNT };
+static const char *const e_name[E_COUNT] = { "rr", "subida", "ancho", "muesca", "PI" };
+
+typedef struct {
+    int    n, notch;                    // registros y con MORPH_F_NOTCH
+    double sum[E_COUNT], max[E_COUNT];  // |error| en ms (PI en % relativo)
+} Errors;
+
+static void Add(Errors *e, int k, double err)
+{
+    e->sum[k] += fabs(err);
+    e->max[k]  = fmax(e->max[k], fabs(err));
+}
+
+static double Mean(const Errors *e, int k)
+{
+    int n = (k == E_NOTCH) ? e->notch : e->n;
+    return n ? e->sum[k] / n : 0.0;
+}
+
+static void Run(double bpm, double rise, double notch, Errors *e)
+{
+    SYN_Ppg g;
+    SYN_Init(&g, 60.0 / bpm);
+    g.rise    = rise;
+    g.notch   = notch;
+    g.resp_dc = 0.0;
+    PPG_ChannelInit(&ch);
+
+    double width = ExpectedWidth(&g) * 1000.0, pi = ExpectedPi(&g);
+    u32 seq = 0;
+    memset(e, 0, sizeof(*e));
+
+    while (g.t < 60.0) {
+        u32 red, ir;
+        SYN_Next(&g, &red, &ir);
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+
+        MORPH_Beat mb[4];
+        int nm = MORPH_Read(&ch, &seq, mb, 4);
+        for (int k = 0; k < nm; k++) {
+            if (mb[k].t_ms < 15000) continue;           // HR enganchando
+            e->n++;
+            Add(e, E_RR,    mb[k].rr_ms    - g.rr * 1000.0);
+            Add(e, E_RISE,  mb[k].rise_ms  - rise * 1000.0);
+            Add(e, E_WIDTH, mb[k].width_ms - width);
+            Add(e, E_PI,    (mb[k].pi_x100 - pi) * 100.0 / pi);
+            if (mb[k].flags & MORPH_F_NOTCH) {
+                e->notch++;
+                Add(e, E_NOTCH, mb[k].notch_ms - notch * 1000.0);
+            }
+        }
+    }
+}
+
+static void TestFeatures(void)
+{
+    static const double bpms[]  = { 55.0, 75.0, 100.0 };
+    static const double rises[] = { 0.10, 0.16 };
+    // Tiempos: media de una muestra (10 ms a 100 Hz: el ruido en el pie y
+    // el pico ya no es menor que eso) y 40 ms en el peor latido
+    const double tol = fmax(1000.0 / SAMPLE_RATE_HZ, 10.0);
+
+    for (int b = 0; b < 3; b++) {
+        for (int r = 0; r < 2; r++) {
+            for (int with_notch = 0; with_notch < 2; with_notch++) {
+                double notch = with_notch ? 0.20 : 0.0;
+                Errors e;
+                Run(bpms[b], rises[r], notch, &e);
+                printf("morph %3.0f BPM subida %3.0f ms muesca %3.0f ms: %2d latidos, muesca en %2d, "
+                       "|error| medio/max:", bpms[b], rises[r] * 1000.0, notch * 1000.0, e.n, e.notch);
+                for (int k = 0; k < E_COUNT; k++) {
+                    printf(" %s %.1f/%.0f", e_name[k], Mean(&e, k), e.max[k]);
+                }
+                printf("\n");
+
+                const char *what = with_notch ? "con muesca" : "sin muesca";
+                CHECK(e.n >= (int)(40.0 * bpms[b] / 60.0), "%.0f BPM %s: %d latidos", bpms[b], what, e.n);
+                for (int k = 0; k < E_COUNT; k++) {
+                    if (k == E_NOTCH) continue;
+                    double lim = (k == E_PI) ? 2.0 : tol;
+                    double top = (k == E_PI) ? 5.0 : 40.0;
+                    CHECK(Mean(&e, k) <= lim && e.max[k] <= top, "%.0f BPM subida %.0f %s: %s "
+                          "|error| medio %.1f max %.1f", bpms[b], rises[r] * 1000.0, what, e_name[k],
+                          Mean(&e, k), e.max[k]);
+                }
+#if SAMPLE_RATE_HZ >= 50
+                if (with_notch) {
+                    CHECK(e.notch >= e.n - 1, "%.0f BPM: muesca en %d de %d", bpms[b], e.notch, e.n);
+                    // Muesca: muestra entera, sin vertice, y el suavizado
+                    // (1 2 1) la corre hacia el pico
+                    CHECK(Mean(&e, E_NOTCH) <= 1.5 * tol && e.max[E_NOTCH] <= 40.0,
+                          "%.0f BPM: muesca |error| medio %.1f max %.1f ms", bpms[b],
+                          Mean(&e, E_NOTCH), e.max[E_NOTCH]);
+                } else {
+                    CHECK(e.notch == 0, "%.0f BPM sin muesca: marcada en %d", bpms[b], e.notch);
+                }
+#endif
+            }
+        }
+    }
+}
+
+// Movimiento entre 30 y 40 s: los latidos de ese tramo salen con LOWQ y
+// los limpios de antes no
+static void TestLowQ(void)
+{
+    SYN_Ppg g;
+    SYN_Init(&g, 0.8);
+    g.rise  = 0.12;
+    g.notch = 0.20;
+    PPG_ChannelInit(&ch);
+
+    u32 seq = 0;
+    int clean = 0, clean_low = 0, moving = 0, moving_low = 0;
+    double kick = 0.0;
+    while (g.t < 45.0) {
+        u32 red, ir;
+        SYN_Next(&g, &red, &ir);
+        if (g.t >= 30.0 && g.t < 40.0) {
+            if (TestRand() < 0.02) kick = (TestRand() - 0.5) * 20000.0;
+            kick *= 0.93;
+            ir  += (u32)(s32)kick;
+            red += (u32)(s32)(kick * 0.8);
+        }
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+
+        MORPH_Beat mb[4];
+        int nm = MORPH_Read(&ch, &seq, mb, 4);
+        for (int k = 0; k < nm; k++) {
+            int low = (mb[k].flags & MORPH_F_LOWQ) != 0;
+            if (mb[k].t_ms >= 15000 && mb[k].t_ms < 28000) { clean++;  clean_low  += low; }
+            if (mb[k].t_ms >= 31000 && mb[k].t_ms < 39000) { moving++; moving_low += low; }
+        }
+    }
+    printf("morph LOWQ: limpios %d/%d, con movimiento %d/%d\n", clean_low, clean, moving_low, moving);
+    CHECK(clean > 0 && clean_low == 0, "latidos limpios con LOWQ: %d de %d", clean_low, clean);
+    CHECK(moving_low == moving, "latidos con movimiento sin LOWQ: %d de %d", moving - moving_low, moving);
+}
+
+// Solo la morfologia: IR crudo de 60 s y las detecciones (pico + 2
+// muestras, como llega el HR) precalculados
+static void Bench(void)
+{
+    enum { SECS = 60, N = SECS * SAMPLE_RATE_HZ, REPS = 50 };
+    static s32 x[N];
+    static u8  beat[N];
+    static MORPH_State m;
+
+    SYN_Ppg g;
+    SYN_Init(&g, 0.8);
+    g.rise  = 0.12;
+    g.notch = 0.20;
+    for (int i = 0; i < N; i++) {
+        u32 red, ir;
+        if (SYN_Next(&g, &red, &ir) && i + 2 < N) beat[i + 2] = 1;
+        x[i] = (s32)(ir << 8);
+    }
+
+    u32 beats = 0;
+    double t0 = TestNowNs();
+    for (int r = 0; r < REPS; r++) {
+        memset(&m, 0, sizeof(m));
+        for (int i = 0; i < N; i++) {
+            MORPH_Sample(&m, x[i], 0);
+            if (beat[i]) MORPH_BeatClose(&m, (u32)i, 100000u * 60u, 60u);
+        }
+        beats += m.seq;
+    }
+    double ns = TestNowNs() - t0;
+    printf("morph bench: %.0f ns por latido a 75 BPM (%.1f ns por muestra), %u latidos\n",
+           ns / beats, ns / ((double)N * REPS), beats);
+}
+
+int main(int argc, char **argv)
+{
+    TestFeatures();
+    TestLowQ();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_morph");
+}
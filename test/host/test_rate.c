@@ -0,0 +1,226 @@
+// Estimador robusto de BPM (HR_Rate) sobre intervalos sueltos con 3 % de
+// jitter: latidos falsos (un intervalo partido en dos) y perdidos (uno
+// doble) contra la media simple de 8 latidos que reemplazo, un cambio real
+// de ritmo que tiene que re-enganchar, la ventana en segundos y los
+// invariantes de la ventana ordenada. HR_Rate es el mismo codigo entero en
+// float y punto fijo: no hay variante _fixed.
+//
+// En bench (o con el argumento "sweep", que corre solo eso) tambien el
+// error del BPM por latido sobre la senal sintetica con la frecuencia de
+// muestreo y el HR_PEAK_INTERP de esta compilacion; "make bench" lo corre
+// a 25, 50 y 100 Hz con y sin interpolacion (test_rate_<hz>hz_interp<0|1>).
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+static HR_Rate rate;
+static volatile u32 bench_sink;
+
+// La ventana ordenada es la del anillo ordenada y sum su suma
+static int Consistent(const HR_Rate *r)
+{
+    u16 v[HR_RATE_WIN_BEATS];
+    u32 sum = 0;
+    for (int k = 0; k < r->count; k++) {
+        int i = (r->head - r->count + k + HR_RATE_WIN_BEATS) % HR_RATE_WIN_BEATS;
+        v[k] = r->ring[i];
+        sum += v[k];
+    }
+    for (int a = 1; a < r->count; a++) {
+        for (int b = a; b > 0 && v[b - 1] > v[b]; b--) {
+            u16 t = v[b]; v[b] = v[b - 1]; v[b - 1] = t;
+        }
+    }
+    return sum == r->sum && memcmp(v, r->sorted, r->count * sizeof(u16)) == 0;
+}
+
+typedef struct {
+    double mae_mean, mae_rate;
+    int alarm_mean, alarm_rate, n;
+} RateStats;
+
+// 2000 latidos a bpm con probabilidad p_false de partir el intervalo y
+// p_missed de duplicarlo; los instantaneos fuera de 40..180 no llegan
+// (los descarta el detector)
+static void Run(double bpm, double p_false, double p_missed, RateStats *st)
+{
+    double hist[8] = { 0 };
+    int hn = 0, hi = 0, bad = 0;
+    u32 now = 0;
+
+    memset(st, 0, sizeof(*st));
+    HR_RateReset(&rate);
+
+    for (int b = 0; b < 2000; b++) {
+        double iv = 60.0 * SAMPLE_RATE_HZ / bpm * (1.0 + 0.03 * (2.0 * TestRand() - 1.0));
+        double part[2] = { iv, 0.0 };
+        int k = 1;
+        double u = TestRand();
+        if (u < p_false) {
+            part[0] = iv * 0.45;
+            part[1] = iv * 0.55;
+            k = 2;
+        } else if (u < p_false + p_missed) {
+            part[0] = 2.0 * iv;
+        }
+
+        for (int j = 0; j < k; j++) {
+            int s = (int)(part[j] + 0.5);
+            now += (u32)s;
+            double inst = 60.0 * SAMPLE_RATE_HZ / s;
+            if (inst < 40.0 || inst > 180.0) continue;
+
+            hist[hi] = inst;
+            hi = (hi + 1) % 8;
+            if (hn < 8) hn++;
+            double mean = 0.0;
+            for (int q = 0; q < hn; q++) mean += hist[q];
+            mean /= hn;
+
+            HR_RateUpdate(&rate, (u16)(inst * 256.0 + 0.5), now);
+            bad += !Consistent(&rate);
+            double est = HR_RateEstimate(&rate) / 256.0;
+
+            if (b > 20) {
+                st->mae_mean   += fabs(mean - bpm);
+                st->mae_rate   += fabs(est - bpm);
+                st->alarm_mean += mean >= BPM_ALARM_THRESHOLD;
+                st->alarm_rate += est  >= BPM_ALARM_THRESHOLD;
+                st->n++;
+            }
+        }
+    }
+    st->mae_mean /= st->n;
+    st->mae_rate /= st->n;
+    CHECK(bad == 0, "%d actualizaciones dejaron la ventana inconsistente", bad);
+}
+
+static void TestOutliers(void)
+{
+    RateStats st;
+
+    Run(72.0, 0.0, 0.0, &st);
+    printf("rate: 72 BPM limpio: error medio %.2f BPM (media de 8: %.2f)\n", st.mae_rate, st.mae_mean);
+    CHECK(st.mae_rate < 1.0, "72 BPM limpio: %.2f", st.mae_rate);
+
+    Run(72.0, 0.05, 0.05, &st);
+    printf("rate: 72 BPM, 5%% falsos y 5%% perdidos: error medio %.2f BPM (media de 8: %.2f)\n",
+           st.mae_rate, st.mae_mean);
+    CHECK(st.mae_rate < 1.5 && st.mae_rate < st.mae_mean / 4.0, "72 BPM con outliers: %.2f", st.mae_rate);
+
+    Run(90.0, 0.10, 0.0, &st);
+    printf("rate: 90 BPM, 10%% falsos: %d de %d actualizaciones sobre %d BPM (media de 8: %d)\n",
+           st.alarm_rate, st.n, BPM_ALARM_THRESHOLD, st.alarm_mean);
+    CHECK(st.alarm_rate <= st.n / 200, "90 BPM: %d alarmas falsas", st.alarm_rate);
+}
+
+// 60 -> 100 BPM de golpe: rechaza HR_RATE_RELOCK - 1 y el siguiente
+// reinicia la ventana en el ritmo nuevo
+static void TestRelock(void)
+{
+    HR_RateReset(&rate);
+    u32 now = 0;
+    for (int i = 0; i < 20; i++) HR_RateUpdate(&rate, 60 * 256, now += SAMPLE_RATE_HZ);
+
+    int first = -1;
+    for (int i = 0; i < 10; i++) {
+        int in = HR_RateUpdate(&rate, 100 * 256, now += SAMPLE_RATE_HZ * 6 / 10);
+        if (in && first < 0) first = i;
+    }
+    CHECK(first == HR_RATE_RELOCK - 1, "re-engancho en el latido %d", first);
+    CHECK(HR_RateEstimate(&rate) == 100 * 256, "estimacion %u tras el cambio", HR_RateEstimate(&rate));
+    CHECK(Consistent(&rate), "ventana inconsistente tras re-enganchar");
+}
+
+// Tras un hueco de mas de HR_RATE_WIN_S los latidos viejos ya no cuentan
+static void TestWindow(void)
+{
+    HR_RateReset(&rate);
+    u32 now = 0;
+    for (int i = 0; i < HR_RATE_WIN_BEATS; i++) HR_RateUpdate(&rate, 60 * 256, now += SAMPLE_RATE_HZ);
+
+    now += (HR_RATE_WIN_S + 1) * SAMPLE_RATE_HZ;
+    int in = HR_RateUpdate(&rate, 90 * 256, now);
+    CHECK(in && rate.count == 1 && HR_RateEstimate(&rate) == 90 * 256,
+          "la ventana de %d s no vencio (n %d)", HR_RATE_WIN_S, rate.count);
+    CHECK(Consistent(&rate), "ventana inconsistente tras vencer");
+}
+
+static void Bench(void)
+{
+    const int N = 5000000;
+    static u16 v[4096];
+    for (int i = 0; i < 4096; i++) v[i] = (u16)((72.0 + 4.0 * (TestRand() - 0.5)) * 256.0);
+
+    HR_RateReset(&rate);
+    u32 now = 0, acc = 0;
+    double t0 = TestNowNs();
+    for (int i = 0; i < N; i++) {
+        HR_RateUpdate(&rate, v[i & 4095], now += SAMPLE_RATE_HZ);
+        acc += HR_RateEstimate(&rate);
+    }
+    double t1 = TestNowNs();
+    bench_sink = acc;
+    printf("rate bench: HR_RateUpdate + HR_RateEstimate %.1f ns por latido\n", (t1 - t0) / N);
+}
+
+// Ritmos fijos que no caen en un numero entero de muestras a ninguna de
+// las tres frecuencias: el error del BPM por latido es el de cuantizar el
+// intervalo (y lo que queda con la interpolacion). Tambien el del BPM
+// mostrado (ch->bpm), una lectura por segundo.
+static void Sweep(void)
+{
+    static const double bpms[] = { 67.0, 93.0, 127.0 };
+    static PPG_Channel ch;
+    double se = 0.0, worst = 0.0, disp = 0.0;
+    int n = 0, nd = 0;
+
+    for (int b = 0; b < 3; b++) {
+        SYN_Ppg g;
+        SYN_Init(&g, 60.0 / bpms[b]);
+        PPG_ChannelInit(&ch);
+
+        for (long k = 0; g.t < 90.0; k++) {
+            u32 red, ir, t_ms = (u32)(k * 1000 / SAMPLE_RATE_HZ);
+            HR_Beat beats[2];
+            SYN_Next(&g, &red, &ir);
+            int nb = PPG_ChannelProcess(&ch, &red, &ir, &t_ms, 1, beats, 2);
+            if (g.t < 20.0) continue;
+
+            for (int i = 0; i < nb; i++) {
+                if (beats[i].bpm <= 0.0f) continue;
+                double e = beats[i].bpm - bpms[b];
+                se   += e * e;
+                worst = fmax(worst, fabs(e));
+                n++;
+            }
+            if (k % SAMPLE_RATE_HZ == 0) {
+                disp += fabs(ch.bpm - bpms[b]);
+                nd++;
+            }
+        }
+    }
+    double rms = sqrt(se / n);
+    printf("rate sweep: %3d Hz, HR_PEAK_INTERP %d: BPM por latido error rms %.2f (max %.2f), "
+           "BPM mostrado error medio %.2f (%d latidos)\n",
+           SAMPLE_RATE_HZ, HR_PEAK_INTERP, rms, worst, disp / nd, n);
+#if HR_PEAK_INTERP
+    CHECK(rms < 1.0, "%d Hz con interpolacion: error rms %.2f BPM", SAMPLE_RATE_HZ, rms);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "sweep") == 0) {
+        Sweep();
+        return TestDone("test_rate sweep");
+    }
+    TestOutliers();
+    TestRelock();
+    TestWindow();
+    if (TestBenchMode(argc, argv)) {
+        Bench();
+        Sweep();
+    }
+    return TestDone("test_rate");
+}
@@ -0,0 +1,181 @@
+// Primitivas de rectangulo sobre oled_buffer (OLED_FillRect, ClearRect,
+// InvertRect, DrawHLine, DrawVLine) contra una referencia pixel a pixel:
+// rectangulos desalineados que cruzan paginas, dentro de una sola pagina,
+// recortados en los bordes (y fuera de pantalla) y con esquinas al reves.
+// En bench, el costo de cada relleno contra el mismo rectangulo pintado con
+// OLED_DrawPixel.
+
+#include "harness.h"
+
+enum { OP_FILL, OP_CLEAR, OP_INVERT, OP_HLINE, OP_VLINE, OP_COUNT };
+
+static u8 pix[OLED_HEIGHT][OLED_WIDTH];
+
+static void RefRect(int x0, int y0, int x1, int y1, int op)
+{
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (x < 0 || x >= OLED_WIDTH || y < 0 || y >= OLED_HEIGHT) continue;
+            if (op == OLED_OP_INVERT) pix[y][x] ^= 1;
+            else                      pix[y][x] = (u8)(op == OLED_OP_SET);
+        }
+    }
+}
+
+// op sobre el buffer y sobre la referencia; on para FILL/HLINE/VLINE
+static void Apply(int op, int x0, int y0, int x1, int y1, int on)
+{
+    switch (op) {
+    case OP_FILL:
+        OLED_FillRect(x0, y0, x1, y1, on);
+        RefRect(x0, y0, x1, y1, on ? OLED_OP_SET : OLED_OP_CLEAR);
+        break;
+    case OP_CLEAR:
+        OLED_ClearRect(x0, y0, x1, y1);
+        RefRect(x0, y0, x1, y1, OLED_OP_CLEAR);
+        break;
+    case OP_INVERT:
+        OLED_InvertRect(x0, y0, x1, y1);
+        RefRect(x0, y0, x1, y1, OLED_OP_INVERT);
+        break;
+    case OP_HLINE:
+        OLED_DrawHLine(x0, x1, y0, on);
+        RefRect(x0, y0, x1, y0, on ? OLED_OP_SET : OLED_OP_CLEAR);
+        break;
+    default:
+        OLED_DrawVLine(x0, y0, y1, on);
+        RefRect(x0, y0, x0, y1, on ? OLED_OP_SET : OLED_OP_CLEAR);
+        break;
+    }
+}
+
+static int Mismatch(void)
+{
+    int n = 0;
+    for (int y = 0; y < OLED_HEIGHT; y++) {
+        for (int x = 0; x < OLED_WIDTH; x++) {
+            n += ((oled_buffer[(y >> 3) * OLED_WIDTH + x] >> (y & 7)) & 1) != pix[y][x];
+        }
+    }
+    return n;
+}
+
+// Buffer y referencia con el mismo fondo al azar
+static void Reset(void)
+{
+    for (int y = 0; y < OLED_HEIGHT; y++) {
+        for (int x = 0; x < OLED_WIDTH; x++) pix[y][x] = 0;
+    }
+    OLED_ClearBuffer();
+    for (int i = 0; i < OLED_WIDTH * OLED_HEIGHT / 4; i++) {
+        int x = (int)(TestRand() * OLED_WIDTH), y = (int)(TestRand() * OLED_HEIGHT);
+        OLED_DrawPixel(x, y, 1);
+        pix[y][x] = 1;
+    }
+}
+
+static int Coord(int lo, int hi)
+{
+    return lo + (int)(TestRand() * (hi - lo + 1));
+}
+
+// Cada caso: 2000 operaciones al azar sobre el mismo buffer, comparando
+// despues de cada una
+static void Run(const char *name, int kind)
+{
+    int bad = 0;
+    Reset();
+    for (int i = 0; i < 2000 && !bad; i++) {
+        int x0, y0, x1, y1;
+        if (kind == 0) {                        // desalineados, varias paginas
+            x0 = Coord(0, OLED_WIDTH - 1);
+            x1 = Coord(0, OLED_WIDTH - 1);
+            y0 = Coord(0, OLED_HEIGHT - 1);
+            y1 = Coord(0, OLED_HEIGHT - 1);
+        } else if (kind == 1) {                 // dentro de una pagina
+            int page = Coord(0, OLED_PAGES - 1);
+            x0 = Coord(0, OLED_WIDTH - 1);
+            x1 = Coord(0, OLED_WIDTH - 1);
+            y0 = page * 8 + Coord(0, 7);
+            y1 = page * 8 + Coord(0, 7);
+        } else {                                // recortados o afuera
+            x0 = Coord(-40, OLED_WIDTH + 40);
+            x1 = Coord(-40, OLED_WIDTH + 40);
+            y0 = Coord(-20, OLED_HEIGHT + 20);
+            y1 = Coord(-20, OLED_HEIGHT + 20);
+        }
+        int op = Coord(0, OP_COUNT - 1);
+        Apply(op, x0, y0, x1, y1, TestRand() < 0.5);
+        int d = Mismatch();
+        CHECK(d == 0, "%s: op %d (%d,%d)-(%d,%d): %d pixeles distintos", name, op, x0, y0, x1, y1, d);
+        bad = d != 0;
+    }
+}
+
+// Bordes exactos: pantalla entera, filas 7/8 (limite de pagina), esquinas
+static void TestEdges(void)
+{
+    static const int r[][4] = {
+        { 0, 0, OLED_WIDTH - 1, OLED_HEIGHT - 1 },
+        { 0, 7, OLED_WIDTH - 1, 8 },
+        { 5, 8, 9, 15 },
+        { OLED_WIDTH - 1, OLED_HEIGHT - 1, OLED_WIDTH + 5, OLED_HEIGHT + 5 },
+        { -5, -5, 0, 0 },
+        { -10, 3, -1, 9 },
+        { OLED_WIDTH, 0, OLED_WIDTH + 3, 3 },
+    };
+    int bad = 0;
+    for (u32 i = 0; i < sizeof(r) / sizeof(r[0]); i++) {
+        for (int op = 0; op < OP_COUNT; op++) {
+            Reset();
+            Apply(op, r[i][0], r[i][1], r[i][2], r[i][3], 1);
+            bad += Mismatch() != 0;
+        }
+    }
+    CHECK(bad == 0, "%d casos de borde distintos de la referencia", bad);
+}
+
+static volatile u8 bench_sink;
+
+static void BenchOne(const char *name, int x0, int y0, int x1, int y1)
+{
+    const int N = 200000;
+    double t0 = TestNowNs();
+    for (int i = 0; i < N; i++) OLED_RectOp(x0, y0, x1, y1, (i & 1) ? OLED_OP_SET : OLED_OP_INVERT);
+    double fill = (TestNowNs() - t0) / N;
+    bench_sink = oled_buffer[0];
+
+    t0 = TestNowNs();
+    for (int i = 0; i < N / 20; i++) {
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) OLED_DrawPixel(x, y, i & 1);
+        }
+    }
+    double px = (TestNowNs() - t0) / (N / 20);
+    bench_sink = oled_buffer[0];
+
+    printf("rect bench: %-26s %3dx%-2d  %7.1f ns por relleno (pixel a pixel %7.1f ns)\n",
+           name, x1 - x0 + 1, y1 - y0 + 1, fill, px);
+}
+
+static void Bench(void)
+{
+    BenchOne("pantalla completa", 0, 0, OLED_WIDTH - 1, OLED_HEIGHT - 1);
+    BenchOne("alineado a pagina", 10, 8, 73, 15);
+    BenchOne("desalineado (3 paginas)", 10, 5, 73, 20);
+    BenchOne("dentro de una pagina", 10, 2, 73, 5);
+    BenchOne("linea horizontal", 0, 13, OLED_WIDTH - 1, 13);
+    BenchOne("linea vertical", 64, 0, 64, OLED_HEIGHT - 1);
+}
+
+int main(int argc, char **argv)
+{
+    Run("desalineados", 0);
+    Run("una pagina", 1);
+    Run("recortados", 2);
+    TestEdges();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_rect");
+}
@@ -0,0 +1,396 @@
+// Pantallas del OLED contra imagenes de referencia (golden/*.pbm): cada
+// pantalla (resumen, BPM grande, SpO2 grande) con lectura valida, sin
+// dedo, con calidad baja ('?') y con alarma. La imagen es la que mostraria
+// el panel segun el modelo de stubs.c: RAM escrita por I2C (frames en
+// pedazos y columnas de la onda), inversion por hardware y encendido.
+// Ademas: redibujar solo lo que cambio da lo mismo que dibujar de cero,
+// sin cambios no se manda nada, la energia sin dedo (atenuado y apagado,
+// y la vuelta con dedo o alarma), el scroll por hardware va en una
+// transaccion (o no se manda, en el SH1106) y el texto 6x8 por bytes de
+// pagina pinta lo mismo que pixel a pixel.
+//
+//   build/test_render          compara con golden/
+//   build/test_render update   reescribe golden/ (revisar el diff a ojo)
+//   build/test_render bench    ademas mide el dibujo y los bytes I2C
+
+#include "harness.h"
+
+#define GOLDEN_DIR  "golden"
+
+// Las imagenes de golden/ son las de la configuracion por defecto (panel
+// de 128x32 con onda); con otra solo corre la prueba incremental
+#define GOLDEN_CONFIG   (OLED_WIDTH == 128 && OLED_HEIGHT == 32 && OLED_WAVE_ENABLE)
+
+typedef struct {
+    const char *name;
+    float bpm, Ta, To, spo2;
+    int   low_q, finger, alarm;
+} Vitals;
+
+static const Vitals states[] = {
+    { "valid",    72.4f, 25.3f, 36.6f, 97.8f, 0, 1, 0 },
+    { "nofinger",  0.0f, 25.3f, 36.6f,  0.0f, 0, 0, 0 },
+    { "lowq",     72.4f, 25.3f, 36.6f, 97.8f, 1, 1, 0 },
+    { "alarm",   123.5f, 25.3f, 36.6f, 96.1f, 0, 1, 1 },
+};
+
+static const char *const screen_name[SCREEN_COUNT] = { "summary", "hr", "spo2" };
+
+static u8 img[OLED_HEIGHT][OLED_WIDTH];
+static u8 ref[OLED_HEIGHT][OLED_WIDTH];
+
+// Lo que se ve en el vidrio
+static void Capture(u8 (*out)[OLED_WIDTH])
+{
+    for (int y = 0; y < OLED_HEIGHT; y++) {
+        for (int x = 0; x < OLED_WIDTH; x++) {
+            int on = (stub_oled_ram[y >> 3][x + OLED_COL_OFFSET] >> (y & 7)) & 1;
+            out[y][x] = (u8)(stub_oled_on ? on ^ stub_oled_inverted : 0);
+        }
+    }
+}
+
+static void Flush(void)
+{
+    while (oled_xfer_busy) OLED_Service();
+}
+
+// Una muestra de la onda: pulso con dicrota, 40 muestras por latido (AC
+// sin dedo = 0, como HR_AcSample)
+static float WaveAc(int i, int finger)
+{
+    if (!finger) return 0.0f;
+    double ph = (i % 40) / 40.0;
+    return (float)(exp(-pow((ph - 0.2) / 0.08, 2)) + 0.35 * exp(-pow((ph - 0.5) / 0.07, 2)) - 0.3);
+}
+
+// Panel recien encendido y la pantalla dibujada desde cero; en el resumen
+// antes pasan 150 muestras de onda, con servicio del bus entre muestras
+static void Render(int screen, const Vitals *v)
+{
+    oled_xfer_busy = 0;
+    oled_frame_pending = 0;
+    oled_pwr_state = OLED_PWR_ACTIVE;
+    oled_idle_ticks = 0;
+    oled_inverted = 0;
+    memset(stub_oled_ram, 0xA5, sizeof(stub_oled_ram));     // basura de arranque
+    OLED_Init();
+
+    OLED_SetScreen(screen);
+    oled_screen_counter = 0;
+#if OLED_WAVE_ENABLE
+    for (int i = 0; i < 150; i++) {
+        WAVE_AddSample(WaveAc(i, v->finger), 0.5f);
+        OLED_Service();
+    }
+#endif
+    OLED_ShowVitals(v->bpm, v->Ta, v->To, v->spo2, v->low_q);
+    Flush();
+    OLED_PowerUpdate(v->finger, v->alarm);
+}
+
+static void PbmPath(char *path, int screen, const Vitals *v)
+{
+    sprintf(path, "%s/%s_%s.pbm", GOLDEN_DIR, screen_name[screen], v->name);
+}
+
+static int WritePbm(const char *path, u8 (*im)[OLED_WIDTH])
+{
+    FILE *f = fopen(path, "w");
+    if (!f) return 0;
+    fprintf(f, "P1\n%d %d\n", OLED_WIDTH, OLED_HEIGHT);
+    for (int y = 0; y < OLED_HEIGHT; y++) {
+        for (int x = 0; x < OLED_WIDTH; x++) fputc('0' + im[y][x], f);
+        fputc('\n', f);
+    }
+    fclose(f);
+    return 1;
+}
+
+// PBM P1 sin comentarios
+static int ReadPbm(const char *path, u8 (*im)[OLED_WIDTH])
+{
+    FILE *f = fopen(path, "r");
+    int w = 0, h = 0, ok = 1;
+    if (!f) return 0;
+    if (fscanf(f, "P1 %d %d", &w, &h) != 2 || w != OLED_WIDTH || h != OLED_HEIGHT) ok = 0;
+    for (int y = 0; ok && y < OLED_HEIGHT; y++) {
+        for (int x = 0; ok && x < OLED_WIDTH; x++) {
+            int c;
+            do c = fgetc(f); while (c == ' ' || c == '\n' || c == '\r');
+            if (c != '0' && c != '1') ok = 0;
+            im[y][x] = (u8)(c == '1');
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Pixeles distintos en las filas y0..y1
+static int Diff(u8 (*a)[OLED_WIDTH], u8 (*b)[OLED_WIDTH], int y0, int y1)
+{
+    int n = 0;
+    for (int y = y0; y <= y1; y++) {
+        for (int x = 0; x < OLED_WIDTH; x++) n += a[y][x] != b[y][x];
+    }
+    return n;
+}
+
+static void TestGolden(int update)
+{
+    char path[128];
+    int n = 0;
+
+    for (int s = 0; s < SCREEN_COUNT; s++) {
+        for (u32 k = 0; k < sizeof(states) / sizeof(states[0]); k++) {
+            Render(s, &states[k]);
+            Capture(img);
+            PbmPath(path, s, &states[k]);
+            n++;
+
+            if (update) {
+                CHECK(WritePbm(path, img), "no se pudo escribir %s", path);
+                continue;
+            }
+            if (!ReadPbm(path, ref)) {
+                CHECK(0, "falta %s o no es un PBM P1 de %dx%d", path, OLED_WIDTH, OLED_HEIGHT);
+                continue;
+            }
+            int d = Diff(img, ref, 0, OLED_HEIGHT - 1);
+            if (d) {
+                sprintf(path, "build/%s_%s.pbm", screen_name[s], states[k].name);
+                WritePbm(path, img);
+            }
+            CHECK(d == 0, "%s_%s: %d pixeles distintos (lo dibujado quedo en %s)",
+                  screen_name[s], states[k].name, d, path);
+        }
+    }
+    printf("render: %d pantallas %s\n", n, update ? "escritas en " GOLDEN_DIR "/" : "comparadas");
+}
+
+// Pasar de un estado a otro redibujando solo los caracteres que cambiaron
+// da la misma imagen que dibujar el segundo desde cero (la onda sigue
+// corriendo, se comparan las paginas de texto); y sin cambios no hay frame
+static void TestIncremental(void)
+{
+    for (int s = 0; s < SCREEN_COUNT; s++) {
+        int rows = (s == SCREEN_SUMMARY && OLED_WAVE_ENABLE) ? WAVE_PAGE0 * 8 : OLED_HEIGHT;
+        for (u32 a = 0; a < sizeof(states) / sizeof(states[0]); a++) {
+            for (u32 b = 0; b < sizeof(states) / sizeof(states[0]); b++) {
+                Vitals to = states[b];
+                to.alarm = 0;
+
+                Render(s, &to);
+                Capture(ref);
+
+                Render(s, &states[a]);
+                OLED_ShowVitals(to.bpm, to.Ta, to.To, to.spo2, to.low_q);
+                Flush();
+                OLED_PowerUpdate(1, 0);
+                Capture(img);
+
+                int d = Diff(img, ref, 0, rows - 1);
+                CHECK(d == 0, "%s: %s -> %s redibujado difiere en %d pixeles",
+                      screen_name[s], states[a].name, states[b].name, d);
+
+                u32 bytes = stub_oled_bytes;
+                OLED_ShowVitals(to.bpm, to.Ta, to.To, to.spo2, to.low_q);
+                Flush();
+                CHECK(stub_oled_bytes == bytes, "%s: sin cambios mando %u bytes",
+                      screen_name[s], stub_oled_bytes - bytes);
+            }
+        }
+    }
+}
+
+// Energia sin dedo: contraste normal hasta OLED_DIM_MS, atenuado
+// (OLED_CONTRAST_DIM) hasta OLED_OFF_MS y apagado despues, sin mandar nada
+// mientras no cambia de estado; un dedo o una alarma lo devuelven al
+// contraste normal en la misma actualizacion
+static void Idle(int ticks)
+{
+    for (int t = 1; t <= ticks; t++) {
+        u32 bytes = stub_oled_bytes;
+        OLED_PowerUpdate(0, 0);
+
+        int ms = t * OLED_UPDATE_MS;
+        int want_on = ms < OLED_OFF_MS;
+        int want_c  = (ms < OLED_DIM_MS) ? OLED_CONTRAST : OLED_CONTRAST_DIM;
+        CHECK(stub_oled_on == want_on && OLED_IsOn() == want_on,
+              "%d ms sin dedo: panel %s", ms, stub_oled_on ? "encendido" : "apagado");
+        CHECK(!want_on || stub_oled_contrast == want_c,
+              "%d ms sin dedo: contraste 0x%02X, se esperaba 0x%02X", ms, stub_oled_contrast, want_c);
+
+        int edge = ms == OLED_DIM_MS || ms == OLED_OFF_MS;
+        CHECK(edge || stub_oled_bytes == bytes, "%d ms sin dedo: %u bytes sin cambio de estado",
+              ms, stub_oled_bytes - bytes);
+    }
+}
+
+static void Wake(int finger, int alarm, const char *what)
+{
+    OLED_PowerUpdate(finger, alarm);
+    CHECK(stub_oled_on && OLED_IsOn(), "%s no encendio el panel", what);
+    CHECK(stub_oled_contrast == OLED_CONTRAST, "%s: contraste 0x%02X", what, stub_oled_contrast);
+    CHECK(stub_oled_inverted == alarm, "%s: inversion %d", what, stub_oled_inverted);
+}
+
+static void TestPower(void)
+{
+    const int dim = OLED_DIM_MS / OLED_UPDATE_MS, off = OLED_OFF_MS / OLED_UPDATE_MS;
+
+    Render(SCREEN_SUMMARY, &states[0]);
+    CHECK(stub_oled_on && stub_oled_contrast == OLED_CONTRAST, "arranque: panel %d contraste 0x%02X",
+          stub_oled_on, stub_oled_contrast);
+    Idle(off + 5);
+    Wake(1, 0, "un dedo con el panel apagado");
+
+    Idle((dim + off) / 2);
+    Wake(1, 0, "un dedo con el panel atenuado");
+
+    Idle(off + 1);
+    Wake(0, 1, "una alarma con el panel apagado");
+    OLED_PowerUpdate(1, 0);
+    CHECK(!stub_oled_inverted && stub_oled_on, "al terminar la alarma el panel quedo invertido o apagado");
+
+    Idle(dim + 1);
+    Wake(0, 1, "una alarma con el panel atenuado");
+    OLED_PowerUpdate(1, 0);
+}
+
+// Scroll por hardware: una transaccion de comandos para arrancar y otra
+// para parar; el SH1106 no tiene scroll y no manda nada
+static void TestScroll(void)
+{
+    Render(SCREEN_SUMMARY, &states[0]);
+    u32 bytes = stub_oled_bytes;
+    int st = OLED_StartHScroll(0, 0, OLED_PAGES - 1, 7);
+#if OLED_HAS_HW_SCROLL
+    CHECK(st == XST_SUCCESS && stub_oled_scrolling, "el scroll no arranco (%d)", st);
+    CHECK(stub_oled_bytes - bytes == 10, "arrancar el scroll mando %u bytes", stub_oled_bytes - bytes);
+    bytes = stub_oled_bytes;
+    st = OLED_StopScroll();
+    CHECK(st == XST_SUCCESS && !stub_oled_scrolling, "el scroll no paro (%d)", st);
+    CHECK(stub_oled_bytes - bytes == 2, "parar el scroll mando %u bytes", stub_oled_bytes - bytes);
+#else
+    CHECK(st == XST_NO_FEATURE && OLED_StopScroll() == XST_NO_FEATURE, "scroll sin soporte: %d", st);
+    CHECK(stub_oled_bytes == bytes && !stub_oled_scrolling, "scroll sin soporte mando comandos");
+#endif
+}
+
+// Texto 6x8 como antes de OLED_BlitGlyphs6x8: 48 OLED_DrawPixel por
+// caracter, columna de separacion incluida
+static void PixelString6x8(int x, int y, const char *s)
+{
+    for (; *s && x <= OLED_WIDTH - GLYPH_W; s++, x += GLYPH_W) {
+        const u8 *g = OLED_GetGlyph(*s)->cols;
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < GLYPH_W; col++) OLED_DrawPixel(x + col, y + row, (g[col] >> row) & 1);
+        }
+    }
+}
+
+static const char glyph_text[] = "SpO2 97.8% BPM 72 Ta 25.3";
+
+// Alineado a pagina y corrido (cruza dos paginas), sobre fondo lleno y
+// vacio: el blit tiene que dejar el buffer igual que pixel a pixel
+static void TestGlyphs(void)
+{
+    static const int ys[] = { 0, 8, 3, 13, 27, -4 };
+    u8 want[OLED_WIDTH * OLED_PAGES];
+    int bad = 0;
+
+    for (u32 i = 0; i < sizeof(ys) / sizeof(ys[0]); i++) {
+        for (int bg = 0; bg < 2; bg++) {
+            memset(oled_buffer, bg ? 0xFF : 0x00, sizeof(oled_buffer));
+            PixelString6x8(1, ys[i], glyph_text);
+            memcpy(want, oled_buffer, sizeof(want));
+
+            memset(oled_buffer, bg ? 0xFF : 0x00, sizeof(oled_buffer));
+            OLED_DrawString6x8(1, ys[i], glyph_text);
+            bad += memcmp(want, oled_buffer, sizeof(want)) != 0;
+        }
+    }
+    CHECK(bad == 0, "texto 6x8: %d casos distintos de pixel a pixel", bad);
+}
+
+static void BenchGlyphs(void)
+{
+    const int N = 200000;
+    const int chars = (int)strlen(glyph_text);      // entran todos en 128 columnas
+    static const int ys[] = { 8, 11 };
+
+    for (int k = 0; k < 2; k++) {
+        double t0 = TestNowNs();
+        for (int i = 0; i < N; i++) OLED_DrawString6x8(1, ys[k], glyph_text);
+        double blit = (TestNowNs() - t0) / ((double)N * chars);
+
+        t0 = TestNowNs();
+        for (int i = 0; i < N / 20; i++) PixelString6x8(1, ys[k], glyph_text);
+        double px = (TestNowNs() - t0) / ((double)(N / 20) * chars);
+
+        printf("render bench: texto 6x8 %s: %.1f M caracteres/s (pixel a pixel %.1f M/s, x%.0f)\n",
+               ys[k] & 7 ? "corrido" : "alineado", 1e3 / blit, 1e3 / px, px / blit);
+    }
+}
+
+static void Bench(void)
+{
+    const int N = 20000;
+    Render(SCREEN_SUMMARY, &states[0]);
+
+    // Resumen con el BPM cambiando en cada actualizacion: dibujo y frame
+    // (sin rotar de pantalla)
+    u32 bytes = stub_oled_bytes;
+    double draw = 0.0;
+    for (int i = 0; i < N; i++) {
+        oled_screen_counter = 0;
+        double t0 = TestNowNs();
+        OLED_ShowVitals(60.0f + (i % 600) * 0.1f, 25.3f, 36.6f, 97.8f, 0);
+        draw += TestNowNs() - t0;
+        Flush();
+    }
+    double frame_bytes = (double)(stub_oled_bytes - bytes) / N;
+
+    // Onda: una columna por muestra
+    bytes = stub_oled_bytes;
+    double t0 = TestNowNs();
+    for (int i = 0; i < N; i++) WAVE_AddSample(WaveAc(i, 1), 0.5f);
+    double wave = (TestNowNs() - t0) / N;
+    double wave_bytes = (double)(stub_oled_bytes - bytes) / N;
+
+    // Pantalla grande redibujada entera (cambio de pantalla)
+    t0 = TestNowNs();
+    for (int i = 0; i < N; i++) {
+        OLED_SetScreen(SCREEN_HR);
+        OLED_DrawHR(72.4f, 25.3f, 36.6f, 97.8f, 0);
+    }
+    double full = (TestNowNs() - t0) / N;
+
+    printf("render bench: resumen %.0f ns por actualizacion + %.0f bytes I2C por frame; "
+           "onda %.0f ns y %.1f bytes por muestra; BPM grande desde cero %.0f ns\n",
+           draw / N, frame_bytes, wave, wave_bytes, full);
+
+    BenchGlyphs();
+}
+
+int main(int argc, char **argv)
+{
+    int update = argc > 1 && strcmp(argv[1], "update") == 0;
+
+    if (GOLDEN_CONFIG) {
+        TestGolden(update);
+    } else {
+        printf("render: panel de %dx%d%s, sin comparar con " GOLDEN_DIR "/\n",
+               OLED_WIDTH, OLED_HEIGHT, OLED_WAVE_ENABLE ? "" : " sin onda");
+        CHECK(!update, "golden/ es de la configuracion por defecto");
+    }
+    if (!update) {
+        TestIncremental();
+        TestPower();
+        TestScroll();
+        TestGlyphs();
+    }
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_render");
+}
@@ -0,0 +1,59 @@
+// Respiracion: frecuencias conocidas con las tres modulaciones (linea base,
+// amplitud y RSA en el intervalo) y con una sola serie que no la ve; la
+// fusion tiene que salir del par que coincide.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+static PPG_Channel ch;
+
+// Devuelve el % de lecturas (una por segundo, despues de 40 s) a menos de
+// 1.5 resp/min de brpm; rsa = modulacion del RR en s (0 = sin RSA)
+static double Run(double brpm, double dc, double amp, double rsa, double *mean)
+{
+    SYN_Ppg g;
+    SYN_Init(&g, 0.85);
+    g.resp_hz  = brpm / 60.0;
+    g.resp_dc  = dc;
+    g.resp_amp = amp;
+    PPG_ChannelInit(&ch);
+
+    int n = 0, ok = 0;
+    double sum = 0.0;
+    for (long k = 0; g.t < 120.0; k++) {
+        u32 red, ir;
+        if (SYN_Next(&g, &red, &ir)) {
+            g.rr = 0.85 + rsa * sin(2.0 * M_PI * g.resp_hz * g.t) + 0.01 * SYN_Gauss();
+        }
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+
+        if (g.t > 40.0 && k % SAMPLE_RATE_HZ == 0) {
+            float r = RESP_Rate(&ch);
+            n++;
+            ok  += fabs(r - brpm) < 1.5;
+            sum += r;
+        }
+    }
+    *mean = sum / n;
+    return 100.0 * ok / n;
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    static const double rates[] = { 10.0, 15.0, 20.0 };
+
+    for (int k = 0; k < 3; k++) {
+        double br = rates[k], m3, m2;
+        double all3 = Run(br, 0.008, 0.15, 0.04, &m3);
+        double pair = Run(br, 0.008, 0.15, 0.0,  &m2);
+
+        printf("resp %.0f/min: tres series %.0f%% (media %.2f), sin RSA %.0f%% (media %.2f) "
+               "[sin RSA: base %.2f amp %.2f rr %.2f]\n",
+               br, all3, m3, pair, m2,
+               RESP_SeriesRate(&ch, 0), RESP_SeriesRate(&ch, 1), RESP_SeriesRate(&ch, 2));
+        CHECK(all3 >= 90.0, "%.0f resp/min con las tres series: %.0f%%", br, all3);
+        CHECK(pair >= 80.0, "%.0f resp/min sin RSA: %.0f%%", br, pair);
+    }
+    return TestDone("test_resp");
+}
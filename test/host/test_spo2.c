@@ -0,0 +1,147 @@
+// SpO2 por latido: R medido contra el R generado (0.45-1.20, 55-105 BPM)
+// con perfusion normal, baja y con rafagas de movimiento; la SpO2 contra la
+// curva de referencia del MAX30102, la tabla SPO2_CAL_DEFAULT contra la
+// misma curva entre sus puntos y el cambio de tabla por lote de sensor.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+static PPG_Channel ch;
+
+// Curva de referencia del MAX30102, saturada donde la tabla satura
+static double Curve(double r)
+{
+    if (r < 0.375) r = 0.375;
+    if (r > 1.375) r = 1.375;
+    return -45.060 * r * r + 30.354 * r + 94.845;
+}
+
+// motion: amplitud (cuentas) de 2 s de movimiento a 1.7 Hz cada 10 s
+static void TestRatio(double pi, double motion, double r_mae_max, double spo2_mae_max)
+{
+    double e_r = 0.0, e_s = 0.0, e_max = 0.0;
+    int n = 0;
+
+    for (double r = 0.45; r < 1.21; r += 0.05) {
+        for (double bpm = 55.0; bpm < 130.0; bpm += 25.0) {
+            SYN_Ppg g;
+            SYN_Init(&g, 60.0 / bpm);
+            g.pi = pi;
+            g.ratio = r;
+            PPG_ChannelInit(&ch);
+
+            while (g.t < 60.0) {
+                u32 red, ir;
+                SYN_Next(&g, &red, &ir);
+                if (fmod(g.t, 10.0) < 2.0) {
+                    double m = motion * sin(2.0 * M_PI * 1.7 * g.t);
+                    ir  = (u32)((double)ir + m);
+                    red = (u32)((double)red + 0.8 * m);
+                }
+                PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+            }
+
+            double rm = ch.spo2_beat.r_q16 / 65536.0;
+            double e  = fabs(ch.spo2 - Curve(r));
+            e_r += fabs(rm - r);
+            e_s += e;
+            if (e > e_max) e_max = e;
+            n++;
+        }
+    }
+
+    printf("spo2: PI %.1f%% movimiento %.0f: error medio R %.4f, SpO2 %.2f%% (max %.2f%%)\n",
+           100.0 * pi, motion, e_r / n, e_s / n, e_max);
+    CHECK(e_r / n < r_mae_max, "PI %.3f mov %.0f: error medio de R %.4f", pi, motion, e_r / n);
+    CHECK(e_s / n < spo2_mae_max, "PI %.3f mov %.0f: error medio de SpO2 %.2f", pi, motion, e_s / n);
+}
+
+// Tabla interpolada contra la curva cada 0.001 de R, dentro y fuera del rango
+static void TestTable(void)
+{
+    double worst = 0.0;
+    for (double r = 0.3; r < 1.45; r += 0.001) {
+        double e = fabs(SPO2_Calibrate(&SPO2_CAL_DEFAULT, (u32)(r * 65536.0)) / 256.0 - Curve(r));
+        if (e > worst) worst = e;
+    }
+    printf("spo2: tabla contra la curva: error max %.3f%%\n", worst);
+    CHECK(worst < 0.05, "interpolacion de la tabla: %.3f%%", worst);
+}
+
+// Otro lote: la aproximacion lineal 110 - 25 R, cada 1/8 desde R = 0.4
+// (100 %). Tablas invalidas no se instalan; PPG_ChannelReset conserva la
+// del canal.
+static const u16 cal_lot_q8[9] = {
+    25600, 24800, 24000, 23200, 22400, 21600, 20800, 20000, 19200,
+};
+static const SPO2_Cal cal_lot = { 26214, 13, 9, cal_lot_q8 };
+
+static void TestSwap(void)
+{
+    static const u16 rising_q8[3] = { 20000, 21000, 22000 };
+    static const u16 over_q8[2]   = { 26000, 25000 };
+    static const SPO2_Cal bad[] = {
+        { 26214, 13, 1, cal_lot_q8 },           // un solo punto
+        { 26214, 13, 3, rising_q8 },            // sube con R
+        { 26214, 13, 2, over_q8 },              // mas de 100 %
+        { 26214, 13, 9, NULL },
+    };
+
+    PPG_ChannelInit(&ch);
+    for (u32 i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        CHECK(SPO2_SetCalibration(&ch, &bad[i]) == XST_INVALID_PARAM, "tabla invalida %u aceptada", i);
+    }
+    CHECK(SPO2_SetCalibration(&ch, NULL) == XST_INVALID_PARAM, "tabla NULL aceptada");
+    CHECK(ch.spo2_cal == &SPO2_CAL_DEFAULT, "una tabla invalida cambio la calibracion");
+
+    double worst = 0.0;
+    for (double r = 0.5; r < 1.01; r += 0.1) {
+        SYN_Ppg g;
+        SYN_Init(&g, 0.8);
+        g.ratio = r;
+        PPG_ChannelInit(&ch);
+        CHECK(SPO2_SetCalibration(&ch, &cal_lot) == XST_SUCCESS, "no se instalo la tabla del lote");
+        while (g.t < 30.0) {
+            u32 red, ir;
+            SYN_Next(&g, &red, &ir);
+            PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+            if (g.t > 15.0 && g.t < 15.0 + 1.0 / SAMPLE_RATE_HZ) PPG_ChannelReset(&ch);
+        }
+        double e = fabs(ch.spo2 - (110.0 - 25.0 * r));
+        if (e > worst) worst = e;
+        CHECK(ch.spo2_cal == &cal_lot, "PPG_ChannelReset perdio la tabla del lote");
+    }
+    printf("spo2: tabla de otro lote (110 - 25 R): error max %.2f%%\n", worst);
+    CHECK(worst < 0.6, "tabla del lote: %.2f%%", worst);
+}
+
+static void Bench(void)
+{
+    const int N = 60 * SAMPLE_RATE_HZ;
+    static u32 red[60 * SAMPLE_RATE_HZ], ir[60 * SAMPLE_RATE_HZ];
+    SYN_Ppg g;
+    SYN_Init(&g, 0.8);
+    for (int i = 0; i < N; i++) SYN_Next(&g, &red[i], &ir[i]);
+
+    PPG_ChannelInit(&ch);
+    double t0 = TestNowNs();
+    for (int rep = 0; rep < 20; rep++) {
+        for (int i = 0; i + PPG_BLOCK_MAX <= N; i += PPG_BLOCK_MAX) {
+            PPG_ChannelProcess(&ch, &red[i], &ir[i], NULL, PPG_BLOCK_MAX, NULL, 0);
+        }
+    }
+    double t1 = TestNowNs();
+    printf("spo2 bench: PPG_ChannelProcess completo %.1f ns por muestra (bloques de %d)\n",
+           (t1 - t0) / (20.0 * (N / PPG_BLOCK_MAX) * PPG_BLOCK_MAX), PPG_BLOCK_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    TestRatio(0.02, 0.0, 0.03, 0.5);
+    TestRatio(0.02, 2000.0, 0.03, 0.5);
+    TestRatio(0.005, 0.0, 0.08, 2.5);
+    TestTable();
+    TestSwap();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_spo2");
+}
@@ -0,0 +1,171 @@
+// Calidad de señal y lo que deja pasar: una FA rapida (ritmo irregular,
+// sin artefacto) baja la periodicidad y la plantilla pero el BPM la sigue
+// y la alarma suena; con movimiento los valores se retienen a lo sumo
+// PPG_HOLD_S, un BPM retenido no mantiene la alarma y sin dedo la marca es
+// SQI_F_NOFINGER.
+
+#include "harness.h"
+#include "ppg_synth.h"
+
+static PPG_Channel ch;
+
+// Sinusal a 75 BPM, FA a ~130 BPM (CV 0.2) entre t_af0 y t_af1, sinusal
+static void TestAfRate(void)
+{
+    const double t_af0 = 60.0, t_af1 = 240.0, t_end = 300.0;
+    SYN_Ppg g;
+    SYN_Init(&g, 0.8);
+    PPG_ChannelInit(&ch);
+
+    int n_af = 0, ok_af = 0, alarm_af = 0, rhythm_af = 0;
+    int n_sr = 0, ok_sr = 0, alarm_sr = 0;
+    while (g.t < t_end) {
+        u32 red, ir;
+        if (SYN_Next(&g, &red, &ir)) {
+            int af = g.t > t_af0 && g.t < t_af1;
+            g.rr = af ? 0.46 * (1.0 + 0.2 * SYN_Gauss()) : 0.8 + 0.02 * SYN_Gauss();
+            if (g.rr < 0.34) g.rr = 0.34;
+        }
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+
+        int alarm = PPG_BpmAlarm(&ch);
+        if (g.t > t_af0 + 20.0 && g.t < t_af1) {
+            n_af++;
+            ok_af     += fabs(ch.bpm - 130.0) < 20.0;
+            alarm_af  += alarm;
+            rhythm_af += (PPG_QualityFlags(&ch) & SQI_F_RHYTHM) != 0;
+        } else if (g.t > 20.0 && (g.t < t_af0 || g.t > t_af1 + 20.0)) {
+            n_sr++;
+            ok_sr    += fabs(ch.bpm - 75.0) < 5.0;
+            alarm_sr += alarm;
+        }
+    }
+
+    printf("sqi: FA BPM ok %.1f%% alarma %.1f%% (motivos de ritmo %.1f%%), "
+           "sinusal BPM ok %.1f%% alarma %.1f%%\n",
+           100.0 * ok_af / n_af, 100.0 * alarm_af / n_af, 100.0 * rhythm_af / n_af,
+           100.0 * ok_sr / n_sr, 100.0 * alarm_sr / n_sr);
+    CHECK(rhythm_af > n_af / 2, "la FA no bajo periodicidad/plantilla: la prueba no prueba nada");
+    CHECK(ok_af >= n_af * 9 / 10, "BPM durante la FA");
+    CHECK(alarm_af >= n_af * 9 / 10, "alarma durante la FA");
+    CHECK(ok_sr >= n_sr * 95 / 100, "BPM sinusal");
+    CHECK(alarm_sr == 0, "alarma en sinusal");
+}
+
+// 40 s limpios, 60 s de movimiento (saltos grandes al azar), 10 s sin dedo
+static void TestHold(void)
+{
+    SYN_Ppg g;
+    SYN_Init(&g, 0.8);
+    PPG_ChannelInit(&ch);
+
+    float last_bpm = 0.0f, last_spo2 = 0.0f;
+    double bpm_since = 0.0, spo2_since = 0.0, bpm_run = 0.0, spo2_run = 0.0;
+    int expired = 0, nofinger_ok = 1, nofinger_n = 0;
+    double kick = 0.0;
+    while (g.t < 110.0) {
+        u32 red, ir;
+        SYN_Next(&g, &red, &ir);
+        g.finger = g.t < 100.0;
+        if (g.t > 40.0 && g.t < 100.0) {
+            // Golpe: escalon de varias veces el pulso que decae en ~0.3 s
+            if (TestRand() < 0.02) kick = (TestRand() - 0.5) * 20000.0;
+            kick *= 0.93;
+            ir  += (u32)(s32)kick;
+            red += (u32)(s32)(kick * 0.8);
+        }
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+
+        // Mayor tiempo que un valor distinto de 0 quedo igual
+        if (ch.bpm != last_bpm) { last_bpm = ch.bpm; bpm_since = g.t; }
+        if (ch.spo2 != last_spo2) { last_spo2 = ch.spo2; spo2_since = g.t; }
+        if (ch.bpm  > 0.0f && g.t - bpm_since  > bpm_run)  bpm_run  = g.t - bpm_since;
+        if (ch.spo2 > 0.0f && g.t - spo2_since > spo2_run) spo2_run = g.t - spo2_since;
+        if (g.t > 40.0 && g.t < 100.0 && ch.bpm == 0.0f) expired = 1;
+
+        if (g.t > 100.5) {
+            nofinger_n++;
+            nofinger_ok &= PPG_QualityFlags(&ch) == SQI_F_NOFINGER &&
+                           ch.sqi_low[0] == SQI_F_NOFINGER;
+        }
+    }
+
+    printf("sqi: con movimiento el BPM quedo fijo a lo sumo %.1f s y la SpO2 %.1f s\n",
+           bpm_run, spo2_run);
+    CHECK(expired, "el movimiento nunca vencio el BPM: la prueba no prueba nada");
+    CHECK(bpm_run  <= PPG_HOLD_S + 0.5, "BPM retenido %.1f s", bpm_run);
+    CHECK(spo2_run <= PPG_HOLD_S + 0.5, "SpO2 retenida %.1f s", spo2_run);
+    CHECK(nofinger_n > 0 && nofinger_ok, "sin dedo no marca SQI_F_NOFINGER");
+}
+
+// Taquicardia sinusal a 130 BPM con un tramo de movimiento y otro de
+// recorte del ADC: el BPM queda retenido arriba del umbral pero la alarma
+// se calla pasados PPG_ALARM_FRESH_S, y vuelve cuando la calidad se repone
+static void TestAlarmArtefact(void)
+{
+    static const struct { double t0, t1; } seg[] = {
+        { 30.0, 50.0 },                 // movimiento
+        { 70.0, 90.0 },                 // recorte
+    };
+    SYN_Ppg g;
+    SYN_Init(&g, 60.0 / 130.0);
+    PPG_ChannelInit(&ch);
+
+    int n_clean = 0, on_clean = 0, n_end = 0, on_end = 0;
+    int n_art[2] = { 0, 0 }, on_art[2] = { 0, 0 }, held_art[2] = { 0, 0 };
+    double kick = 0.0;
+    while (g.t < 130.0) {
+        u32 red, ir;
+        SYN_Next(&g, &red, &ir);
+
+        int k = -1;
+        for (int j = 0; j < 2; j++) {
+            if (g.t > seg[j].t0 && g.t < seg[j].t1) k = j;
+        }
+        if (k == 0) {
+            if (TestRand() < 0.02) kick = (TestRand() - 0.5) * 20000.0;
+            kick *= 0.93;
+            ir  += (u32)(s32)kick;
+            red += (u32)(s32)(kick * 0.8);
+        } else if (k == 1) {
+            // DC cerca del fondo de escala: los picos recortan
+            ir  = (ir  + 160000 > 0x3FFFF) ? 0x3FFFF : ir  + 160000;
+            red = (red + 160000 > 0x3FFFF) ? 0x3FFFF : red + 160000;
+        }
+        PPG_ChannelProcess(&ch, &red, &ir, NULL, 1, NULL, 0);
+
+        int alarm = PPG_BpmAlarm(&ch);
+        if (k >= 0 && g.t > seg[k].t0 + PPG_ALARM_FRESH_S + 1.0) {
+            n_art[k]++;
+            on_art[k]   += alarm;
+            held_art[k] += (int)(ch.bpm + 0.5f) >= BPM_ALARM_THRESHOLD;
+        } else if (g.t > 10.0 && g.t < seg[0].t0) {
+            n_clean++;
+            on_clean += alarm;
+        } else if (g.t > 125.0) {
+            n_end++;
+            on_end += alarm;
+        }
+    }
+
+    printf("sqi: taquicardia: alarma %.1f%% limpia, %.1f%% con movimiento y %.1f%% con recorte "
+           "(BPM retenido arriba del umbral %.1f%% / %.1f%%), %.1f%% al reponerse\n",
+           100.0 * on_clean / n_clean, 100.0 * on_art[0] / n_art[0], 100.0 * on_art[1] / n_art[1],
+           100.0 * held_art[0] / n_art[0], 100.0 * held_art[1] / n_art[1], 100.0 * on_end / n_end);
+    CHECK(on_clean == n_clean, "alarma con taquicardia limpia %d de %d", on_clean, n_clean);
+    CHECK(on_end == n_end, "la alarma no volvio tras el artefacto (%d de %d)", on_end, n_end);
+    for (int j = 0; j < 2; j++) {
+        CHECK(held_art[j] > 0, "tramo %d: el BPM no quedo retenido: la prueba no prueba nada", j);
+        CHECK(on_art[j] <= n_art[j] / 20, "tramo %d: alarma %d de %d muestras con artefacto",
+              j, on_art[j], n_art[j]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+    TestAfRate();
+    TestHold();
+    TestAlarmArtefact();
+    return TestDone("test_sqi");
+}
@@ -0,0 +1,167 @@
+// TREND: cada consulta contra la fuerza bruta sobre todos los valores
+// empujados. La referencia no repite la logica de niveles: toma el lapso
+// que TREND_Query dice haber resumido y suma a mano los valores que caen
+// ahi; aparte se verifica que ese lapso cubra la ventana pedida (con menos
+// de una cubeta de sobra por borde) y que ningun nivel mas fino la tuviera.
+
+#include "harness.h"
+
+#define MAXP    400000
+
+static const u32 res_s[TREND_LEVELS] = { 1, 60, 900, 3600 };
+static const u32 depth[TREND_LEVELS] = {
+    TREND_DEPTH_1S, TREND_DEPTH_1M, TREND_DEPTH_15M, TREND_DEPTH_1H
+};
+
+static TREND_Store tr;
+static u32 push_t[MAXP];
+static s16 push_v[MAXP];
+static int np;
+static u32 first_ms, tmax_ms;
+
+static void Push(u32 t_ms, float v)
+{
+    TREND_Push(&tr, TREND_BPM, t_ms, v);
+
+    if (np == 0 || t_ms < first_ms) first_ms = t_ms;
+    if (np == 0 || t_ms > tmax_ms)  tmax_ms  = t_ms;
+    push_t[np] = t_ms;
+    push_v[np] = (s16)(v * 100.0f + 0.5f);
+    np++;
+}
+
+// Consulta y la compara con la fuerza bruta; devuelve el nivel usado
+static int Check(u32 t0_ms, u32 t1_ms)
+{
+    TREND_Summary sm;
+    int l = TREND_Query(&tr, TREND_BPM, t0_ms, t1_ms, &sm);
+
+    s64 sum = 0;
+    u32 n = 0;
+    s16 mn = 0, mx = 0;
+    u32 a = (l >= 0) ? sm.t0_ms : t0_ms, b = (l >= 0) ? sm.t1_ms : t1_ms;
+    for (int j = 0; j < np; j++) {
+        if (push_t[j] < a || push_t[j] >= b) continue;
+        if (n == 0 || push_v[j] < mn) mn = push_v[j];
+        if (n == 0 || push_v[j] > mx) mx = push_v[j];
+        sum += push_v[j];
+        n++;
+    }
+
+    if (l < 0) {
+        CHECK(n == 0, "[%u, %u): sin resultado pero hay %u valores", t0_ms, t1_ms, n);
+        return l;
+    }
+
+    CHECK(sm.n == n && sm.min == mn && sm.max == mx && sm.mean == (s16)(sum / (s64)n),
+          "[%u, %u) nivel %d: n %u/%u min %d/%d max %d/%d media %d/%d",
+          t0_ms, t1_ms, l, sm.n, n, sm.min, mn, sm.max, mx, sm.mean,
+          n ? (int)(sum / (s64)n) : 0);
+
+    // Cubre la ventana pedida (desde el primer dato y hasta el ultimo) salvo
+    // que ya no exista ni en el nivel mas grueso, sin pasarse una cubeta
+    u32 res_ms = res_s[l] * 1000;
+    u32 want0 = (t0_ms > first_ms) ? t0_ms : first_ms;
+    u32 want1 = (t1_ms < tmax_ms + 1) ? t1_ms : tmax_ms + 1;
+    u32 oldest3 = (tmax_ms / 1000 / res_s[3] - depth[3]) * res_s[3] * 1000;
+    if (l < TREND_LEVELS - 1 || want0 >= oldest3) {
+        CHECK(sm.t0_ms <= want0, "[%u, %u) nivel %d: empieza en %u", t0_ms, t1_ms, l, sm.t0_ms);
+    }
+    CHECK(sm.t1_ms >= want1, "[%u, %u) nivel %d: termina en %u", t0_ms, t1_ms, l, sm.t1_ms);
+    CHECK(sm.t0_ms + res_ms > t0_ms, "[%u, %u) nivel %d: sobra al inicio (%u)", t0_ms, t1_ms, l, sm.t0_ms);
+    CHECK(sm.t1_ms < t1_ms + res_ms, "[%u, %u) nivel %d: sobra al final (%u)", t0_ms, t1_ms, l, sm.t1_ms);
+
+    // Un nivel mas fino guarda depth + 1 periodos hasta el del ultimo dato:
+    // si el inicio de la ventana entraba ahi, tenia que usarse ese
+    for (int f = 0; f < l; f++) {
+        u32 k_new = tmax_ms / 1000 / res_s[f];
+        u32 k_req = want0 / 1000 / res_s[f];
+        CHECK(k_new - k_req > depth[f],
+              "[%u, %u): uso el nivel %d pero el %d la tenia", t0_ms, t1_ms, l, f);
+    }
+    return l;
+}
+
+// Ventanas de la revision: 60 s y 60 min sin alinear, con datos cada 0.5 s
+static void TestSteady(void)
+{
+    TREND_Init(&tr);
+    np = 0;
+
+    u32 t = 100000137;
+    for (int i = 0; i < 3 * 3600 * 2; i++, t += 500) {
+        Push(t, 70.0f + (float)(i % 40) * 0.25f);
+    }
+    u32 now = t - 500 + 1;
+
+    CHECK(Check(now - 60000, now) == 0, "60 s no usa el nivel de 1 s");
+    CHECK(Check(now - 120000, now) == 0, "2 min no usa el nivel de 1 s");
+    CHECK(Check(now - 3600000, now) == 1, "60 min no usa el nivel de 1 min");
+    CHECK(Check(now - 86400000, now) == 2, "24 h no usa el nivel de 15 min");
+
+    // Una hora exacta toca 61 cubetas de 1 min: 7200 valores + el borde
+    TREND_Summary sm;
+    TREND_Query(&tr, TREND_BPM, now - 3600000, now, &sm);
+    CHECK(sm.n >= 7200 && sm.n <= 7200 + 2 * 120, "60 min: n = %u", sm.n);
+}
+
+// Al azar: huecos de hasta ~1 h, algunos valores atrasados unos segundos
+// y ventanas de 1 s a ~4 dias en cualquier lugar
+static int TestRandom(void)
+{
+    TREND_Init(&tr);
+    np = 0;
+
+    u32 t = 5000;
+    int nq = 0, used[TREND_LEVELS + 1] = { 0 };
+    while (np < MAXP && t < 3u * 86400000u) {
+        t += (u32)(TestRand() < 0.001 ? TestRand() * 4e6 : TestRand() * 1500);
+        u32 tp = (TestRand() < 0.01) ? t - (u32)(TestRand() * 5000) : t;
+        Push(tp, (float)(70.0 + 20.0 * sin(t / 3.6e6) + 5.0 * (TestRand() - 0.5)));
+
+        if (np % 97 == 0) {
+            for (int q = 0; q < 3; q++) {
+                u32 span = (u32)pow(10.0, 3.0 + TestRand() * 5.5);
+                u32 t1 = t + 1 - (u32)(TestRand() * span * 0.5);
+                u32 t0 = (t1 > span) ? t1 - span : 0;
+                used[Check(t0, t1) + 1]++;
+                nq++;
+            }
+        }
+    }
+
+    printf("trend: %d valores, %d consultas (sin datos %d, 1 s %d, 1 min %d, 15 min %d, 1 h %d)\n",
+           np, nq, used[0], used[1], used[2], used[3], used[4]);
+    return nq;
+}
+
+static void Bench(void)
+{
+    const int N = 5000000;
+    u32 t = tmax_ms + 1000;
+
+    double t0 = TestNowNs();
+    for (int j = 0; j < N; j++) {
+        TREND_Push(&tr, TREND_SPO2, t + (u32)j * 20, 97.0f);
+    }
+    double t1 = TestNowNs();
+
+    TREND_Summary sm;
+    u32 end = t + (u32)N * 20;
+    double t2 = TestNowNs();
+    for (int j = 0; j < 100000; j++) {
+        TREND_Query(&tr, TREND_SPO2, end - 120000, end, &sm);
+    }
+    double t3 = TestNowNs();
+
+    printf("trend bench: push %.1f ns, consulta 2 min (121 cubetas) %.1f ns, TREND_Store %u B\n",
+           (t1 - t0) / N, (t3 - t2) / 100000, (unsigned)sizeof(TREND_Store));
+}
+
+int main(int argc, char **argv)
+{
+    TestSteady();
+    TestRandom();
+    if (TestBenchMode(argc, argv)) Bench();
+    return TestDone("test_trend");
+}
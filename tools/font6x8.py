@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# Genera la tabla FONT6x8 de src/main.c a partir de tools/font6x8.txt.
+#
+# La compilacion en Vitis no corre este script: compila la tabla que esta
+# en src/main.c tal como esta en el repositorio. El script es para editar
+# glifos sin tocar hex a mano y para verificar que la tabla y el .txt no se
+# separaron (lo corre "make test" en test/host).
+#
+#   tools/font6x8.py                      imprime la tabla por stdout
+#   tools/font6x8.py --check src/main.c   falla si la tabla de main.c difiere
+#   tools/font6x8.py --write src/main.c   reemplaza la tabla en main.c
+
+import os
+import sys
+
+FONT_FIRST = 0x20
+FONT_LAST = 0x7E
+ROWS = 7            # fila 7 (bit 7): separacion entre lineas
+COLS = 5            # columna 6: separacion entre caracteres
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SOURCE = os.path.join(HERE, "font6x8.txt")
+
+TABLE_BEGIN = "static const Glyph6x8 FONT6x8[FONT_LAST - FONT_FIRST + 1] = {"
+TABLE_END = "};"
+
+
+def die(msg):
+    sys.stderr.write("font6x8: %s\n" % msg)
+    sys.exit(1)
+
+
+def parse(path):
+    """Lista de (codigo, nombre, filas) en el orden del archivo."""
+    glyphs = []
+    cur = None
+    with open(path) as f:
+        for n, line in enumerate(f, 1):
+            line = line.rstrip("\n")
+            where = "%s:%d" % (os.path.basename(path), n)
+            if line == "#" or line.startswith("# "):
+                continue
+            if not line.strip():
+                cur = None
+                continue
+            if cur is None:
+                code, _, name = line.partition(" ")
+                try:
+                    code = int(code, 16)
+                except ValueError:
+                    die("%s: se esperaba '0xNN nombre', hay '%s'" % (where, line))
+                cur = (code, name, [])
+                glyphs.append(cur)
+                continue
+            if len(line) != COLS or set(line) - set("#."):
+                die("%s: fila de %d columnas de '#' y '.', hay '%s'" % (where, COLS, line))
+            if len(cur[2]) == ROWS:
+                die("%s: 0x%02X tiene mas de %d filas" % (where, cur[0], ROWS))
+            cur[2].append(line)
+
+    codes = [g[0] for g in glyphs]
+    if codes != list(range(FONT_FIRST, FONT_LAST + 1)):
+        die("los glifos tienen que ser 0x%02X..0x%02X en orden" % (FONT_FIRST, FONT_LAST))
+    for code, _, rows in glyphs:
+        if len(rows) != ROWS:
+            die("0x%02X tiene %d filas, no %d" % (code, len(rows), ROWS))
+    return glyphs
+
+
+def columns(rows):
+    """Bytes de pagina del SSD1306: uno por columna, bit 0 = fila de arriba."""
+    cols = []
+    for c in range(COLS):
+        cols.append(sum(1 << r for r in range(ROWS) if rows[r][c] == "#"))
+    return cols + [0x00]
+
+
+def emit(glyphs):
+    lines = [TABLE_BEGIN]
+    for code, name, rows in glyphs:
+        hexes = ",".join("0x%02X" % b for b in columns(rows))
+        lines.append("    {{%s}}, // 0x%02X %s" % (hexes, code, name))
+    lines.append(TABLE_END)
+    return lines
+
+
+def find_table(lines, path):
+    try:
+        begin = lines.index(TABLE_BEGIN)
+        end = lines.index(TABLE_END, begin)
+    except ValueError:
+        die("%s: no encuentro la tabla FONT6x8" % path)
+    return begin, end
+
+
+def main(argv):
+    table = emit(parse(SOURCE))
+
+    if len(argv) == 1:
+        print("\n".join(table))
+        return 0
+    if len(argv) != 3 or argv[1] not in ("--check", "--write"):
+        die("uso: font6x8.py [--check|--write main.c]")
+
+    path = argv[2]
+    with open(path) as f:
+        lines = f.read().split("\n")
+    begin, end = find_table(lines, path)
+    current = lines[begin:end + 1]
+
+    if argv[1] == "--check":
+        if current != table:
+            for a, b in zip(current, table):
+                if a != b:
+                    sys.stderr.write("  main.c:  %s\n  txt:     %s\n" % (a, b))
+                    break
+            die("%s: FONT6x8 no coincide con %s (tools/font6x8.py --write)"
+                % (path, os.path.basename(SOURCE)))
+        print("font6x8: %s coincide con %s" % (path, os.path.basename(SOURCE)))
+        return 0
+
+    lines[begin:end + 1] = table
+    with open(path, "w") as f:
+        f.write("\n".join(lines))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))